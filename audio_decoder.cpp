@@ -1,9 +1,42 @@
+#include <array>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <ctime>
+#include <cstdlib>
 #include <QMetaObject>
+#include <QSettings>
 
 #include "log.h"
 #include "scoped_exit.h"
 #include "audio_decoder.h"
+#include "audio_packet_pool.h"
+#include "stream_params.h"
+#include "playback_clock.h"
 #include "lyrics_parser.h"
+#include "loudness_meter.h"
+
+constexpr auto kBufferLowWatermarkSeconds = 2L;
+constexpr auto kBufferHighWatermarkSeconds = 5L;
+constexpr auto kThrottlePollInterval = std::chrono::milliseconds(20);
+constexpr qint64 kSeekIndexSpacingMs = 500;
+constexpr qint64 kExactSeekToleranceMs = 1;
+constexpr int kResamplerFilterSize = 64;
+constexpr int kResamplerPhaseShift = 10;
+constexpr double kResamplerCutoff = 0.97;
+constexpr int kDefaultChunkMs = 100;
+constexpr int kMinChunkMs = 10;
+constexpr int kMaxChunkMs = 500;
+constexpr size_t kPendingPacketReserve = 16;
+constexpr int kMaxDecoderThreads = 4;
+constexpr int kDefaultReadAheadKb = 256;
+constexpr int kMinReadAheadKb = 32;
+constexpr int kMaxReadAheadKb = 8192;
+constexpr double kReplayGainReferenceLufs = -18.0;
 
 static std::string ffmpeg_error_string(int error_code)
 {
@@ -27,229 +60,460 @@ static AVSampleFormat get_av_sample_format(QAudioFormat::SampleFormat format)
     }
 }
 
-static int decode_interrupt_cb(void* ctx)
+static QAudioFormat::SampleFormat get_qt_sample_format(AVSampleFormat format)
 {
-    auto* decoder = static_cast<audio_decoder*>(ctx);
-    return decoder->is_aborted() ? 1 : 0;
+    switch (av_get_packed_sample_fmt(format))
+    {
+        case AV_SAMPLE_FMT_S16:
+            return QAudioFormat::Int16;
+        case AV_SAMPLE_FMT_S32:
+            return QAudioFormat::Int32;
+        case AV_SAMPLE_FMT_FLT:
+            return QAudioFormat::Float;
+        default:
+            return QAudioFormat::Unknown;
+    }
 }
 
-audio_decoder::audio_decoder(QObject* parent) : QObject(parent) {}
+static const char* sample_format_name(AVSampleFormat format)
+{
+    const char* name = av_get_sample_fmt_name(format);
+    return name != nullptr ? name : "none";
+}
 
-audio_decoder::~audio_decoder() { shutdown(); }
+static bool is_raw_elementary_format(const AVFormatContext* ctx)
+{
+    static const char* const kRawFormats[] = {"mp3", "aac", "ac3", "eac3", "dts"};
+    return std::any_of(std::begin(kRawFormats), std::end(kRawFormats), [ctx](const char* name) { return strcmp(ctx->iformat->name, name) == 0; });
+}
 
-void audio_decoder::shutdown()
+static void log_packet_pool_stats()
 {
-    abort_request_ = true;
+    const auto stats = audio_packet_pool::instance().snapshot();
+    LOG_INFO("数据包池 命中 {} 未命中 {} 使用中 {} 峰值 {}", stats.hits, stats.misses, stats.in_use, stats.high_water);
+}
 
+static qint64 thread_cpu_ns()
+{
+#ifdef Q_OS_UNIX
+    timespec ts{};
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
     {
-        std::lock_guard<std::mutex> lock(state_mutex_);
-        if (!is_running_)
+        return (static_cast<qint64>(ts.tv_sec) * 1000000000) + ts.tv_nsec;
+    }
+#endif
+    return 0;
+}
+
+static double replay_gain_db(const QString& file_path, const media_cache::file_stamp& stamp, bool album)
+{
+    loudness_meter::summary track;
+    if (!loudness_meter::summary::deserialize(media_cache::load_loudness(file_path, stamp), track))
+    {
+        return 0.0;
+    }
+
+    std::vector<uint32_t> histogram = track.histogram;
+    double peak = track.true_peak;
+    if (album)
+    {
+        for (const QByteArray& blob : media_cache::load_album_loudness(file_path))
         {
-            return;
+            loudness_meter::summary other;
+            if (!loudness_meter::summary::deserialize(blob, other))
+            {
+                continue;
+            }
+            std::transform(histogram.begin(), histogram.end(), other.histogram.begin(), histogram.begin(), std::plus<>());
+            peak = std::max(peak, other.true_peak);
         }
-        is_running_ = false;
-        is_paused_ = false;
     }
-    wait_cv_.notify_all();
 
-    if (worker_thread_.joinable())
+    if (std::all_of(histogram.begin(), histogram.end(), [](uint32_t count) { return count == 0; }))
     {
-        worker_thread_.join();
+        return 0.0;
     }
-
-    close_audio_context();
+    double gain = kReplayGainReferenceLufs - loudness_meter::gated_loudness(histogram);
+    if (peak > 0.0)
+    {
+        gain = std::min(gain, -20.0 * std::log10(peak));
+    }
+    return gain;
 }
 
-void audio_decoder::start_decoding(qint64 session_id, const QString& file, qint64 offset)
+static int decoder_thread_count()
 {
-    shutdown();
+    QSettings settings("MusicPlayer", "MusicPlayer");
+    const int configured = settings.value("decoder/threads", 0).toInt();
+    if (configured > 0)
+    {
+        return configured;
+    }
+    return std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1, kMaxDecoderThreads);
+}
 
-    session_id_ = session_id;
-    file_path_ = file;
+static int decode_interrupt_cb(void* ctx)
+{
+    auto* decoder = static_cast<audio_decoder*>(ctx);
+    return decoder->is_aborted() ? 1 : 0;
+}
 
-    is_running_ = true;
-    abort_request_ = false;
+audio_decoder::audio_decoder(QObject* parent) : QObject(parent)
+{
+    pending_packets_.reserve(kPendingPacketReserve);
+    worker_thread_ = std::thread(&audio_decoder::worker_main, this);
+}
 
-    if (offset >= 0)
+audio_decoder::~audio_decoder()
+{
+    post_command({decoder_command_type::Quit});
+    if (worker_thread_.joinable())
     {
-        std::lock_guard<std::mutex> lock(state_mutex_);
-        seek_requested_ = true;
-        seek_position_ms_ = offset;
-        seek_session_id_ = session_id;
-        is_paused_ = false;
+        worker_thread_.join();
     }
-    else
+    close_audio_context();
+}
+
+static bool command_aborts_io(decoder_command_type type)
+{
+    return type == decoder_command_type::Open || type == decoder_command_type::Close || type == decoder_command_type::Quit;
+}
+
+void audio_decoder::post_command(decoder_command command)
+{
+    command.posted_ns = steady_clock_ns();
     {
-        is_paused_ = false;
+        std::lock_guard<std::mutex> lock(command_mutex_);
+        if (command_aborts_io(command.type))
+        {
+            abort_request_ = true;
+        }
+        commands_.push_back(std::move(command));
+        command_pending_.store(true, std::memory_order_release);
     }
+    command_cv_.notify_one();
+}
 
-    accumulated_ms_ = 0;
-    first_frame_processed_ = false;
+void audio_decoder::shutdown() { post_command({decoder_command_type::Close}); }
 
-    worker_thread_ = std::thread(&audio_decoder::decoding_loop, this);
+void audio_decoder::start_decoding(qint64 session_id, const QString& file, const std::shared_ptr<pcm_ring>& ring, qint64 offset)
+{
+    decoder_command command{decoder_command_type::Open};
+    command.session_id = session_id;
+    command.file = file;
+    command.ring = ring;
+    command.position_ms = offset;
+    post_command(std::move(command));
 }
 
-void audio_decoder::resume_decoding()
+void audio_decoder::continue_decoding(qint64 session_id, const QString& file, const std::shared_ptr<pcm_ring>& ring, qint64 from_ms)
+{
+    decoder_command command{decoder_command_type::Open};
+    command.session_id = session_id;
+    command.file = file;
+    command.ring = ring;
+    command.position_ms = from_ms;
+    command.continuation = true;
+    post_command(std::move(command));
+}
+
+void audio_decoder::pause_decoding() { post_command({decoder_command_type::Pause}); }
+
+void audio_decoder::resume_decoding() { post_command({decoder_command_type::Resume}); }
+
+void audio_decoder::seek(qint64 session_id, qint64 position_ms)
 {
+    decoder_command command{decoder_command_type::Seek};
+    command.session_id = session_id;
+    command.position_ms = position_ms;
+    post_command(std::move(command));
+}
+
+bool audio_decoder::can_decode() const { return format_ctx_ != nullptr && !paused_ && !at_eof_; }
+
+void audio_decoder::worker_main()
+{
+    std::deque<decoder_command> batch;
+    while (true)
     {
-        std::lock_guard<std::mutex> lock(state_mutex_);
-        if (!is_running_)
+        if (command_pending_.load(std::memory_order_acquire) || !can_decode() || throttled_)
         {
-            return;
+            std::unique_lock<std::mutex> lock(command_mutex_);
+            if (commands_.empty())
+            {
+                if (!can_decode())
+                {
+                    command_cv_.wait(lock, [this] { return !commands_.empty(); });
+                }
+                else
+                {
+                    command_cv_.wait_for(lock, kThrottlePollInterval, [this] { return !commands_.empty(); });
+                }
+            }
+            batch.swap(commands_);
+            command_pending_.store(false, std::memory_order_relaxed);
+            abort_request_ = false;
         }
-        if (!is_paused_)
+
+        while (!batch.empty())
         {
-            return;
+            decoder_command command = std::move(batch.front());
+            batch.pop_front();
+            if (command.type == decoder_command_type::Quit)
+            {
+                return;
+            }
+            if (command.type == decoder_command_type::Seek && !batch.empty() && batch.front().type == decoder_command_type::Seek)
+            {
+                LOG_DEBUG("解码器命令 合并连续跳转 丢弃 {}ms", command.position_ms);
+                continue;
+            }
+            execute_command(command);
         }
 
-        is_paused_ = false;
+        if (can_decode())
+        {
+            const qint64 step_start_ns = steady_clock_ns();
+            decode_step();
+            decode_busy_ns_ += steady_clock_ns() - step_start_ns;
+        }
     }
-    wait_cv_.notify_one();
 }
 
-void audio_decoder::pause_decoding()
+void audio_decoder::execute_command(const decoder_command& command)
 {
-    std::lock_guard<std::mutex> lock(state_mutex_);
-    if (!is_running_)
+    LOG_DEBUG("解码器命令 {} 排队 {:.2f} ms", static_cast<int>(command.type), static_cast<double>(steady_clock_ns() - command.posted_ns) / 1e6);
+    switch (command.type)
     {
-        return;
+        case decoder_command_type::Open:
+            open_track(command);
+            break;
+        case decoder_command_type::Seek:
+            execute_seek(command.session_id, command.position_ms);
+            break;
+        case decoder_command_type::Pause:
+            paused_ = true;
+            break;
+        case decoder_command_type::Resume:
+            paused_ = false;
+            break;
+        case decoder_command_type::Close:
+            close_audio_context();
+            ring_.reset();
+            break;
+        case decoder_command_type::Quit:
+            break;
     }
-    is_paused_ = true;
 }
 
-void audio_decoder::seek(qint64 session_id, qint64 position_ms)
+void audio_decoder::open_track(const decoder_command& command)
 {
+    session_id_ = command.session_id;
+    file_path_ = command.file;
+    ring_ = command.ring;
+    throttled_ = false;
+    paused_ = false;
+    at_eof_ = false;
+    chunks_emitted_ = 0;
+    bytes_emitted_ = 0;
+    decode_busy_ns_ = 0;
+    accumulated_ms_ = 0;
+    start_time_offset_ms_ = 0;
+
+    QSettings settings("MusicPlayer", "MusicPlayer");
+    chunk_ms_ = std::clamp(settings.value("decoder/chunk_ms", kDefaultChunkMs).toInt(), kMinChunkMs, kMaxChunkMs);
+    read_ahead_bytes_ = std::clamp(settings.value("decoder/read_ahead_kb", kDefaultReadAheadKb).toInt(), kMinReadAheadKb, kMaxReadAheadKb) * 1024;
+    analyzer_ = spectrum_analyzer::from_settings();
+    replay_gain_mode_ = settings.value("playback/replay_gain", "track").toString();
+
+    continuation_ = command.continuation;
+    open_started_ns_ = steady_clock_ns();
+    if (!open_audio_context(file_path_))
     {
-        std::lock_guard<std::mutex> lock(state_mutex_);
-        seek_session_id_ = session_id;
-        seek_position_ms_ = position_ms;
-        seek_requested_ = true;
-        is_paused_ = false;
+        emit decoding_error(session_id_, "Failed to open audio file");
+        return;
+    }
+    cpu_start_ns_ = thread_cpu_ns();
+    begin_burst();
+
+    if (command.position_ms >= 0)
+    {
+        execute_seek(command.session_id, command.position_ms, !command.continuation);
     }
-    wait_cv_.notify_one();
 }
 
-void audio_decoder::decoding_loop()
+void audio_decoder::execute_seek(qint64 session_id, qint64 target_ms, bool announce)
 {
-    if (!open_audio_context(file_path_))
+    if (format_ctx_ == nullptr)
     {
-        emit decoding_error("Failed to open audio file");
         return;
     }
 
-    while (is_running_)
+    pending_packets_.clear();
+    chunk_.reset();
+    throttled_ = false;
+    at_eof_ = false;
+    if (building_seek_index_ && !seek_index_gap_)
     {
-        {
-            std::unique_lock<std::mutex> lock(state_mutex_);
-            wait_cv_.wait(lock, [this] { return (!is_paused_ || seek_requested_ || !is_running_); });
+        LOG_DEBUG("跳转索引 播放中发生跳转 保留 {} 个条目 解码回到末尾条目后继续构建", seek_index_.size());
+        seek_index_gap_ = true;
+    }
 
-            if (!is_running_)
-            {
-                break;
-            }
-        }
+    qint64 seek_target_ts = av_rescale_q(target_ms + start_time_offset_ms_, {1, 1000}, time_base_);
 
-        bool do_seek = false;
-        qint64 target_ms = 0;
-        qint64 target_sess = 0;
+    avcodec_flush_buffers(codec_ctx_);
 
-        {
-            std::lock_guard<std::mutex> lock(state_mutex_);
-            if (seek_requested_)
-            {
-                do_seek = true;
-                target_ms = seek_position_ms_;
-                target_sess = seek_session_id_;
-                seek_requested_ = false;
-            }
-        }
+    int ret = seek_with_index(seek_target_ts);
 
-        if (do_seek)
-        {
-            if (format_ctx_ != nullptr)
-            {
-                qint64 seek_target_ts = av_rescale_q(target_ms, {1, 1000}, time_base_);
+    if (ret < 0)
+    {
+        index_sample_cursor_ = -1;
+        ret = avformat_seek_file(format_ctx_, audio_stream_index_, INT64_MIN, seek_target_ts, seek_target_ts, 0);
+    }
 
-                avcodec_flush_buffers(codec_ctx_);
+    if (ret < 0)
+    {
+        ret = avformat_seek_file(format_ctx_, audio_stream_index_, INT64_MIN, seek_target_ts, INT64_MAX, 0);
+    }
 
-                int ret = avformat_seek_file(format_ctx_, audio_stream_index_, INT64_MIN, seek_target_ts, seek_target_ts, 0);
+    if (ret < 0)
+    {
+        LOG_WARN("avformat_seek_file failed: {}", ffmpeg_error_string(ret));
+        seek_target_exact_ms_ = -1;
+        emit seek_finished(session_id, -1);
+        return;
+    }
 
-                if (ret < 0)
-                {
-                    ret = avformat_seek_file(format_ctx_, audio_stream_index_, INT64_MIN, seek_target_ts, INT64_MAX, 0);
-                }
+    if (swr_ctx_ != nullptr)
+    {
+        swr_init(swr_ctx_);
+    }
+    accumulated_ms_ = target_ms;
+    seek_target_exact_ms_ = target_ms;
+    seek_report_session_id_ = announce ? session_id : 0;
+    if (announce)
+    {
+        ring_->begin_serial();
+    }
+    begin_burst();
+}
 
-                qint64 actual_ms = target_ms;
+void audio_decoder::configure_threading(const AVCodec* codec)
+{
+    const bool frame_threads = (codec->capabilities & AV_CODEC_CAP_FRAME_THREADS) != 0;
+    const bool slice_threads = (codec->capabilities & AV_CODEC_CAP_SLICE_THREADS) != 0;
+    if (!frame_threads && !slice_threads)
+    {
+        codec_ctx_->thread_count = 1;
+        return;
+    }
+    codec_ctx_->thread_count = decoder_thread_count();
+    codec_ctx_->thread_type = (frame_threads ? FF_THREAD_FRAME : 0) | (slice_threads ? FF_THREAD_SLICE : 0);
+}
 
-                if (ret < 0)
-                {
-                    LOG_WARN("avformat_seek_file failed: {}", ffmpeg_error_string(ret));
-                    actual_ms = -1;
-                    seek_target_exact_ms_ = -1;
-                }
-                else
-                {
-                    accumulated_ms_ = target_ms;
-                }
+void audio_decoder::begin_burst()
+{
+    burst_start_ns_ = steady_clock_ns();
+    burst_start_bytes_ = bytes_emitted_;
+}
 
-                emit seek_finished(target_sess, actual_ms);
-            }
-            continue;
-        }
+void audio_decoder::update_burst(bool finished)
+{
+    if (burst_start_ns_ < 0 || (!finished && ring_->buffered_bytes() < low_water_bytes_))
+    {
+        return;
+    }
+    const double elapsed_ms = static_cast<double>(steady_clock_ns() - burst_start_ns_) / 1e6;
+    const double audio_ms = static_cast<double>(bytes_emitted_ - burst_start_bytes_) * 1000.0 / static_cast<double>(bytes_per_second());
+    LOG_INFO("突发解码 {:.1f} ms 音频用时 {:.1f} ms 速度 {:.1f}x 实时", audio_ms, elapsed_ms, elapsed_ms > 0 ? audio_ms / elapsed_ms : 0.0);
+    burst_start_ns_ = -1;
+}
 
-        int receive_ret = avcodec_receive_frame(codec_ctx_, frame_);
+qint64 audio_decoder::bytes_per_second() const
+{
+    return static_cast<qint64>(target_format_.sampleRate()) * target_format_.channelCount() * av_get_bytes_per_sample(target_ffmpeg_fmt_);
+}
 
-        if (receive_ret == 0)
+void audio_decoder::decode_step()
+{
+    if (!throttled_ && (!flush_pending_packets() || ring_->above_high_water()))
+    {
+        LOG_TRACE("解码器 缓冲区水位高 {} 字节 暂停解码", ring_->buffered_bytes());
+        throttled_ = true;
+        return;
+    }
+    if (throttled_)
+    {
+        if (!ring_->below_low_water() || !flush_pending_packets())
         {
-            process_frame(frame_);
-            continue;
+            return;
         }
+        LOG_TRACE("解码器 缓冲区水位低 {} 字节 继续解码", ring_->buffered_bytes());
+        throttled_ = false;
+    }
 
-        if (receive_ret == AVERROR_EOF)
-        {
-            emit packet_ready(session_id_, nullptr);
+    int receive_ret = avcodec_receive_frame(codec_ctx_, frame_);
 
-            {
-                std::lock_guard<std::mutex> lock(state_mutex_);
-                is_paused_ = true;
-            }
-            continue;
+    if (receive_ret == 0)
+    {
+        process_frame(frame_);
+        return;
+    }
+
+    if (receive_ret == AVERROR_EOF)
+    {
+        drain_resampler();
+        close_chunk();
+        if (!pending_packets_.empty())
+        {
+            throttled_ = true;
+            return;
         }
 
-        if (receive_ret != AVERROR(EAGAIN))
+        LOG_INFO("结束流程 1/4 解码器到达文件末尾");
+        update_burst(true);
+        log_chunk_stats(thread_cpu_ns() - cpu_start_ns_);
+        store_seek_index();
+        if (seek_target_exact_ms_ >= 0)
         {
-            emit decoding_error(QString::fromStdString(ffmpeg_error_string(receive_ret)));
-            break;
+            finish_exact_seek(seek_target_exact_ms_);
         }
+        ring_->mark_finished();
+        log_packet_pool_stats();
+        at_eof_ = true;
+        return;
+    }
+
+    if (receive_ret != AVERROR(EAGAIN))
+    {
+        emit decoding_error(session_id_, QString::fromStdString(ffmpeg_error_string(receive_ret)));
+        close_audio_context();
+        return;
+    }
 
-        int read_ret = av_read_frame(format_ctx_, packet_);
-        if (read_ret < 0)
+    int read_ret = av_read_frame(format_ctx_, packet_);
+    if (read_ret < 0)
+    {
+        if (!is_aborted())
         {
-            if (read_ret == AVERROR_EOF)
-            {
-                avcodec_send_packet(codec_ctx_, nullptr);
-                continue;
-            }
-            if (is_aborted())
-            {
-                break;
-            }
             avcodec_send_packet(codec_ctx_, nullptr);
-            continue;
         }
+        return;
+    }
 
-        DEFER(av_packet_unref(packet_));
+    DEFER(av_packet_unref(packet_));
 
-        if (packet_->stream_index == audio_stream_index_)
+    if (packet_->stream_index == audio_stream_index_)
+    {
+        record_seek_point(packet_);
+        int send_ret = avcodec_send_packet(codec_ctx_, packet_);
+        if (send_ret < 0)
         {
-            int send_ret = avcodec_send_packet(codec_ctx_, packet_);
-            if (send_ret < 0)
-            {
-                LOG_WARN("avcodec_send_packet failed {}", ffmpeg_error_string(send_ret));
-            }
+            LOG_WARN("avcodec_send_packet failed {}", ffmpeg_error_string(send_ret));
         }
     }
 }
+
 bool audio_decoder::open_audio_context(const QString& file_path)
 {
     close_audio_context();
@@ -263,7 +527,14 @@ bool audio_decoder::open_audio_context(const QString& file_path)
 
     format_ctx_->interrupt_callback.callback = decode_interrupt_cb;
     format_ctx_->interrupt_callback.opaque = this;
-    abort_request_ = false;
+
+    reader_ = std::make_unique<media_reader>();
+    if (!reader_->open(file_path, read_ahead_bytes_))
+    {
+        return false;
+    }
+    format_ctx_->pb = reader_->io();
+    format_ctx_->flags |= AVFMT_FLAG_CUSTOM_IO;
 
     int ret = avformat_open_input(&format_ctx_, file_path.toUtf8().constData(), nullptr, nullptr);
     if (ret != 0)
@@ -272,11 +543,19 @@ bool audio_decoder::open_audio_context(const QString& file_path)
         return false;
     }
 
-    ret = avformat_find_stream_info(format_ctx_, nullptr);
-    if (ret < 0)
+    file_stamp_ = media_cache::stamp_of(file_path);
+    media_cache::open_blobs cached = media_cache::load_open_blobs(file_path, file_stamp_);
+    cached_seek_index_ = std::move(cached.seek_index);
+    audio_stream_index_ = stream_params::apply(cached.stream_params, format_ctx_);
+    params_cache_hit_ = audio_stream_index_ >= 0;
+    if (!params_cache_hit_)
     {
-        LOG_ERROR("Failed to find stream info {}", ffmpeg_error_string(ret));
-        return false;
+        ret = avformat_find_stream_info(format_ctx_, nullptr);
+        if (ret < 0)
+        {
+            LOG_ERROR("Failed to find stream info {}", ffmpeg_error_string(ret));
+            return false;
+        }
     }
 
     for (unsigned int i = 0; i < format_ctx_->nb_streams; i++)
@@ -293,16 +572,32 @@ bool audio_decoder::open_audio_context(const QString& file_path)
         }
     }
 
-    audio_stream_index_ = av_find_best_stream(format_ctx_, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
-    if (audio_stream_index_ < 0)
+    if (!params_cache_hit_)
     {
-        return false;
+        audio_stream_index_ = av_find_best_stream(format_ctx_, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+        if (audio_stream_index_ < 0)
+        {
+            return false;
+        }
+        if (file_stamp_.valid())
+        {
+            media_cache::store_stream_params(file_path, file_stamp_, stream_params::capture(format_ctx_, audio_stream_index_));
+        }
     }
 
     AVStream* audio_stream = format_ctx_->streams[audio_stream_index_];
     time_base_ = audio_stream->time_base;
+    if (audio_stream->start_time != AV_NOPTS_VALUE)
+    {
+        start_time_offset_ms_ = av_rescale_q(audio_stream->start_time, time_base_, {1, 1000});
+    }
+    else if (format_ctx_->start_time != AV_NOPTS_VALUE)
+    {
+        start_time_offset_ms_ = av_rescale(format_ctx_->start_time, 1000, AV_TIME_BASE);
+    }
 
     process_metadata_and_lyrics(format_ctx_->metadata, audio_stream->metadata);
+    prepare_seek_index();
 
     const AVCodec* codec = avcodec_find_decoder(audio_stream->codecpar->codec_id);
     if (codec == nullptr)
@@ -321,54 +616,58 @@ bool audio_decoder::open_audio_context(const QString& file_path)
         return false;
     }
 
+    configure_threading(codec);
+
     if (avcodec_open2(codec_ctx_, codec, nullptr) < 0)
     {
         return false;
     }
-
-    target_format_.setSampleRate(codec_ctx_->sample_rate);
-    target_format_.setChannelCount(codec_ctx_->ch_layout.nb_channels);
-    target_format_.setSampleFormat(QAudioFormat::Int16);
-    target_ffmpeg_fmt_ = get_av_sample_format(target_format_.sampleFormat());
-
-    AVChannelLayout target_ch_layout;
-    av_channel_layout_default(&target_ch_layout, target_format_.channelCount());
-
-    ret = swr_alloc_set_opts2(&swr_ctx_,
-                              &target_ch_layout,
-                              target_ffmpeg_fmt_,
-                              target_format_.sampleRate(),
-                              &codec_ctx_->ch_layout,
-                              codec_ctx_->sample_fmt,
-                              codec_ctx_->sample_rate,
-                              0,
-                              nullptr);
-    if (ret != 0)
+    LOG_INFO("解码线程 编解码器 {} 线程数 {} 模式 {}",
+             codec->name,
+             codec_ctx_->thread_count,
+             (codec_ctx_->active_thread_type & FF_THREAD_FRAME) != 0   ? "frame"
+             : (codec_ctx_->active_thread_type & FF_THREAD_SLICE) != 0 ? "slice"
+                                                                       : "single");
+
+    if (!negotiate_output_format())
     {
         return false;
     }
-    if (swr_init(swr_ctx_) != 0)
+
+    frame_ = av_frame_alloc();
+    packet_ = av_packet_alloc();
+    if (frame_ == nullptr || packet_ == nullptr)
     {
         return false;
     }
 
-    int alloc_ret =
-        av_samples_alloc(&swr_data_, &swr_data_linesize_, target_format_.channelCount(), target_format_.sampleRate(), target_ffmpeg_fmt_, 0);
-    if (alloc_ret < 0)
+    const qint64 rate = bytes_per_second();
+    ring_->set_water_marks(rate * kBufferLowWatermarkSeconds, rate * kBufferHighWatermarkSeconds);
+    low_water_bytes_ = rate * kBufferLowWatermarkSeconds;
+
+    const qint64 frame_bytes = static_cast<qint64>(target_format_.channelCount()) * av_get_bytes_per_sample(target_ffmpeg_fmt_);
+    // Chunks live in pooled slabs, so a chunk longer than one slab holds at this format is clamped to the slab.
+    qint64 chunk_bytes = rate * chunk_ms_ / 1000;
+    if (chunk_bytes > static_cast<qint64>(kPacketSlabBytes))
     {
-        return false;
+        chunk_bytes = static_cast<qint64>(kPacketSlabBytes);
+        if (!continuation_)
+        {
+            LOG_WARN("分块 {}ms 超过数据包容量 {} 字节 按 {}ms 分块", chunk_ms_, kPacketSlabBytes, chunk_bytes * 1000 / rate);
+        }
     }
+    chunk_target_bytes_ = static_cast<size_t>(std::max(frame_bytes, chunk_bytes - (chunk_bytes % frame_bytes)));
 
-    frame_ = av_frame_alloc();
-    packet_ = av_packet_alloc();
-    if (frame_ == nullptr || packet_ == nullptr)
+    if (!continuation_)
     {
-        return false;
+        const double gain_db = replay_gain_mode_ == "off" ? 0.0 : replay_gain_db(file_path, file_stamp_, replay_gain_mode_ == "album");
+        ring_->set_replay_gain(static_cast<float>(std::pow(10.0, gain_db / 20.0)));
+        LOG_INFO("回放增益 模式 {} {:.2f} dB 会话id {}", replay_gain_mode_.toStdString(), gain_db, session_id_);
     }
 
-    if (format_ctx_->duration != AV_NOPTS_VALUE)
+    if (!continuation_)
     {
-        qint64 duration_ms = format_ctx_->duration / (AV_TIME_BASE / 1000);
+        const qint64 duration_ms = format_ctx_->duration != AV_NOPTS_VALUE ? format_ctx_->duration / (AV_TIME_BASE / 1000) : 0;
         emit duration_ready(session_id_, duration_ms, target_format_);
     }
 
@@ -378,25 +677,75 @@ bool audio_decoder::open_audio_context(const QString& file_path)
 
 void audio_decoder::process_frame(AVFrame* frame)
 {
-    if (frame->pts != AV_NOPTS_VALUE && !first_frame_processed_)
+    int64_t frame_pts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+    if (index_sample_cursor_ >= 0)
     {
-        start_time_offset_ms_ = static_cast<qint64>(av_q2d(time_base_) * 1000 * static_cast<double>(frame->pts));
-        first_frame_processed_ = true;
+        frame_pts = av_rescale_q(index_sample_cursor_, {1, codec_ctx_->sample_rate}, time_base_);
+        index_sample_cursor_ += frame->nb_samples;
     }
 
-    int converted_samples = swr_convert(swr_ctx_, &swr_data_, target_format_.sampleRate(), (const uint8_t**)frame->data, frame->nb_samples);
-    if (converted_samples < 0)
+    int skip_samples = 0;
+    if (seek_target_exact_ms_ >= 0)
     {
-        return;
+        skip_samples = samples_before_seek_target(frame, frame_pts);
+        if (skip_samples >= frame->nb_samples)
+        {
+            return;
+        }
     }
 
-    int buffer_size = av_samples_get_buffer_size(&swr_data_linesize_, target_format_.channelCount(), converted_samples, target_ffmpeg_fmt_, 1);
+    const auto** input = const_cast<const uint8_t**>(frame->extended_data);
+    std::array<const uint8_t*, AV_NUM_DATA_POINTERS> trimmed_input{};
+    const uint8_t* passthrough_pcm = nullptr;
+    if (passthrough_)
+    {
+        const int frame_bytes = av_get_bytes_per_sample(target_ffmpeg_fmt_) * target_format_.channelCount();
+        input = nullptr;
+        passthrough_pcm = frame->extended_data[0] + static_cast<ptrdiff_t>(skip_samples) * frame_bytes;
+    }
+    else if (skip_samples > 0)
+    {
+        const auto sample_fmt = static_cast<AVSampleFormat>(frame->format);
+        const bool planar = av_sample_fmt_is_planar(sample_fmt) != 0;
+        const int channels = frame->ch_layout.nb_channels;
+        const int bytes_per_sample = av_get_bytes_per_sample(sample_fmt);
+        const int stride = planar ? bytes_per_sample : bytes_per_sample * channels;
+        const size_t planes = planar ? static_cast<size_t>(channels) : 1;
+        if (planes > trimmed_input.size())
+        {
+            LOG_WARN("跳转裁剪 声道数 {} 超出支持范围", channels);
+            return;
+        }
+        for (size_t i = 0; i < planes; ++i)
+        {
+            trimmed_input[i] = frame->extended_data[i] + static_cast<ptrdiff_t>(skip_samples) * stride;
+        }
+        input = trimmed_input.data();
+    }
+
+    const uint8_t* pcm = nullptr;
+    int buffer_size = 0;
+    if (passthrough_)
+    {
+        pcm = passthrough_pcm;
+        buffer_size = av_samples_get_buffer_size(nullptr, target_format_.channelCount(), frame->nb_samples - skip_samples, target_ffmpeg_fmt_, 1);
+    }
+    else
+    {
+        const int converted_samples = swr_convert(swr_ctx_, &swr_data_, swr_capacity_samples_, input, frame->nb_samples - skip_samples);
+        if (converted_samples < 0)
+        {
+            return;
+        }
+        pcm = swr_data_;
+        buffer_size = av_samples_get_buffer_size(nullptr, target_format_.channelCount(), converted_samples, target_ffmpeg_fmt_, 1);
+    }
 
     qint64 timestamp_ms = 0;
-    if (frame->pts != AV_NOPTS_VALUE)
+    if (frame_pts != AV_NOPTS_VALUE)
     {
-        auto raw_timestamp_ms = static_cast<qint64>(av_q2d(time_base_) * 1000 * static_cast<double>(frame->pts));
-        timestamp_ms = raw_timestamp_ms - start_time_offset_ms_;
+        const int64_t raw_sample = av_rescale_q(frame_pts, time_base_, {1, codec_ctx_->sample_rate}) + skip_samples;
+        timestamp_ms = av_rescale(raw_sample, 1000, codec_ctx_->sample_rate) - start_time_offset_ms_;
     }
     else
     {
@@ -407,13 +756,323 @@ void audio_decoder::process_frame(AVFrame* frame)
     accumulated_ms_ = timestamp_ms;
     timestamp_ms = std::max<qint64>(timestamp_ms, 0);
 
-    if (buffer_size > 0)
+    emit_pcm(pcm, buffer_size, timestamp_ms);
+}
+
+void audio_decoder::prepare_seek_index()
+{
+    seek_index_.clear();
+    building_seek_index_ = false;
+    seek_index_gap_ = false;
+    seek_index_pts_shift_ = 0;
+    index_sample_cursor_ = -1;
+    if (!is_raw_elementary_format(format_ctx_))
+    {
+        return;
+    }
+
+    seek_index_ = seek_index::deserialize(cached_seek_index_);
+    cached_seek_index_.clear();
+    if (!seek_index_.empty())
+    {
+        LOG_INFO("跳转索引 已加载 {} 个条目 格式 {}", seek_index_.size(), format_ctx_->iformat->name);
+        return;
+    }
+    building_seek_index_ = file_stamp_.valid();
+}
+
+void audio_decoder::record_seek_point(const AVPacket* packet)
+{
+    if (!building_seek_index_)
+    {
+        return;
+    }
+    const int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+    if (pts == AV_NOPTS_VALUE)
+    {
+        return;
+    }
+    if (seek_index_gap_)
+    {
+        // Timestamps after a seek are estimated by the demuxer. Recording resumes only at a packet that starts exactly
+        // on a recorded entry, whose true pts gives the correction for every packet that follows it.
+        const seek_index::entry* entry = seek_index_.find_pos(packet->pos);
+        if (entry == nullptr)
+        {
+            return;
+        }
+        seek_index_pts_shift_ = entry->pts - pts;
+        seek_index_gap_ = false;
+        LOG_DEBUG("跳转索引 解码回到已索引位置 偏移 {} 时间戳修正 {} 继续构建", packet->pos, seek_index_pts_shift_);
+    }
+    seek_index_.add(pts + seek_index_pts_shift_, packet->pos, av_rescale_q(kSeekIndexSpacingMs, {1, 1000}, time_base_));
+}
+
+void audio_decoder::store_seek_index()
+{
+    if (!building_seek_index_)
+    {
+        return;
+    }
+    building_seek_index_ = false;
+    if (seek_index_gap_)
+    {
+        LOG_DEBUG("跳转索引 跳转后未回到已索引位置 不保存 {} 个条目", seek_index_.size());
+        return;
+    }
+    if (seek_index_.empty())
+    {
+        return;
+    }
+
+    const QByteArray blob = seek_index_.serialize();
+    if (media_cache::store_seek_index(file_path_, file_stamp_, blob))
+    {
+        LOG_INFO("跳转索引 已保存 {} 个条目 {} 字节 {}", seek_index_.size(), blob.size(), file_path_.toStdString());
+    }
+}
+
+int audio_decoder::seek_with_index(int64_t target_ts)
+{
+    // A partial index still answers targets inside the range it covers.
+    if (seek_index_.empty() || (building_seek_index_ && target_ts > seek_index_.last_pts()))
+    {
+        return -1;
+    }
+
+    const seek_index::entry* entry = seek_index_.find(target_ts);
+    if (entry == nullptr)
+    {
+        return -1;
+    }
+
+    const int ret = av_seek_frame(format_ctx_, audio_stream_index_, entry->pos, AVSEEK_FLAG_BYTE);
+    if (ret < 0)
+    {
+        LOG_WARN("跳转索引 按字节跳转失败 {}", ffmpeg_error_string(ret));
+        return ret;
+    }
+
+    index_sample_cursor_ = av_rescale_q(entry->pts, time_base_, {1, codec_ctx_->sample_rate});
+    LOG_DEBUG("跳转索引 目标 {} 命中条目 pts {} 偏移 {}", target_ts, entry->pts, entry->pos);
+    return ret;
+}
+
+int audio_decoder::samples_before_seek_target(const AVFrame* frame, int64_t frame_pts)
+{
+    const int sample_rate = codec_ctx_->sample_rate;
+    const int64_t target_sample = av_rescale(seek_target_exact_ms_ + start_time_offset_ms_, sample_rate, 1000);
+    if (frame_pts == AV_NOPTS_VALUE)
+    {
+        finish_exact_seek(seek_target_exact_ms_);
+        return 0;
+    }
+
+    const int64_t frame_sample = av_rescale_q(frame_pts, time_base_, {1, sample_rate});
+    if (frame_sample + frame->nb_samples <= target_sample)
+    {
+        return frame->nb_samples;
+    }
+
+    const int64_t skip = std::max<int64_t>(0, target_sample - frame_sample);
+    LOG_DEBUG("跳转流程 解码器精确定位 帧起点采样 {} 目标采样 {} 裁剪 {} 个采样", frame_sample, target_sample, skip);
+    finish_exact_seek(av_rescale(frame_sample + skip, 1000, sample_rate) - start_time_offset_ms_);
+    return static_cast<int>(skip);
+}
+
+void audio_decoder::finish_exact_seek(qint64 actual_ms)
+{
+    LOG_INFO("跳转流程 解码器已定位 目标 {}ms 实际 {}ms", seek_target_exact_ms_, actual_ms);
+    if (std::llabs(actual_ms - seek_target_exact_ms_) > kExactSeekToleranceMs)
+    {
+        LOG_WARN("跳转自检 定位偏差 {}ms 起始偏移 {}ms", actual_ms - seek_target_exact_ms_, start_time_offset_ms_);
+    }
+    seek_target_exact_ms_ = -1;
+    if (seek_report_session_id_ != 0)
+    {
+        emit seek_finished(seek_report_session_id_, actual_ms);
+    }
+}
+
+bool audio_decoder::negotiate_output_format()
+{
+    const int source_rate = codec_ctx_->sample_rate;
+    const int channels = codec_ctx_->ch_layout.nb_channels;
+    const AVSampleFormat source_fmt = codec_ctx_->sample_fmt;
+    const QAudioFormat::SampleFormat source_qt_fmt = get_qt_sample_format(source_fmt);
+
+    const bool has_preference = output_preference_.isValid();
+    const int target_rate = has_preference ? output_preference_.sampleRate() : source_rate;
+
+    QAudioFormat::SampleFormat target_qt_fmt = source_qt_fmt;
+    if (source_rate != target_rate || source_qt_fmt == QAudioFormat::Unknown)
+    {
+        target_qt_fmt = has_preference ? output_preference_.sampleFormat() : QAudioFormat::Int16;
+    }
+
+    target_format_.setSampleRate(target_rate);
+    target_format_.setChannelCount(channels);
+    target_format_.setSampleFormat(target_qt_fmt);
+    target_ffmpeg_fmt_ = get_av_sample_format(target_qt_fmt);
+
+    passthrough_ = source_fmt == target_ffmpeg_fmt_ && source_rate == target_rate && channels <= 2;
+    if (passthrough_)
+    {
+        LOG_INFO("格式协商 直通 {}hz {} {}声道 不经过 swr", source_rate, sample_format_name(source_fmt), channels);
+        return true;
+    }
+
+    AVChannelLayout target_ch_layout;
+    av_channel_layout_default(&target_ch_layout, channels);
+
+    int ret = swr_alloc_set_opts2(
+        &swr_ctx_, &target_ch_layout, target_ffmpeg_fmt_, target_rate, &codec_ctx_->ch_layout, source_fmt, source_rate, 0, nullptr);
+    if (ret != 0)
+    {
+        return false;
+    }
+
+    const bool resampling = source_rate != target_rate;
+    if (resampling)
+    {
+        av_opt_set_int(swr_ctx_, "filter_size", kResamplerFilterSize, 0);
+        av_opt_set_int(swr_ctx_, "phase_shift", kResamplerPhaseShift, 0);
+        av_opt_set_double(swr_ctx_, "cutoff", kResamplerCutoff, 0);
+    }
+
+    if (swr_init(swr_ctx_) != 0)
+    {
+        return false;
+    }
+
+    const int max_out_samples = target_rate + kResamplerFilterSize;
+    if (av_samples_alloc(&swr_data_, &swr_data_linesize_, channels, max_out_samples, target_ffmpeg_fmt_, 0) < 0)
+    {
+        return false;
+    }
+    swr_capacity_samples_ = max_out_samples;
+
+    LOG_INFO("格式协商 {} {}hz {} {}声道 -> {}hz {}",
+             resampling ? "重采样" : "格式转换",
+             source_rate,
+             sample_format_name(source_fmt),
+             channels,
+             target_rate,
+             sample_format_name(target_ffmpeg_fmt_));
+    return true;
+}
+
+void audio_decoder::drain_resampler()
+{
+    if (swr_ctx_ == nullptr || ring_ == nullptr)
+    {
+        return;
+    }
+
+    const int converted_samples = swr_convert(swr_ctx_, &swr_data_, swr_capacity_samples_, nullptr, 0);
+    if (converted_samples <= 0)
+    {
+        return;
+    }
+    const int buffer_size = av_samples_get_buffer_size(nullptr, target_format_.channelCount(), converted_samples, target_ffmpeg_fmt_, 1);
+    emit_pcm(swr_data_, buffer_size, accumulated_ms_);
+}
+
+void audio_decoder::emit_pcm(const uint8_t* data, int size, qint64 timestamp_ms)
+{
+    if (size <= 0)
+    {
+        return;
+    }
+
+    const qint64 rate = std::max<qint64>(1, bytes_per_second());
+    size_t offset = 0;
+    while (offset < static_cast<size_t>(size))
+    {
+        if (!chunk_)
+        {
+            chunk_ = audio_packet_pool::instance().acquire(chunk_target_bytes_);
+            chunk_->ms = timestamp_ms + static_cast<qint64>(offset) * 1000 / rate;
+            chunk_->format = target_format_.sampleFormat();
+            chunk_->channels = target_format_.channelCount();
+            chunk_->sample_rate = target_format_.sampleRate();
+            chunk_->serial = ring_->serial();
+        }
+
+        const size_t take = std::min(chunk_target_bytes_ - chunk_->data.size(), static_cast<size_t>(size) - offset);
+        chunk_->data.insert(chunk_->data.end(), data + offset, data + offset + take);
+        offset += take;
+
+        if (chunk_->data.size() >= chunk_target_bytes_)
+        {
+            close_chunk();
+        }
+    }
+}
+
+void audio_decoder::close_chunk()
+{
+    if (!chunk_)
+    {
+        return;
+    }
+    ++chunks_emitted_;
+    bytes_emitted_ += chunk_->data.size();
+    analyzer_->push(*chunk_,
+                    [this](qint64 timestamp_ms, const float* levels, size_t count)
+                    { ring_->spectrum().append(chunk_->serial, timestamp_ms, levels, count); });
+    pending_packets_.push_back(std::move(chunk_));
+    flush_pending_packets();
+    update_burst(false);
+    if (open_started_ns_ > 0)
+    {
+        LOG_INFO("首个数据包 {:.2f} ms 流参数缓存 {}",
+                 static_cast<double>(steady_clock_ns() - open_started_ns_) / 1e6,
+                 params_cache_hit_ ? "命中" : "未命中");
+        open_started_ns_ = 0;
+    }
+}
+
+void audio_decoder::log_chunk_stats(qint64 cpu_ns) const
+{
+    const qint64 rate = bytes_per_second();
+    if (rate <= 0 || bytes_emitted_ == 0)
+    {
+        return;
+    }
+    const double audio_seconds = static_cast<double>(bytes_emitted_) / static_cast<double>(rate);
+    const double busy_seconds = static_cast<double>(decode_busy_ns_) / 1e9;
+    LOG_INFO("解码统计 分块 {:.1f}ms 配置 {}ms 数据包 {} 每秒音频 {:.1f} 个 音频 {:.1f}s 线程 cpu {}ms",
+             static_cast<double>(chunk_target_bytes_) * 1000.0 / static_cast<double>(rate),
+             chunk_ms_,
+             chunks_emitted_,
+             static_cast<double>(chunks_emitted_) / audio_seconds,
+             audio_seconds,
+             cpu_ns / 1000000);
+    LOG_INFO("解码速度 编解码器 {} 线程数 {} {:.1f}x 实时",
+             codec_ctx_->codec->name,
+             codec_ctx_->thread_count,
+             busy_seconds > 0 ? audio_seconds / busy_seconds : 0.0);
+    if (reader_ != nullptr)
+    {
+        const auto io = reader_->snapshot();
+        LOG_INFO("读取统计 预读缓冲 {}kb 读取 {} 次 {} 字节 平均 {} 字节每次",
+                 read_ahead_bytes_ / 1024,
+                 io.reads,
+                 io.bytes,
+                 io.reads > 0 ? io.bytes / io.reads : 0);
+    }
+}
+
+bool audio_decoder::flush_pending_packets()
+{
+    size_t flushed = 0;
+    while (flushed < pending_packets_.size() && ring_->push(pending_packets_[flushed]))
     {
-        auto packet = std::make_shared<audio_packet>();
-        packet->data.assign(swr_data_, swr_data_ + buffer_size);
-        packet->ms = timestamp_ms;
-        emit packet_ready(session_id_, packet);
+        ++flushed;
     }
+    pending_packets_.erase(pending_packets_.begin(), pending_packets_.begin() + static_cast<std::ptrdiff_t>(flushed));
+    return pending_packets_.empty();
 }
 
 void audio_decoder::process_metadata_and_lyrics(AVDictionary* container_metadata, AVDictionary* stream_metadata)
@@ -467,6 +1126,8 @@ void audio_decoder::process_metadata_and_lyrics(AVDictionary* container_metadata
 
 void audio_decoder::close_audio_context()
 {
+    pending_packets_.clear();
+    chunk_.reset();
     if (codec_ctx_ != nullptr)
     {
         avcodec_free_context(&codec_ctx_);
@@ -477,6 +1138,7 @@ void audio_decoder::close_audio_context()
         avformat_close_input(&format_ctx_);
         format_ctx_ = nullptr;
     }
+    reader_.reset();
     if (swr_ctx_ != nullptr)
     {
         swr_free(&swr_ctx_);
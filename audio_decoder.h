@@ -4,7 +4,9 @@
 #include <QObject>
 #include <QAudioFormat>
 #include <atomic>
+#include <deque>
 #include <memory>
+#include <vector>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
@@ -14,6 +16,7 @@
 
 extern "C"
 {
+#include <libavutil/opt.h>
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libswresample/swresample.h>
@@ -21,7 +24,33 @@ extern "C"
 #include <libavutil/error.h>
 }
 
+#include "pcm_ring.h"
+#include "seek_index.h"
+#include "media_cache.h"
+#include "media_reader.h"
 #include "audio_packet.h"
+#include "spectrum_analyzer.h"
+
+enum class decoder_command_type : uint8_t
+{
+    Open,
+    Seek,
+    Pause,
+    Resume,
+    Close,
+    Quit
+};
+
+struct decoder_command
+{
+    decoder_command_type type;
+    qint64 session_id = 0;
+    QString file;
+    std::shared_ptr<pcm_ring> ring;
+    qint64 position_ms = -1;
+    qint64 posted_ns = 0;
+    bool continuation = false;
+};
 
 class audio_decoder : public QObject
 {
@@ -32,48 +61,86 @@ class audio_decoder : public QObject
     ~audio_decoder() override;
 
     bool is_aborted() const { return abort_request_.load(); }
+    void set_output_preference(const QAudioFormat& format) { output_preference_ = format; }
 
    public slots:
-    void start_decoding(qint64 session_id, const QString& file, qint64 offset = -1);
-    void resume_decoding();
+    void start_decoding(qint64 session_id, const QString& file, const std::shared_ptr<pcm_ring>& ring, qint64 offset = -1);
+    void continue_decoding(qint64 session_id, const QString& file, const std::shared_ptr<pcm_ring>& ring, qint64 from_ms);
     void pause_decoding();
+    void resume_decoding();
     void shutdown();
     void seek(qint64 session_id, qint64 position_ms);
 
    signals:
     void duration_ready(qint64 session_id, qint64 duration_ms, const QAudioFormat& format);
-    void packet_ready(qint64 session_id, const std::shared_ptr<audio_packet>& packet);
     void decoding_finished();
     void seek_finished(qint64 session_id, qint64 actual_seek_ms);
-    void decoding_error(const QString& error_message);
+    void decoding_error(qint64 session_id, const QString& error_message);
     void metadata_ready(qint64 session_id, const QMap<QString, QString>& metadata);
     void cover_art_ready(qint64 session_id, const QByteArray& image_data);
     void lyrics_ready(qint64 session_id, const QList<LyricLine>& lyrics);
 
    private:
-    void decoding_loop();
+    void post_command(decoder_command command);
+    void worker_main();
+    void execute_command(const decoder_command& command);
+    void open_track(const decoder_command& command);
+    void execute_seek(qint64 session_id, qint64 target_ms, bool announce = true);
+    [[nodiscard]] bool can_decode() const;
+    void decode_step();
+    void configure_threading(const AVCodec* codec);
+    void begin_burst();
+    void update_burst(bool finished);
+    [[nodiscard]] qint64 bytes_per_second() const;
 
     bool open_audio_context(const QString& file_path);
     void close_audio_context();
     void process_frame(AVFrame* frame);
+    bool negotiate_output_format();
+    void drain_resampler();
+    void emit_pcm(const uint8_t* data, int size, qint64 timestamp_ms);
+    void close_chunk();
+    void log_chunk_stats(qint64 cpu_ns) const;
+    int samples_before_seek_target(const AVFrame* frame, int64_t frame_pts);
+    void finish_exact_seek(qint64 actual_ms);
+    bool flush_pending_packets();
+    void prepare_seek_index();
+    void record_seek_point(const AVPacket* packet);
+    void store_seek_index();
+    int seek_with_index(int64_t target_ts);
     void process_metadata_and_lyrics(AVDictionary* container_metadata, AVDictionary* stream_metadata);
 
    private:
     QString file_path_;
     qint64 session_id_ = 0;
+    std::shared_ptr<pcm_ring> ring_;
+    std::vector<audio_packet_ptr> pending_packets_;
+    audio_packet_ptr chunk_;
+    int chunk_ms_ = 0;
+    QString replay_gain_mode_;
+    size_t chunk_target_bytes_ = 0;
+    std::unique_ptr<spectrum_analyzer> analyzer_;
+    uint64_t chunks_emitted_ = 0;
+    uint64_t bytes_emitted_ = 0;
+    bool throttled_ = false;
 
     std::thread worker_thread_;
-    std::mutex state_mutex_;
-    std::condition_variable wait_cv_;
-
-    std::atomic<bool> is_running_{false};
+    std::mutex command_mutex_;
+    std::condition_variable command_cv_;
+    std::deque<decoder_command> commands_;
+    std::atomic<bool> command_pending_{false};
     std::atomic<bool> abort_request_{false};
-    bool is_paused_ = true;
-
-    bool seek_requested_ = false;
-    qint64 seek_position_ms_ = -1;
-    qint64 seek_session_id_ = 0;
-
+    bool paused_ = false;
+    bool continuation_ = false;
+    bool at_eof_ = false;
+    qint64 cpu_start_ns_ = 0;
+    qint64 decode_busy_ns_ = 0;
+    qint64 burst_start_ns_ = -1;
+    uint64_t burst_start_bytes_ = 0;
+    qint64 low_water_bytes_ = 0;
+
+    std::unique_ptr<media_reader> reader_;
+    int read_ahead_bytes_ = 0;
     AVFormatContext* format_ctx_ = nullptr;
     AVCodecContext* codec_ctx_ = nullptr;
     SwrContext* swr_ctx_ = nullptr;
@@ -81,15 +148,27 @@ class audio_decoder : public QObject
     AVPacket* packet_ = nullptr;
     uint8_t* swr_data_ = nullptr;
     int swr_data_linesize_ = 0;
+    int swr_capacity_samples_ = 0;
+    bool passthrough_ = false;
+    QAudioFormat output_preference_;
     int audio_stream_index_ = -1;
     qint64 seek_target_exact_ms_ = -1;
+    qint64 seek_report_session_id_ = 0;
+    seek_index seek_index_;
+    media_cache::file_stamp file_stamp_;
+    QByteArray cached_seek_index_;
+    bool params_cache_hit_ = false;
+    qint64 open_started_ns_ = 0;
+    bool building_seek_index_ = false;
+    bool seek_index_gap_ = false;
+    int64_t seek_index_pts_shift_ = 0;
+    int64_t index_sample_cursor_ = -1;
     AVRational time_base_;
     QAudioFormat target_format_;
     AVSampleFormat target_ffmpeg_fmt_ = AV_SAMPLE_FMT_NONE;
     qint64 accumulated_ms_ = 0;
 
     qint64 start_time_offset_ms_ = 0;
-    bool first_frame_processed_ = false;
 };
 
 #endif
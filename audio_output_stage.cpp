@@ -0,0 +1,334 @@
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OUTPUT_STAGE_X86 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define OUTPUT_STAGE_NEON 1
+#endif
+
+#include "cpu_dispatch.h"
+#include "audio_output_stage.h"
+
+namespace
+{
+
+constexpr float kUnityGainEpsilon = 1e-6F;
+
+inline int16_t scale_s16(int16_t sample, float gain)
+{
+    const long scaled = std::lrint(static_cast<float>(sample) * gain);
+    return static_cast<int16_t>(std::clamp(scaled, -32768L, 32767L));
+}
+
+inline int32_t scale_s32(int32_t sample, float gain)
+{
+    const long long scaled = std::llrint(static_cast<double>(sample) * static_cast<double>(gain));
+    return static_cast<int32_t>(std::clamp(scaled, -2147483648LL, 2147483647LL));
+}
+
+void gain_s16_scalar(uint8_t* buffer, size_t samples, float gain)
+{
+    auto* data = reinterpret_cast<int16_t*>(buffer);
+    for (size_t i = 0; i < samples; ++i)
+    {
+        data[i] = scale_s16(data[i], gain);
+    }
+}
+
+void gain_s32_scalar(uint8_t* buffer, size_t samples, float gain)
+{
+    auto* data = reinterpret_cast<int32_t*>(buffer);
+    for (size_t i = 0; i < samples; ++i)
+    {
+        data[i] = scale_s32(data[i], gain);
+    }
+}
+
+void gain_f32_scalar(uint8_t* buffer, size_t samples, float gain)
+{
+    auto* data = reinterpret_cast<float*>(buffer);
+    for (size_t i = 0; i < samples; ++i)
+    {
+        data[i] *= gain;
+    }
+}
+
+#ifdef OUTPUT_STAGE_X86
+
+__attribute__((target("sse2"))) void gain_s16_sse2(uint8_t* buffer, size_t samples, float gain)
+{
+    auto* data = reinterpret_cast<int16_t*>(buffer);
+    const __m128 g = _mm_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8)
+    {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+        const __m128i lo_scaled = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo), g));
+        const __m128i hi_scaled = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi), g));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_packs_epi32(lo_scaled, hi_scaled));
+    }
+    gain_s16_scalar(reinterpret_cast<uint8_t*>(data + i), samples - i, gain);
+}
+
+__attribute__((target("sse2"))) void gain_s32_sse2(uint8_t* buffer, size_t samples, float gain)
+{
+    auto* data = reinterpret_cast<int32_t*>(buffer);
+    const __m128d g = _mm_set1_pd(static_cast<double>(gain));
+    const __m128d lower = _mm_set1_pd(-2147483648.0);
+    const __m128d upper = _mm_set1_pd(2147483647.0);
+    size_t i = 0;
+    for (; i + 4 <= samples; i += 4)
+    {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128d lo = _mm_mul_pd(_mm_cvtepi32_pd(in), g);
+        __m128d hi = _mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(in, _MM_SHUFFLE(1, 0, 3, 2))), g);
+        lo = _mm_min_pd(_mm_max_pd(lo, lower), upper);
+        hi = _mm_min_pd(_mm_max_pd(hi, lower), upper);
+        const __m128i out = _mm_unpacklo_epi64(_mm_cvtpd_epi32(lo), _mm_cvtpd_epi32(hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), out);
+    }
+    gain_s32_scalar(reinterpret_cast<uint8_t*>(data + i), samples - i, gain);
+}
+
+__attribute__((target("sse2"))) void gain_f32_sse2(uint8_t* buffer, size_t samples, float gain)
+{
+    auto* data = reinterpret_cast<float*>(buffer);
+    const __m128 g = _mm_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 4 <= samples; i += 4)
+    {
+        _mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), g));
+    }
+    gain_f32_scalar(reinterpret_cast<uint8_t*>(data + i), samples - i, gain);
+}
+
+__attribute__((target("avx2"))) void gain_s16_avx2(uint8_t* buffer, size_t samples, float gain)
+{
+    auto* data = reinterpret_cast<int16_t*>(buffer);
+    const __m256 g = _mm256_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16)
+    {
+        const __m128i in_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const __m128i in_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 8));
+        const __m256i lo = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(in_lo)), g));
+        const __m256i hi = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(in_hi)), g));
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), packed);
+    }
+    gain_s16_sse2(reinterpret_cast<uint8_t*>(data + i), samples - i, gain);
+}
+
+__attribute__((target("avx2"))) void gain_s32_avx2(uint8_t* buffer, size_t samples, float gain)
+{
+    auto* data = reinterpret_cast<int32_t*>(buffer);
+    const __m256d g = _mm256_set1_pd(static_cast<double>(gain));
+    const __m256d lower = _mm256_set1_pd(-2147483648.0);
+    const __m256d upper = _mm256_set1_pd(2147483647.0);
+    size_t i = 0;
+    for (; i + 4 <= samples; i += 4)
+    {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m256d scaled = _mm256_mul_pd(_mm256_cvtepi32_pd(in), g);
+        scaled = _mm256_min_pd(_mm256_max_pd(scaled, lower), upper);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm256_cvtpd_epi32(scaled));
+    }
+    gain_s32_scalar(reinterpret_cast<uint8_t*>(data + i), samples - i, gain);
+}
+
+__attribute__((target("avx2"))) void gain_f32_avx2(uint8_t* buffer, size_t samples, float gain)
+{
+    auto* data = reinterpret_cast<float*>(buffer);
+    const __m256 g = _mm256_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8)
+    {
+        _mm256_storeu_ps(data + i, _mm256_mul_ps(_mm256_loadu_ps(data + i), g));
+    }
+    gain_f32_sse2(reinterpret_cast<uint8_t*>(data + i), samples - i, gain);
+}
+
+#endif
+
+#ifdef OUTPUT_STAGE_NEON
+
+void gain_s16_neon(uint8_t* buffer, size_t samples, float gain)
+{
+    auto* data = reinterpret_cast<int16_t*>(buffer);
+    const float32x4_t g = vdupq_n_f32(gain);
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8)
+    {
+        const int16x8_t in = vld1q_s16(data + i);
+        const int32x4_t lo = vcvtnq_s32_f32(vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(in))), g));
+        const int32x4_t hi = vcvtnq_s32_f32(vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(in))), g));
+        vst1q_s16(data + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+    gain_s16_scalar(reinterpret_cast<uint8_t*>(data + i), samples - i, gain);
+}
+
+void gain_s32_neon(uint8_t* buffer, size_t samples, float gain)
+{
+    auto* data = reinterpret_cast<int32_t*>(buffer);
+    const float64x2_t g = vdupq_n_f64(static_cast<double>(gain));
+    size_t i = 0;
+    for (; i + 4 <= samples; i += 4)
+    {
+        const int32x4_t in = vld1q_s32(data + i);
+        const int64x2_t lo = vcvtnq_s64_f64(vmulq_f64(vcvtq_f64_s64(vmovl_s32(vget_low_s32(in))), g));
+        const int64x2_t hi = vcvtnq_s64_f64(vmulq_f64(vcvtq_f64_s64(vmovl_s32(vget_high_s32(in))), g));
+        vst1q_s32(data + i, vcombine_s32(vqmovn_s64(lo), vqmovn_s64(hi)));
+    }
+    gain_s32_scalar(reinterpret_cast<uint8_t*>(data + i), samples - i, gain);
+}
+
+void gain_f32_neon(uint8_t* buffer, size_t samples, float gain)
+{
+    auto* data = reinterpret_cast<float*>(buffer);
+    const float32x4_t g = vdupq_n_f32(gain);
+    size_t i = 0;
+    for (; i + 4 <= samples; i += 4)
+    {
+        vst1q_f32(data + i, vmulq_f32(vld1q_f32(data + i), g));
+    }
+    gain_f32_scalar(reinterpret_cast<uint8_t*>(data + i), samples - i, gain);
+}
+
+#endif
+
+struct kernel_set
+{
+    void (*s16)(uint8_t*, size_t, float);
+    void (*s32)(uint8_t*, size_t, float);
+    void (*f32)(uint8_t*, size_t, float);
+    const char* name;
+};
+
+const dispatch_table<kernel_set>& kernels()
+{
+    static const dispatch_table<kernel_set> table{
+#ifdef OUTPUT_STAGE_X86
+        {cpu_feature::kAvx2, {gain_s16_avx2, gain_s32_avx2, gain_f32_avx2, "avx2"}},
+        {cpu_feature::kSse2, {gain_s16_sse2, gain_s32_sse2, gain_f32_sse2, "sse2"}},
+#endif
+#ifdef OUTPUT_STAGE_NEON
+        {cpu_feature::kNeon, {gain_s16_neon, gain_s32_neon, gain_f32_neon, "neon"}},
+#endif
+        {cpu_feature::kNone, {gain_s16_scalar, gain_s32_scalar, gain_f32_scalar, "scalar"}},
+    };
+    return table;
+}
+
+}  // namespace
+
+audio_output_stage::audio_output_stage() : kernel_(kernels().names()) {}
+
+const char* audio_output_stage::kernel_name() { return kernels()[0].name; }
+
+bool audio_output_stage::configure(SDL_AudioFormat format, int channels)
+{
+    channels_ = static_cast<size_t>(std::max(1, channels));
+    switch (format)
+    {
+        case AUDIO_S16SYS:
+            type_ = sample_type::S16;
+            sample_bytes_ = sizeof(int16_t);
+            break;
+        case AUDIO_S32SYS:
+            type_ = sample_type::S32;
+            sample_bytes_ = sizeof(int32_t);
+            break;
+        case AUDIO_F32SYS:
+            type_ = sample_type::F32;
+            sample_bytes_ = sizeof(float);
+            break;
+        default:
+            type_ = sample_type::Unsupported;
+            sample_bytes_ = 1;
+            return false;
+    }
+    snap_to_target();
+    return true;
+}
+
+void audio_output_stage::set_gain(float gain) { target_gain_.store(std::max(0.0F, gain), std::memory_order_relaxed); }
+
+void audio_output_stage::set_track_gain(float gain) { track_gain_ = std::max(0.0F, gain); }
+
+void audio_output_stage::snap_to_target() { current_gain_ = target_gain_.load(std::memory_order_relaxed); }
+
+void audio_output_stage::apply(uint8_t* buffer, size_t bytes)
+{
+    if (type_ == sample_type::Unsupported)
+    {
+        return;
+    }
+
+    const float target = target_gain_.load(std::memory_order_relaxed);
+    const size_t frames = bytes / (sample_bytes_ * channels_);
+
+    if (std::fabs(target - current_gain_) > kUnityGainEpsilon)
+    {
+        apply_ramp(buffer, frames, current_gain_ * track_gain_, target * track_gain_);
+        current_gain_ = target;
+        return;
+    }
+
+    const float gain = target * track_gain_;
+    if (std::fabs(gain - 1.0F) <= kUnityGainEpsilon)
+    {
+        return;
+    }
+
+    const kernel_set& set = kernels()[kernel_.index()];
+    const gain_kernel fn = type_ == sample_type::S16 ? set.s16 : type_ == sample_type::S32 ? set.s32 : set.f32;
+    fn(buffer, frames * channels_, gain);
+}
+
+void audio_output_stage::apply_ramp(uint8_t* buffer, size_t frames, float from, float to) const
+{
+    if (frames == 0)
+    {
+        return;
+    }
+
+    const float step = (to - from) / static_cast<float>(frames);
+    for (size_t frame = 0; frame < frames; ++frame)
+    {
+        const float gain = from + step * static_cast<float>(frame + 1);
+        for (size_t ch = 0; ch < channels_; ++ch)
+        {
+            const size_t index = frame * channels_ + ch;
+            switch (type_)
+            {
+                case sample_type::S16:
+                {
+                    auto* data = reinterpret_cast<int16_t*>(buffer);
+                    data[index] = scale_s16(data[index], gain);
+                    break;
+                }
+                case sample_type::S32:
+                {
+                    auto* data = reinterpret_cast<int32_t*>(buffer);
+                    data[index] = scale_s32(data[index], gain);
+                    break;
+                }
+                case sample_type::F32:
+                {
+                    auto* data = reinterpret_cast<float*>(buffer);
+                    data[index] *= gain;
+                    break;
+                }
+                case sample_type::Unsupported:
+                    return;
+            }
+        }
+    }
+}
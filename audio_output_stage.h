@@ -0,0 +1,52 @@
+#ifndef AUDIO_OUTPUT_STAGE_H
+#define AUDIO_OUTPUT_STAGE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <SDL.h>
+#include "cpu_dispatch.h"
+
+class audio_output_stage
+{
+   public:
+    enum class sample_type : uint8_t
+    {
+        Unsupported,
+        S16,
+        S32,
+        F32,
+    };
+
+    audio_output_stage();
+
+    audio_output_stage(const audio_output_stage&) = delete;
+    audio_output_stage& operator=(const audio_output_stage&) = delete;
+
+    bool configure(SDL_AudioFormat format, int channels);
+    void set_gain(float gain);
+    void set_track_gain(float gain);
+    void snap_to_target();
+    void apply(uint8_t* buffer, size_t bytes);
+    kernel_choice& kernel() { return kernel_; }
+
+    [[nodiscard]] sample_type type() const { return type_; }
+    [[nodiscard]] static const char* kernel_name();
+
+   private:
+    void apply_ramp(uint8_t* buffer, size_t frames, float from, float to) const;
+
+   private:
+    using gain_kernel = void (*)(uint8_t* buffer, size_t samples, float gain);
+
+    sample_type type_ = sample_type::Unsupported;
+    size_t channels_ = 2;
+    size_t sample_bytes_ = 2;
+    kernel_choice kernel_;
+
+    std::atomic<float> target_gain_{1.0F};
+    float current_gain_ = 1.0F;
+    float track_gain_ = 1.0F;
+};
+
+#endif
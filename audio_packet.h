@@ -1,26 +1,44 @@
 #ifndef AUDIO_PACKET
 #define AUDIO_PACKET
 
+#include <atomic>
 #include <cstdint>
 #include <vector>
+#include <QAudioFormat>
 #include <QMetaType>
 #include <QString>
 #include <QList>
+#include <boost/smart_ptr/intrusive_ptr.hpp>
+
+class audio_packet_pool;
 
 struct audio_packet
 {
-    int64_t ms;
+    int64_t ms = 0;
     std::vector<uint8_t> data;
     size_t bytes_played = 0;
+    uint32_t serial = 0;
+    QAudioFormat::SampleFormat format = QAudioFormat::Int16;
+    int channels = 2;
+    int sample_rate = 0;
+
+    std::atomic<int> ref_count{0};
+    audio_packet_pool* pool = nullptr;
 };
 
+inline void intrusive_ptr_add_ref(audio_packet* packet) { packet->ref_count.fetch_add(1, std::memory_order_relaxed); }
+
+void intrusive_ptr_release(audio_packet* packet);
+
+using audio_packet_ptr = boost::intrusive_ptr<audio_packet>;
+
 struct LyricLine
 {
     qint64 timestamp_ms;
     QString text;
 };
 
-Q_DECLARE_METATYPE(std::shared_ptr<audio_packet>);
+Q_DECLARE_METATYPE(audio_packet_ptr);
 Q_DECLARE_METATYPE(QList<LyricLine>);
 
 #endif
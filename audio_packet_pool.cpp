@@ -0,0 +1,90 @@
+#include "audio_packet_pool.h"
+
+void intrusive_ptr_release(audio_packet* packet)
+{
+    if (packet->ref_count.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+
+    if (packet->pool != nullptr)
+    {
+        packet->pool->release(packet);
+    }
+    else
+    {
+        delete packet;
+    }
+}
+
+audio_packet_pool& audio_packet_pool::instance()
+{
+    static audio_packet_pool pool;
+    return pool;
+}
+
+audio_packet_pool::audio_packet_pool()
+{
+    slabs_.reserve(kPacketPoolCapacity);
+    for (size_t i = 0; i < kPacketPoolCapacity; ++i)
+    {
+        auto packet = std::make_unique<audio_packet>();
+        packet->data.reserve(kPacketSlabBytes);
+        packet->pool = this;
+        free_list_.bounded_push(packet.get());
+        slabs_.push_back(std::move(packet));
+    }
+}
+
+audio_packet_ptr audio_packet_pool::acquire(size_t bytes)
+{
+    audio_packet* packet = nullptr;
+    if (!free_list_.pop(packet))
+    {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        auto* transient = new audio_packet();
+        transient->data.reserve(bytes);
+        return audio_packet_ptr(transient);
+    }
+
+    if (packet->data.capacity() >= bytes)
+    {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        packet->data.reserve(bytes);
+    }
+
+    const int64_t in_use = in_use_.fetch_add(1, std::memory_order_relaxed) + 1;
+    int64_t high_water = high_water_.load(std::memory_order_relaxed);
+    while (in_use > high_water && !high_water_.compare_exchange_weak(high_water, in_use, std::memory_order_relaxed))
+    {
+    }
+
+    packet->ms = 0;
+    packet->bytes_played = 0;
+    packet->serial = 0;
+    packet->format = QAudioFormat::Int16;
+    packet->channels = 2;
+    packet->sample_rate = 0;
+    packet->data.clear();
+    return audio_packet_ptr(packet);
+}
+
+void audio_packet_pool::release(audio_packet* packet)
+{
+    in_use_.fetch_sub(1, std::memory_order_relaxed);
+    free_list_.bounded_push(packet);
+}
+
+audio_packet_pool::stats audio_packet_pool::snapshot() const
+{
+    stats s;
+    s.hits = hits_.load(std::memory_order_relaxed);
+    s.misses = misses_.load(std::memory_order_relaxed);
+    s.in_use = in_use_.load(std::memory_order_relaxed);
+    s.high_water = high_water_.load(std::memory_order_relaxed);
+    return s;
+}
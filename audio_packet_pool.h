@@ -0,0 +1,48 @@
+#ifndef AUDIO_PACKET_POOL_H
+#define AUDIO_PACKET_POOL_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <boost/lockfree/queue.hpp>
+
+#include "audio_packet.h"
+
+constexpr size_t kPacketPoolCapacity = 384;
+constexpr size_t kPacketSlabBytes = 32 * 1024;
+
+class audio_packet_pool
+{
+   public:
+    struct stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        int64_t in_use = 0;
+        int64_t high_water = 0;
+    };
+
+    static audio_packet_pool& instance();
+
+    audio_packet_pool(const audio_packet_pool&) = delete;
+    audio_packet_pool& operator=(const audio_packet_pool&) = delete;
+
+    audio_packet_ptr acquire(size_t bytes);
+    void release(audio_packet* packet);
+    [[nodiscard]] stats snapshot() const;
+
+   private:
+    audio_packet_pool();
+    ~audio_packet_pool() = default;
+
+   private:
+    std::vector<std::unique_ptr<audio_packet>> slabs_;
+    boost::lockfree::queue<audio_packet*, boost::lockfree::capacity<kPacketPoolCapacity>> free_list_;
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<int64_t> in_use_{0};
+    std::atomic<int64_t> high_water_{0};
+};
+
+#endif
@@ -1,18 +1,22 @@
 #include <cmath>
 #include <algorithm>
-#include <QMetaObject>
 #include "log.h"
+#include "rt_checks.h"
 #include "audio_player.h"
 
-constexpr int kProgressUpdateIntervalMs = 50;
-constexpr auto kBufferLowWatermarkSeconds = 2L;
-constexpr auto kBufferHighWatermarkSeconds = 5L;
+constexpr int kEventDrainIntervalMs = 10;
+
+static bool has_audible_sample(const Uint8* data, size_t size)
+{
+    return std::any_of(data, data + size, [](Uint8 byte) { return byte != 0; });
+}
 
 void audio_player::audio_callback(void* userdata, Uint8* stream, int len)
 {
     auto* player = static_cast<audio_player*>(userdata);
     if (player != nullptr)
     {
+        RT_SCOPE();
         player->fill_audio_buffer(stream, len);
     }
 }
@@ -26,35 +30,173 @@ audio_player::audio_player(QObject* parent) : QObject(parent)
     else
     {
         LOG_DEBUG("sdl 音频子系统已初始化");
+        query_preferred_format();
     }
 
-    progress_timer_ = new QTimer(this);
-    progress_timer_->setInterval(kProgressUpdateIntervalMs);
-    connect(progress_timer_, &QTimer::timeout, this, &audio_player::update_progress_ui);
+    event_timer_ = new QTimer(this);
+    event_timer_->setInterval(kEventDrainIntervalMs);
+    connect(event_timer_, &QTimer::timeout, this, &audio_player::drain_events);
 }
 
 audio_player::~audio_player()
 {
     stop_playback();
+    close_device();
     SDL_Quit();
     LOG_DEBUG("音频播放器已销毁 sdl 已退出");
 }
 
 void audio_player::clear_queue()
 {
-    packet_queue_.consume_all([](const std::shared_ptr<audio_packet>&) {});
     current_packet_.reset();
-    approx_buffered_bytes_.store(0);
+    completion_posted_ = false;
+    measuring_gap_ = false;
+}
+
+int audio_player::bytes_per_frame() const { return audio_spec_.channels * static_cast<int>(SDL_AUDIO_BITSIZE(audio_spec_.format) / 8); }
+
+void audio_player::queue_next(qint64 session_id, const std::shared_ptr<pcm_ring>& ring, quint64 generation)
+{
+    if (device_id_ == 0)
+    {
+        return;
+    }
+
+    SDL_LockAudioDevice(device_id_);
+    next_ring_ = ring;
+    next_session_id_ = ring ? session_id : 0;
+    next_generation_ = generation;
+    SDL_UnlockAudioDevice(device_id_);
+
+    if (ring)
+    {
+        LOG_INFO("无缝播放 sdl 播放器已排队下一首 会话id {}", session_id);
+    }
+}
+
+void audio_player::post_event(player_event_type type, qint64 value)
+{
+    player_event event;
+    event.type = type;
+    event.value = value;
+    event.timestamp_ns = steady_clock_ns();
+    event_ring_.push(event);
+}
+
+bool audio_player::pop_current_packet()
+{
+    while (ring_->pop(current_packet_))
+    {
+        if (ring_->is_current(current_packet_))
+        {
+            return true;
+        }
+        if (!retire_current_packet())
+        {
+            current_packet_->bytes_played = current_packet_->data.size();
+            return false;
+        }
+    }
+    return false;
+}
+
+bool audio_player::retire_current_packet()
+{
+    if (!retired_packets_.push(current_packet_))
+    {
+        return false;
+    }
+    current_packet_.reset();
+    return true;
+}
+
+void audio_player::drain_events()
+{
+    player_event event;
+    while (event_ring_.pop(event))
+    {
+        switch (event.type)
+        {
+            case player_event_type::TrackSwitched:
+                LOG_DEBUG("无缝播放 切换通知延迟 {:.2f} ms", static_cast<double>(steady_clock_ns() - event.timestamp_ns) / 1e6);
+                on_track_switched_internal(event.value);
+                break;
+            case player_event_type::GapMeasured:
+                on_gap_measured_internal(event.value);
+                break;
+            case player_event_type::FirstSample:
+                on_first_sample_internal(event.value);
+                break;
+            case player_event_type::PlaybackCompleted:
+                on_playback_completed_internal();
+                break;
+            case player_event_type::ScrubGrain:
+                on_scrub_grain_internal(event.value);
+                break;
+        }
+    }
+
+    retired_packets_.consume_all([](const audio_packet_ptr&) {});
+    retired_rings_.consume_all([](const std::shared_ptr<pcm_ring>&) {});
+}
+
+bool audio_player::next_ring_pending() const
+{
+    return next_ring_ && next_generation_ == preload_generation_.load(std::memory_order_acquire);
+}
+
+bool audio_player::switch_to_next_ring(Uint8* position)
+{
+    if (!retired_rings_.push(ring_))
+    {
+        return false;
+    }
+    ring_ = std::move(next_ring_);
+    next_ring_.reset();
+    const qint64 switched_session_id = next_session_id_;
+    next_session_id_ = 0;
+
+    completion_posted_ = false;
+    bytes_processed_by_device_ = 0;
+    clock_->reset(switched_session_id, 0, audio_spec_.freq, audio_spec_.samples);
+
+    measuring_gap_ = true;
+    gap_start_ = position;
+    gap_bytes_ = 0;
+
+    post_event(player_event_type::TrackSwitched, switched_session_id);
+    return true;
+}
+
+void audio_player::on_track_switched_internal(qint64 session_id)
+{
+    LOG_INFO("无缝播放 sdl 播放器已切换到下一首 会话id {} -> {}", session_id_, session_id);
+    const qint64 from_session_id = session_id_;
+    session_id_ = session_id;
+    emit track_switched(from_session_id, session_id);
+}
+
+void audio_player::on_first_sample_internal(qint64 latency_ns)
+{
+    LOG_INFO("播放指标 从请求播放到首个非静音采样 {:.2f} ms 会话id {}", static_cast<double>(latency_ns) / 1e6, session_id_);
+}
+
+void audio_player::on_scrub_grain_internal(qint64 latency_ns)
+{
+    LOG_DEBUG("拖动预览 从拖动到颗粒送入设备 {:.2f} ms", static_cast<double>(latency_ns) / 1e6);
+}
+
+void audio_player::on_gap_measured_internal(qint64 gap_samples)
+{
+    LOG_INFO("无缝播放 曲间静音 {} 个采样 会话id {}", gap_samples, session_id_);
 }
 
 void audio_player::set_volume(int volume_percent)
 {
     int clamped_percent = qBound(0, volume_percent, 100);
-    float factor = std::pow(static_cast<float>(clamped_percent) / 100.0F, 3.0F);
-    int sdl_volume = static_cast<int>(factor * SDL_MIX_MAXVOLUME);
-
-    volume_.store(sdl_volume);
-    LOG_DEBUG("音量已设置为 SDL: {} (UI: {}%)", sdl_volume, volume_percent);
+    volume_factor_ = std::pow(static_cast<float>(clamped_percent) / 100.0F, 3.0F);
+    output_stage_.set_gain(volume_factor_);
+    LOG_DEBUG("音量已设置为 增益: {:.4f} (UI: {}%)", volume_factor_, volume_percent);
 }
 
 void audio_player::on_playback_completed_internal()
@@ -67,70 +209,158 @@ void audio_player::on_playback_completed_internal()
     LOG_INFO("结束流程 3/4 sdl 缓冲区播放完毕 暂停设备并通知控制中心 会话id {}", session_id_);
 
     is_playing_ = false;
-    progress_timer_->stop();
+    event_timer_->stop();
 
     if (device_id_ != 0)
     {
         SDL_PauseAudioDevice(device_id_, 1);
     }
+    clock_->set_running(false, steady_clock_ns());
 
     emit playback_finished(session_id_);
 }
 
-void audio_player::start_playback(qint64 session_id, const QAudioFormat& format, qint64 start_offset_ms)
+static QAudioFormat::SampleFormat qt_sample_format(SDL_AudioFormat format)
 {
-    session_id_ = session_id;
-    LOG_INFO("播放流程 8/14 sdl 播放器收到启动命令 会话id {}", session_id_);
+    switch (format)
+    {
+        case AUDIO_F32SYS:
+            return QAudioFormat::Float;
+        case AUDIO_S32SYS:
+            return QAudioFormat::Int32;
+        default:
+            return QAudioFormat::Int16;
+    }
+}
 
-    stop_playback();
+static SDL_AudioFormat sdl_sample_format(QAudioFormat::SampleFormat format)
+{
+    switch (format)
+    {
+        case QAudioFormat::Float:
+            return AUDIO_F32SYS;
+        case QAudioFormat::Int32:
+            return AUDIO_S32SYS;
+        default:
+            return AUDIO_S16SYS;
+    }
+}
 
-    last_format_ = format;
+void audio_player::query_preferred_format()
+{
+#if SDL_VERSION_ATLEAST(2, 24, 0)
+    char* name = nullptr;
+    SDL_AudioSpec spec;
+    SDL_zero(spec);
+    if (SDL_GetDefaultAudioInfo(&name, &spec, 0) != 0)
+    {
+        LOG_WARN("无法查询默认音频设备参数 {} 解码器将保持源采样率", SDL_GetError());
+        return;
+    }
+
+    preferred_format_.setSampleRate(spec.freq);
+    preferred_format_.setChannelCount(spec.channels);
+    preferred_format_.setSampleFormat(qt_sample_format(spec.format));
+    LOG_INFO("默认音频设备 {} 首选 {}hz {}声道 格式 {}", name != nullptr ? name : "unknown", spec.freq, spec.channels, (int)spec.format);
+    SDL_free(name);
+#else
+    LOG_DEBUG("sdl 版本过低 无法查询默认音频设备参数 解码器将保持源采样率");
+#endif
+}
 
+bool audio_player::open_device(const QAudioFormat& format)
+{
     SDL_AudioSpec desired_spec;
     SDL_zero(desired_spec);
     desired_spec.freq = format.sampleRate();
     desired_spec.channels = static_cast<uint8_t>(format.channelCount());
-    desired_spec.format = AUDIO_S16LSB;
+    desired_spec.format = sdl_sample_format(format.sampleFormat());
     desired_spec.silence = 0;
     desired_spec.samples = 2048;
     desired_spec.callback = audio_callback;
     desired_spec.userdata = this;
 
-    device_id_ = SDL_OpenAudioDevice(nullptr, 0, &desired_spec, &audio_spec_, 0);
+    SDL_AudioSpec obtained_spec;
+    SDL_zero(obtained_spec);
 
-    if (device_id_ == 0)
+    SDL_AudioDeviceID new_dev = SDL_OpenAudioDevice(nullptr, 0, &desired_spec, &obtained_spec, 0);
+    if (new_dev == 0)
     {
         LOG_ERROR("sdl 打开音频设备失败 {}", SDL_GetError());
-        emit playback_error(QString("打开音频设备失败 %1").arg(SDL_GetError()));
-        return;
+        return false;
     }
-    LOG_INFO("sdl 音频设备已打开 id {}", device_id_);
+
+    audio_spec_ = obtained_spec;
+    device_id_ = new_dev;
+    last_format_ = format;
+    if (!output_stage_.configure(audio_spec_.format, audio_spec_.channels))
+    {
+        LOG_WARN("输出级不支持 sdl 格式 {} 音量调节将被跳过", (int)audio_spec_.format);
+    }
+    LOG_INFO("sdl 音频设备已打开 id {} 输出级内核 {}", device_id_, audio_output_stage::kernel_name());
     LOG_DEBUG("sdl 设备参数 频率 {}hz 声道 {} 格式 {} 缓冲区大小 {} 字节",
               audio_spec_.freq,
               audio_spec_.channels,
               (int)audio_spec_.format,
               audio_spec_.size);
+    return true;
+}
 
-    clear_queue();
+void audio_player::close_device()
+{
+    if (device_id_ == 0)
+    {
+        return;
+    }
 
-    playback_start_offset_ms_ = start_offset_ms;
-    bytes_processed_by_device_ = 0;
-    decoder_finished_ = false;
-    is_playing_ = true;
+    SDL_PauseAudioDevice(device_id_, 1);
+    SDL_CloseAudioDevice(device_id_);
+    device_id_ = 0;
+    LOG_DEBUG("sdl 音频设备已关闭");
+}
+
+void audio_player::start_playback(
+    qint64 session_id, const QAudioFormat& format, const std::shared_ptr<pcm_ring>& ring, qint64 start_offset_ms, qint64 request_time_ns)
+{
+    LOG_INFO("播放流程 8/14 sdl 播放器收到启动命令 会话id {}", session_id);
+
+    stop_playback();
+    session_id_ = session_id;
+
+    if (device_id_ != 0 && format == last_format_)
+    {
+        LOG_INFO("sdl 音频格式未变 复用已打开的设备 id {}", device_id_);
+    }
+    else
+    {
+        if (device_id_ != 0)
+        {
+            LOG_INFO("sdl 音频格式变化 {}hz {}声道 -> {}hz {}声道 重新打开设备",
+                     last_format_.sampleRate(),
+                     last_format_.channelCount(),
+                     format.sampleRate(),
+                     format.channelCount());
+        }
+        close_device();
+        if (!open_device(format))
+        {
+            emit playback_error(QString("打开音频设备失败 %1").arg(SDL_GetError()));
+            return;
+        }
+    }
 
-    qint64 bytes_per_second = static_cast<qint64>(audio_spec_.freq) * audio_spec_.channels * static_cast<qint64>(sizeof(qint16));
-    buffer_low_water_mark_ = bytes_per_second * kBufferLowWatermarkSeconds;
-    buffer_high_water_mark_ = bytes_per_second * kBufferHighWatermarkSeconds;
+    SDL_LockAudioDevice(device_id_);
+    clear_queue();
+    ring_ = ring;
+    output_stage_.set_track_gain(ring ? ring->replay_gain() : 1.0F);
+    bytes_processed_by_device_ = 0;
+    clock_->reset(session_id, start_offset_ms, audio_spec_.freq, audio_spec_.samples);
+    first_sample_request_ns_ = request_time_ns;
+    SDL_UnlockAudioDevice(device_id_);
 
-    low_water_mark_triggered_ = true;
-    high_water_mark_triggered_ = false;
-    LOG_DEBUG("sdl 缓冲区低水位线设置为 {} 字节 {} 秒 高水位线设置为 {} 字节 {} 秒",
-              buffer_low_water_mark_,
-              kBufferLowWatermarkSeconds,
-              buffer_high_water_mark_,
-              kBufferHighWatermarkSeconds);
+    is_playing_ = true;
 
-    progress_timer_->start();
+    event_timer_->start();
     SDL_PauseAudioDevice(device_id_, 0);
 
     LOG_INFO("播放流程 10/14 sdl 播放器准备就绪 通知控制中心 会话id {}", session_id_);
@@ -139,55 +369,35 @@ void audio_player::start_playback(qint64 session_id, const QAudioFormat& format,
 
 void audio_player::stop_playback()
 {
-    if (!is_playing_.load() && device_id_ == 0)
+    if (!is_playing_.load() && !ring_)
     {
         return;
     }
     LOG_INFO("停止流程 3/4 sdl 播放器收到停止命令 会话id {}", session_id_);
     is_playing_ = false;
 
-    progress_timer_->stop();
+    event_timer_->stop();
 
     if (device_id_ != 0)
     {
+        SDL_PauseAudioDevice(device_id_, 1);
+
         SDL_LockAudioDevice(device_id_);
         clear_queue();
+        ring_.reset();
+        next_ring_.reset();
+        next_session_id_ = 0;
+        first_sample_request_ns_ = 0;
+        clock_->stop();
+        event_ring_.consume_all([](const player_event&) {});
+        scrubbing_.store(false, std::memory_order_release);
+        scrub_packet_.reset();
+        scrub_grains_.consume_all([](const scrub_grain&) {});
         SDL_UnlockAudioDevice(device_id_);
 
-        SDL_PauseAudioDevice(device_id_, 1);
-        SDL_CloseAudioDevice(device_id_);
-        device_id_ = 0;
-        LOG_DEBUG("sdl 音频设备已关闭");
-    }
-}
-
-void audio_player::enqueue_packet(qint64 session_id, const std::shared_ptr<audio_packet>& packet)
-{
-    if (session_id != session_id_)
-    {
-        return;
-    }
-
-    if (packet == nullptr)
-    {
-        LOG_INFO("结束流程 2/4 sdl 收到来自控制中心的文件结束信号");
-        decoder_finished_ = true;
-        return;
-    }
-
-    if (packet_queue_.push(packet))
-    {
-        approx_buffered_bytes_.fetch_add(packet->data.size(), std::memory_order_relaxed);
-        low_water_mark_triggered_ = false;
-    }
-
-    qint64 current_buffer_size = approx_buffered_bytes_.load(std::memory_order_relaxed);
-
-    if (!high_water_mark_triggered_ && current_buffer_size >= buffer_high_water_mark_)
-    {
-        LOG_TRACE("sdl 缓冲区水位高 {} 字节，发出高水位信号", current_buffer_size);
-        high_water_mark_triggered_ = true;
-        QMetaObject::invokeMethod(this, "buffer_level_high", Qt::QueuedConnection, Q_ARG(qint64, session_id_));
+        retired_packets_.consume_all([](const audio_packet_ptr&) {});
+        retired_rings_.consume_all([](const std::shared_ptr<pcm_ring>&) {});
+        LOG_DEBUG("sdl 音频设备已暂停 保持打开以供下一首复用");
     }
 }
 
@@ -206,12 +416,8 @@ void audio_player::handle_seek(qint64 session_id, qint64 actual_seek_ms)
 
         clear_queue();
 
-        playback_start_offset_ms_ = actual_seek_ms;
         bytes_processed_by_device_ = 0;
-        decoder_finished_ = false;
-
-        low_water_mark_triggered_ = true;
-        high_water_mark_triggered_ = false;
+        clock_->reset(session_id_, actual_seek_ms, audio_spec_.freq, audio_spec_.samples);
 
         SDL_UnlockAudioDevice(device_id_);
 
@@ -221,9 +427,9 @@ void audio_player::handle_seek(qint64 session_id, qint64 actual_seek_ms)
             SDL_PauseAudioDevice(device_id_, 0);
         }
 
-        if (!progress_timer_->isActive())
+        if (!event_timer_->isActive())
         {
-            progress_timer_->start();
+            event_timer_->start();
         }
 
         LOG_INFO("跳转流程 8/10 sdl 复用现有设备完成跳转");
@@ -238,98 +444,194 @@ void audio_player::handle_seek(qint64 session_id, qint64 actual_seek_ms)
         return;
     }
 
-    SDL_AudioSpec desired_spec;
-    SDL_zero(desired_spec);
-    desired_spec.freq = last_format_.sampleRate();
-    desired_spec.channels = static_cast<uint8_t>(last_format_.channelCount());
-    desired_spec.format = AUDIO_S16LSB;
-    desired_spec.silence = 0;
-    desired_spec.samples = 2048;
-    desired_spec.callback = audio_callback;
-    desired_spec.userdata = this;
-
-    SDL_AudioSpec obtained_spec;
-    SDL_zero(obtained_spec);
-
-    SDL_AudioDeviceID new_dev = SDL_OpenAudioDevice(nullptr, 0, &desired_spec, &obtained_spec, 0);
-
-    if (new_dev == 0)
+    if (!open_device(last_format_))
     {
-        LOG_ERROR("sdl 在 seek 期间打开音频设备失败 {}", SDL_GetError());
         emit playback_error("为跳转操作打开音频设备失败");
         return;
     }
-
-    audio_spec_ = obtained_spec;
-    device_id_ = new_dev;
-    LOG_INFO("sdl 音频设备已为 seek 新建打开 id {}", new_dev);
+    LOG_INFO("sdl 音频设备已为 seek 新建打开 id {}", device_id_);
 
     clear_queue();
 
-    playback_start_offset_ms_ = actual_seek_ms;
     bytes_processed_by_device_ = 0;
-    decoder_finished_ = false;
-    low_water_mark_triggered_ = true;
-    high_water_mark_triggered_ = false;
+    clock_->reset(session_id_, actual_seek_ms, audio_spec_.freq, audio_spec_.samples);
     is_playing_ = true;
 
-    if (!progress_timer_->isActive())
+    if (!event_timer_->isActive())
     {
-        progress_timer_->start();
+        event_timer_->start();
     }
 
-    SDL_PauseAudioDevice(new_dev, 0);
+    SDL_PauseAudioDevice(device_id_, 0);
 
     LOG_INFO("跳转流程 8/10 sdl 跳转处理完毕 通知控制中心");
     emit seek_handled(session_id_);
 }
 
-void audio_player::pause_feeding(qint64 session_id) const
+void audio_player::pause_feeding(qint64 session_id)
 {
     if (session_id != session_id_ || device_id_ == 0)
     {
         return;
     }
     SDL_PauseAudioDevice(device_id_, 1);
+    clock_->set_running(false, steady_clock_ns());
     LOG_INFO("sdl 音频设备已暂停");
 }
 
-void audio_player::resume_feeding(qint64 session_id) const
+void audio_player::resume_feeding(qint64 session_id)
 {
     if (session_id != session_id_ || device_id_ == 0)
     {
         return;
     }
+    clock_->set_running(true, steady_clock_ns());
     SDL_PauseAudioDevice(device_id_, 0);
     LOG_INFO("sdl 音频设备已恢复");
 }
 
+void audio_player::queue_scrub_grain(const audio_packet_ptr& grain, qint64 requested_ns)
+{
+    if (scrubbing_.load(std::memory_order_acquire))
+    {
+        scrub_grains_.push(scrub_grain{grain, requested_ns});
+    }
+}
+
+void audio_player::begin_scrub(qint64 session_id)
+{
+    if (session_id != session_id_ || device_id_ == 0 || scrubbing_.load())
+    {
+        return;
+    }
+
+    SDL_LockAudioDevice(device_id_);
+    const qint64 now_ns = steady_clock_ns();
+    scrub_resume_clock_ = clock_->read(now_ns).running;
+    clock_->set_running(false, now_ns);
+    scrub_grains_.consume_all([](const scrub_grain&) {});
+    scrubbing_.store(true, std::memory_order_release);
+    SDL_UnlockAudioDevice(device_id_);
+    if (!event_timer_->isActive())
+    {
+        event_timer_->start();
+    }
+    SDL_PauseAudioDevice(device_id_, 0);
+    LOG_DEBUG("拖动预览 开始 会话id {}", session_id);
+}
+
+void audio_player::end_scrub(qint64 session_id)
+{
+    if (!scrubbing_.load() || device_id_ == 0)
+    {
+        return;
+    }
+
+    SDL_LockAudioDevice(device_id_);
+    scrubbing_.store(false, std::memory_order_release);
+    scrub_packet_.reset();
+    scrub_grains_.consume_all([](const scrub_grain&) {});
+    const bool resume = scrub_resume_clock_ && is_playing_.load();
+    if (resume)
+    {
+        clock_->set_running(true, steady_clock_ns());
+    }
+    SDL_UnlockAudioDevice(device_id_);
+
+    if (!resume)
+    {
+        SDL_PauseAudioDevice(device_id_, 1);
+    }
+    LOG_DEBUG("拖动预览 结束 会话id {}", session_id);
+}
+
+void audio_player::fill_scrub_buffer(Uint8* stream, int len)
+{
+    Uint8* stream_ptr = stream;
+    int bytes_to_fill = len;
+    while (bytes_to_fill > 0)
+    {
+        if (!scrub_packet_)
+        {
+            scrub_grain grain;
+            bool popped = false;
+            while (scrub_grains_.read_available() > 0)
+            {
+                if (popped && !retired_packets_.push(scrub_packet_))
+                {
+                    break;
+                }
+                scrub_grains_.pop(grain);
+                scrub_packet_ = std::move(grain.packet);
+                popped = true;
+            }
+            if (!popped)
+            {
+                break;
+            }
+            post_event(player_event_type::ScrubGrain, steady_clock_ns() - grain.requested_ns);
+        }
+
+        const size_t bytes_remaining = scrub_packet_->data.size() - scrub_packet_->bytes_played;
+        const size_t bytes_to_copy = std::min(static_cast<size_t>(bytes_to_fill), bytes_remaining);
+        SDL_memcpy(stream_ptr, scrub_packet_->data.data() + scrub_packet_->bytes_played, bytes_to_copy);
+        stream_ptr += bytes_to_copy;
+        bytes_to_fill -= static_cast<int>(bytes_to_copy);
+        scrub_packet_->bytes_played += bytes_to_copy;
+
+        if (scrub_packet_->bytes_played >= scrub_packet_->data.size())
+        {
+            if (!retired_packets_.push(scrub_packet_))
+            {
+                break;
+            }
+            scrub_packet_.reset();
+        }
+    }
+
+    if (bytes_to_fill > 0)
+    {
+        SDL_memset(stream_ptr, audio_spec_.silence, static_cast<size_t>(bytes_to_fill));
+    }
+    output_stage_.apply(stream, static_cast<size_t>(len));
+}
+
 void audio_player::fill_audio_buffer(Uint8* stream, int len)
 {
-    SDL_memset(stream, 0, static_cast<size_t>(len));
+    if (scrubbing_.load(std::memory_order_acquire))
+    {
+        fill_scrub_buffer(stream, len);
+        return;
+    }
 
-    if (!is_playing_)
+    if (!is_playing_ || !ring_)
     {
+        SDL_memset(stream, audio_spec_.silence, static_cast<size_t>(len));
         return;
     }
 
     Uint8* stream_ptr = stream;
+    Uint8* gain_start = stream;
     int bytes_to_fill = len;
-    int current_sdl_volume = volume_.load(std::memory_order_relaxed);
+
+    if (measuring_gap_)
+    {
+        gap_start_ = stream;
+    }
 
     while (bytes_to_fill > 0)
     {
         if (!current_packet_)
         {
-            if (packet_queue_.pop(current_packet_))
+            if (!pop_current_packet())
             {
-                if (current_packet_->bytes_played == 0)
+                if (next_ring_pending() && ring_->is_finished() && ring_->empty() && switch_to_next_ring(stream_ptr))
                 {
-                    emit packet_played(current_packet_);
+                    output_stage_.apply(gain_start, static_cast<size_t>(stream_ptr - gain_start));
+                    output_stage_.set_track_gain(ring_->replay_gain());
+                    gain_start = stream_ptr;
+                    continue;
                 }
-            }
-            else
-            {
                 break;
             }
         }
@@ -339,73 +641,52 @@ void audio_player::fill_audio_buffer(Uint8* stream, int len)
 
         if (bytes_to_copy > 0)
         {
-            SDL_MixAudioFormat(stream_ptr,
-                               current_packet_->data.data() + current_packet_->bytes_played,
-                               audio_spec_.format,
-                               static_cast<Uint32>(bytes_to_copy),
-                               current_sdl_volume);
+            if (measuring_gap_)
+            {
+                measuring_gap_ = false;
+                gap_bytes_ += stream_ptr - gap_start_;
+                const qint64 gap_samples = gap_bytes_ / std::max(1, bytes_per_frame());
+                post_event(player_event_type::GapMeasured, gap_samples);
+            }
+
+            if (first_sample_request_ns_ != 0 && has_audible_sample(current_packet_->data.data() + current_packet_->bytes_played, bytes_to_copy))
+            {
+                const qint64 latency_ns = steady_clock_ns() - first_sample_request_ns_;
+                first_sample_request_ns_ = 0;
+                post_event(player_event_type::FirstSample, latency_ns);
+            }
+
+            SDL_memcpy(stream_ptr, current_packet_->data.data() + current_packet_->bytes_played, bytes_to_copy);
 
             stream_ptr += bytes_to_copy;
             bytes_to_fill -= static_cast<int>(bytes_to_copy);
             current_packet_->bytes_played += bytes_to_copy;
 
-            approx_buffered_bytes_.fetch_sub(bytes_to_copy, std::memory_order_relaxed);
-            bytes_processed_by_device_.fetch_add(bytes_to_copy, std::memory_order_relaxed);
+            bytes_processed_by_device_ += static_cast<qint64>(bytes_to_copy);
         }
 
-        if (current_packet_->bytes_played >= current_packet_->data.size())
+        if (current_packet_->bytes_played >= current_packet_->data.size() && !retire_current_packet())
         {
-            current_packet_.reset();
+            break;
         }
     }
 
-    bool queue_empty = (packet_queue_.read_available() == 0) && (!current_packet_);
-
-    if (queue_empty && decoder_finished_.load(std::memory_order_acquire))
+    if (bytes_to_fill > 0)
     {
-        decoder_finished_ = false;
-        QMetaObject::invokeMethod(this, "on_playback_completed_internal", Qt::QueuedConnection);
-        return;
+        SDL_memset(stream_ptr, audio_spec_.silence, static_cast<size_t>(bytes_to_fill));
     }
 
-    if (!low_water_mark_triggered_)
-    {
-        qint64 remaining_bytes = approx_buffered_bytes_.load(std::memory_order_relaxed);
-        if (remaining_bytes < buffer_low_water_mark_)
-        {
-            LOG_TRACE("sdl 缓冲区水位低 {} 字节 请求更多数据", remaining_bytes);
-            low_water_mark_triggered_ = true;
-            high_water_mark_triggered_ = false;
-            QMetaObject::invokeMethod(this, "buffer_level_low", Qt::QueuedConnection, Q_ARG(qint64, session_id_));
-        }
-    }
-}
+    output_stage_.apply(gain_start, static_cast<size_t>((stream + len) - gain_start));
+    clock_->advance(bytes_processed_by_device_ / std::max(1, bytes_per_frame()), steady_clock_ns());
 
-void audio_player::update_progress_ui()
-{
-    if (!is_playing_ || device_id_ == 0)
+    if (measuring_gap_)
     {
-        return;
+        gap_bytes_ += (stream + len) - gap_start_;
     }
 
-    qint64 bytes_per_second = static_cast<qint64>(audio_spec_.freq) * audio_spec_.channels * static_cast<qint64>(sizeof(qint16));
-    if (bytes_per_second == 0)
+    if (!current_packet_ && !next_ring_pending() && !completion_posted_ && ring_->is_finished() && ring_->empty())
     {
-        return;
+        completion_posted_ = true;
+        post_event(player_event_type::PlaybackCompleted, 0);
     }
-
-    qint64 buffer_latency_ms = (static_cast<qint64>(audio_spec_.size) * 1000) / bytes_per_second;
-
-    qint64 processed_bytes = bytes_processed_by_device_.load();
-    qint64 processed_ms = (processed_bytes * 1000) / bytes_per_second;
-    qint64 current_playback_ms = playback_start_offset_ms_ + processed_ms - buffer_latency_ms;
-    current_playback_ms = std::max<qint64>(current_playback_ms, 0);
-
-    LOG_TRACE("播放器时钟 start_offset_ms {} processed_ms {} latency_ms {} final_ms {}",
-              playback_start_offset_ms_,
-              processed_ms,
-              buffer_latency_ms,
-              current_playback_ms);
-
-    emit progress_update(session_id_, current_playback_ms);
 }
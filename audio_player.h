@@ -9,8 +9,27 @@
 #include <SDL.h>
 #include <boost/lockfree/spsc_queue.hpp>
 
+#include "pcm_ring.h"
+#include "playback_clock.h"
+#include "audio_output_stage.h"
 #include "audio_packet.h"
 
+enum class player_event_type : uint8_t
+{
+    TrackSwitched,
+    GapMeasured,
+    FirstSample,
+    PlaybackCompleted,
+    ScrubGrain,
+};
+
+struct player_event
+{
+    player_event_type type = player_event_type::PlaybackCompleted;
+    qint64 value = 0;
+    qint64 timestamp_ns = 0;
+};
+
 class audio_player : public QObject
 {
     Q_OBJECT
@@ -19,58 +38,105 @@ class audio_player : public QObject
     explicit audio_player(QObject* parent = nullptr);
     ~audio_player() override;
 
+    [[nodiscard]] const std::shared_ptr<playback_clock>& clock() const { return clock_; }
+    [[nodiscard]] QAudioFormat preferred_format() const { return preferred_format_; }
+
+    void queue_scrub_grain(const audio_packet_ptr& grain, qint64 requested_ns);
+
+    [[nodiscard]] quint64 preload_generation() const { return preload_generation_.load(std::memory_order_acquire); }
+    void cancel_next() { preload_generation_.fetch_add(1, std::memory_order_acq_rel); }
+
    signals:
-    void progress_update(qint64 session_id, qint64 current_ms);
     void playback_finished(qint64 session_id);
     void playback_ready(qint64 session_id);
     void playback_error(const QString& error_message);
-    void packet_played(const std::shared_ptr<audio_packet>& packet);
     void seek_handled(qint64 session_id);
-    void buffer_level_low(qint64 session_id);
-    void buffer_level_high(qint64 session_id);
+    void track_switched(qint64 from_session_id, qint64 session_id);
 
    public slots:
-    void start_playback(qint64 session_id, const QAudioFormat& format, qint64 start_offset_ms = 0);
+    void start_playback(qint64 session_id,
+                        const QAudioFormat& format,
+                        const std::shared_ptr<pcm_ring>& ring,
+                        qint64 start_offset_ms = 0,
+                        qint64 request_time_ns = 0);
     void stop_playback();
-    void enqueue_packet(qint64 session_id, const std::shared_ptr<audio_packet>& packet);
+    void queue_next(qint64 session_id, const std::shared_ptr<pcm_ring>& ring, quint64 generation);
     void handle_seek(qint64 session_id, qint64 actual_seek_ms);
-    void pause_feeding(qint64 session_id) const;
-    void resume_feeding(qint64 session_id) const;
+    void pause_feeding(qint64 session_id);
+    void resume_feeding(qint64 session_id);
     void set_volume(int volume_percent);
+    void begin_scrub(qint64 session_id);
+    void end_scrub(qint64 session_id);
 
    private:
     void fill_audio_buffer(Uint8* stream, int len);
+    void fill_scrub_buffer(Uint8* stream, int len);
     static void audio_callback(void* userdata, Uint8* stream, int len);
     void clear_queue();
+    void query_preferred_format();
+    bool open_device(const QAudioFormat& format);
+    void close_device();
+    [[nodiscard]] bool next_ring_pending() const;
+    bool switch_to_next_ring(Uint8* position);
+    bool pop_current_packet();
+    bool retire_current_packet();
+    void post_event(player_event_type type, qint64 value);
+    void on_playback_completed_internal();
+    void on_track_switched_internal(qint64 session_id);
+    void on_gap_measured_internal(qint64 gap_samples);
+    void on_first_sample_internal(qint64 latency_ns);
+    void on_scrub_grain_internal(qint64 latency_ns);
+    [[nodiscard]] int bytes_per_frame() const;
 
    private slots:
-    void update_progress_ui();
-    void on_playback_completed_internal();
+    void drain_events();
 
    private:
     SDL_AudioDeviceID device_id_ = 0;
     SDL_AudioSpec audio_spec_;
 
-    boost::lockfree::spsc_queue<std::shared_ptr<audio_packet>, boost::lockfree::capacity<1024>> packet_queue_;
-    std::shared_ptr<audio_packet> current_packet_ = nullptr;
-    std::atomic<int64_t> approx_buffered_bytes_{0};
+    std::shared_ptr<pcm_ring> ring_;
+    audio_packet_ptr current_packet_;
+    bool completion_posted_ = false;
+
+    std::shared_ptr<pcm_ring> next_ring_;
+    qint64 next_session_id_ = 0;
+    quint64 next_generation_ = 0;
+    std::atomic<quint64> preload_generation_{0};
+    bool measuring_gap_ = false;
+    Uint8* gap_start_ = nullptr;
+    qint64 gap_bytes_ = 0;
+    qint64 first_sample_request_ns_ = 0;
+
+    boost::lockfree::spsc_queue<player_event, boost::lockfree::capacity<256>> event_ring_;
+    static constexpr size_t kScrubGrainCapacity = 8;
+    static constexpr size_t kRetiredPacketCapacity = 2048;
+    static_assert(kRetiredPacketCapacity > pcm_ring::kCapacity + kScrubGrainCapacity + 2);
+    boost::lockfree::spsc_queue<audio_packet_ptr, boost::lockfree::capacity<kRetiredPacketCapacity>> retired_packets_;
+    boost::lockfree::spsc_queue<std::shared_ptr<pcm_ring>, boost::lockfree::capacity<4>> retired_rings_;
+
+    struct scrub_grain
+    {
+        audio_packet_ptr packet;
+        qint64 requested_ns = 0;
+    };
+    boost::lockfree::spsc_queue<scrub_grain, boost::lockfree::capacity<kScrubGrainCapacity>> scrub_grains_;
+    audio_packet_ptr scrub_packet_;
+    std::atomic<bool> scrubbing_{false};
+    bool scrub_resume_clock_ = false;
 
     qint64 session_id_ = 0;
     std::atomic<bool> is_playing_{false};
-    std::atomic<bool> decoder_finished_{false};
-    qint64 playback_start_offset_ms_ = 0;
-    std::atomic<qint64> bytes_processed_by_device_{0};
-
-    QTimer* progress_timer_ = nullptr;
+    qint64 bytes_processed_by_device_ = 0;
+    std::shared_ptr<playback_clock> clock_ = std::make_shared<playback_clock>();
 
-    qint64 buffer_low_water_mark_ = 0;
-    qint64 buffer_high_water_mark_ = 0;
-    bool low_water_mark_triggered_ = false;
-    bool high_water_mark_triggered_ = false;
+    QTimer* event_timer_ = nullptr;
 
     QAudioFormat last_format_;
+    QAudioFormat preferred_format_;
 
-    std::atomic<int> volume_{128};
+    audio_output_stage output_stage_;
+    float volume_factor_ = 1.0F;
 };
 
 #endif
@@ -0,0 +1,30 @@
+#include "cpu_dispatch.h"
+
+static uint32_t detect_cpu_features()
+{
+    uint32_t features = cpu_feature::kNone;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+    {
+        features |= cpu_feature::kSse2;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        features |= cpu_feature::kAvx2;
+    }
+    if (__builtin_cpu_supports("fma"))
+    {
+        features |= cpu_feature::kFma;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    features |= cpu_feature::kNeon;
+#endif
+    return features;
+}
+
+uint32_t cpu_features()
+{
+    static const uint32_t features = detect_cpu_features();
+    return features;
+}
@@ -0,0 +1,81 @@
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <string_view>
+#include <initializer_list>
+
+namespace cpu_feature
+{
+constexpr uint32_t kNone = 0;
+constexpr uint32_t kSse2 = 1U << 0;
+constexpr uint32_t kAvx2 = 1U << 1;
+constexpr uint32_t kFma = 1U << 2;
+constexpr uint32_t kNeon = 1U << 3;
+}  // namespace cpu_feature
+
+[[nodiscard]] uint32_t cpu_features();
+
+// Kernel sets usable on this CPU, best first. KernelSet needs a `const char* name` member.
+template <typename KernelSet>
+class dispatch_table
+{
+   public:
+    struct candidate
+    {
+        uint32_t features;
+        KernelSet kernels;
+    };
+
+    dispatch_table(std::initializer_list<candidate> candidates)
+    {
+        const uint32_t available = cpu_features();
+        for (const candidate& c : candidates)
+        {
+            if ((c.features & available) == c.features)
+            {
+                sets_.push_back(c.kernels);
+                names_.push_back(c.kernels.name);
+            }
+        }
+    }
+
+    [[nodiscard]] const KernelSet& operator[](size_t index) const { return sets_[index]; }
+    [[nodiscard]] const std::vector<const char*>& names() const { return names_; }
+
+   private:
+    std::vector<KernelSet> sets_;
+    std::vector<const char*> names_;
+};
+
+// Per-instance choice from a dispatch_table, defaulting to the best set.
+class kernel_choice
+{
+   public:
+    explicit kernel_choice(const std::vector<const char*>& names) : names_(&names) {}
+
+    [[nodiscard]] size_t index() const { return index_; }
+    [[nodiscard]] const char* active() const { return (*names_)[index_]; }
+    [[nodiscard]] const std::vector<const char*>& names() const { return *names_; }
+
+    bool use(std::string_view name)
+    {
+        for (size_t i = 0; i < names_->size(); ++i)
+        {
+            if (name == (*names_)[i])
+            {
+                index_ = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+   private:
+    const std::vector<const char*>* names_;
+    size_t index_ = 0;
+};
+
+#endif
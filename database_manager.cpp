@@ -4,8 +4,10 @@
 #include <QSqlError>
 #include <QVariant>
 #include <QFileInfo>
+#include <QSet>
 #include <algorithm>
 #include "log.h"
+#include "media_probe.h"
 #include "database_manager.h"
 
 database_manager::database_manager(QObject* parent) : QObject(parent) {}
@@ -18,6 +20,12 @@ database_manager::~database_manager()
     }
 }
 
+QString database_manager::database_path()
+{
+    const QString app_data_path = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    return app_data_path + "/music_library.db";
+}
+
 bool database_manager::open_database()
 {
     const QString app_data_path = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
@@ -26,7 +34,7 @@ bool database_manager::open_database()
     {
         dir.mkpath(".");
     }
-    const QString db_path = app_data_path + "/music_library.db";
+    const QString db_path = database_path();
 
     db_ = QSqlDatabase::addDatabase("QSQLITE");
     db_.setDatabaseName(db_path);
@@ -41,6 +49,30 @@ bool database_manager::open_database()
     return true;
 }
 
+static bool ensure_column(const QString& table, const QString& column, const QString& type)
+{
+    QSqlQuery query;
+    if (!query.exec(QString("PRAGMA table_info(%1)").arg(table)))
+    {
+        return false;
+    }
+    while (query.next())
+    {
+        if (query.value("name").toString() == column)
+        {
+            return true;
+        }
+    }
+
+    if (!query.exec(QString("ALTER TABLE %1 ADD COLUMN %2 %3").arg(table, column, type)))
+    {
+        LOG_ERROR("为 {} 表添加列 {} 失败 {}", table.toStdString(), column.toStdString(), query.lastError().text().toStdString());
+        return false;
+    }
+    LOG_INFO("已为 {} 表添加列 {}", table.toStdString(), column.toStdString());
+    return true;
+}
+
 static bool create_tables()
 {
     QSqlQuery query;
@@ -70,6 +102,13 @@ static bool create_tables()
         LOG_ERROR("创建 Songs 表失败 {}", query.lastError().text().toStdString());
     }
 
+    success &= ensure_column("Songs", "file_size", "INTEGER");
+    success &= ensure_column("Songs", "file_mtime", "INTEGER");
+    success &= ensure_column("Songs", "seek_index", "BLOB");
+    success &= ensure_column("Songs", "stream_params", "BLOB");
+    success &= ensure_column("Songs", "loudness", "BLOB");
+    success &= ensure_column("Songs", "waveform", "BLOB");
+
     success &= query.exec(R"(
         CREATE TABLE IF NOT EXISTS Playlists (
             playlist_id INTEGER PRIMARY KEY AUTOINCREMENT,
@@ -227,7 +266,51 @@ Playlist database_manager::get_playlist_with_songs(qint64 playlist_id)
     return playlist;
 }
 
-qint64 database_manager::get_or_create_song_id(const QString& file_path)
+QStringList database_manager::unknown_song_paths(const QStringList& file_paths)
+{
+    (void)this;
+    // One IN (...) query per batch, kept under SQLite's default limit of 999 bound parameters.
+    constexpr qsizetype kPathsPerQuery = 500;
+    QSet<QString> known;
+    for (qsizetype first = 0; first < file_paths.size(); first += kPathsPerQuery)
+    {
+        const qsizetype count = std::min(kPathsPerQuery, file_paths.size() - first);
+        QStringList placeholders(count, QStringLiteral("?"));
+        QSqlQuery query;
+        query.prepare(QStringLiteral("SELECT file_path FROM Songs WHERE file_path IN (%1)").arg(placeholders.join(',')));
+        for (qsizetype i = 0; i < count; ++i)
+        {
+            query.addBindValue(file_paths[first + i]);
+        }
+        if (!query.exec())
+        {
+            LOG_WARN("查询已知歌曲失败 {}", query.lastError().text().toStdString());
+            // As before, a path whose lookup failed is not reported as unknown.
+            for (qsizetype i = 0; i < count; ++i)
+            {
+                known.insert(file_paths[first + i]);
+            }
+            continue;
+        }
+        while (query.next())
+        {
+            known.insert(query.value(0).toString());
+        }
+    }
+
+    QStringList unknown;
+    for (const QString& path : file_paths)
+    {
+        if (!known.contains(path))
+        {
+            known.insert(path);
+            unknown.append(path);
+        }
+    }
+    return unknown;
+}
+
+qint64 database_manager::get_or_create_song_id(const QString& file_path, const media_probe::result& probe)
 {
     (void)this;
     QSqlQuery query;
@@ -240,9 +323,14 @@ qint64 database_manager::get_or_create_song_id(const QString& file_path)
     }
 
     QFileInfo file_info(file_path);
-    query.prepare("INSERT INTO Songs (file_path, file_name) VALUES (:path, :name)");
+    query.prepare(
+        "INSERT INTO Songs (file_path, file_name, title, artist, album, duration_ms) VALUES (:path, :name, :title, :artist, :album, :duration)");
     query.bindValue(":path", file_path);
     query.bindValue(":name", file_info.fileName());
+    query.bindValue(":title", probe.ok ? probe.tag("title") : QString());
+    query.bindValue(":artist", probe.ok ? probe.tag("artist") : QString());
+    query.bindValue(":album", probe.ok ? probe.tag("album") : QString());
+    query.bindValue(":duration", probe.ok && probe.duration_ms >= 0 ? QVariant(probe.duration_ms) : QVariant());
 
     if (query.exec())
     {
@@ -252,7 +340,7 @@ qint64 database_manager::get_or_create_song_id(const QString& file_path)
     return -1;
 }
 
-void database_manager::add_songs_to_playlist(qint64 playlist_id, const QStringList& file_paths)
+void database_manager::add_songs_to_playlist(qint64 playlist_id, const QStringList& file_paths, const QHash<QString, media_probe::result>& probes)
 {
     if (!db_.transaction())
     {
@@ -280,7 +368,7 @@ void database_manager::add_songs_to_playlist(qint64 playlist_id, const QStringLi
 
     for (const QString& path : file_paths)
     {
-        qint64 song_id = get_or_create_song_id(path);
+        qint64 song_id = get_or_create_song_id(path, probes.value(path));
         if (song_id != -1)
         {
             current_max_pos++;
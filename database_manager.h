@@ -4,7 +4,9 @@
 #include <QObject>
 #include <QString>
 #include <QList>
+#include <QHash>
 #include <QSqlDatabase>
+#include "media_probe.h"
 #include "playlist_data.h"
 
 class database_manager : public QObject
@@ -16,6 +18,7 @@ class database_manager : public QObject
     ~database_manager() override;
 
     bool initialize();
+    static QString database_path();
 
     Playlist create_playlist(const QString& name);
     void delete_playlist(qint64 playlist_id);
@@ -23,7 +26,8 @@ class database_manager : public QObject
     QList<Playlist> get_all_playlists_with_song_counts();
     Playlist get_playlist_with_songs(qint64 playlist_id);
 
-    void add_songs_to_playlist(qint64 playlist_id, const QStringList& file_paths);
+    QStringList unknown_song_paths(const QStringList& file_paths);
+    void add_songs_to_playlist(qint64 playlist_id, const QStringList& file_paths, const QHash<QString, media_probe::result>& probes = {});
     void remove_songs_from_playlist(qint64 playlist_id, const QList<int>& song_indices);
     void update_song_order_in_playlist(qint64 playlist_id, const QList<Song>& songs);
 
@@ -31,7 +35,7 @@ class database_manager : public QObject
 
    private:
     bool open_database();
-    qint64 get_or_create_song_id(const QString& file_path);
+    qint64 get_or_create_song_id(const QString& file_path, const media_probe::result& probe = {});
 
    private:
     QSqlDatabase db_;
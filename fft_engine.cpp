@@ -0,0 +1,262 @@
+#include <cmath>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FFT_ENGINE_X86 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define FFT_ENGINE_NEON 1
+#endif
+
+#include "cpu_dispatch.h"
+#include "fft_engine.h"
+
+namespace
+{
+
+constexpr double kPi = 3.14159265358979323846;
+
+void pass_scalar(float* re, float* im, const float* wr, const float* wi, size_t n, size_t half)
+{
+    for (size_t base = 0; base < n; base += 2 * half)
+    {
+        for (size_t j = 0; j < half; ++j)
+        {
+            const size_t a = base + j;
+            const size_t b = a + half;
+            const float tr = (re[b] * wr[j]) - (im[b] * wi[j]);
+            const float ti = (re[b] * wi[j]) + (im[b] * wr[j]);
+            re[b] = re[a] - tr;
+            im[b] = im[a] - ti;
+            re[a] += tr;
+            im[a] += ti;
+        }
+    }
+}
+
+#ifdef FFT_ENGINE_X86
+
+__attribute__((target("sse2"))) void pass_sse2(float* re, float* im, const float* wr, const float* wi, size_t n, size_t half)
+{
+    if (half < 4)
+    {
+        pass_scalar(re, im, wr, wi, n, half);
+        return;
+    }
+    for (size_t base = 0; base < n; base += 2 * half)
+    {
+        float* ar = re + base;
+        float* ai = im + base;
+        float* br = ar + half;
+        float* bi = ai + half;
+        for (size_t j = 0; j < half; j += 4)
+        {
+            const __m128 xr = _mm_loadu_ps(br + j);
+            const __m128 xi = _mm_loadu_ps(bi + j);
+            const __m128 cr = _mm_loadu_ps(wr + j);
+            const __m128 ci = _mm_loadu_ps(wi + j);
+            const __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, cr), _mm_mul_ps(xi, ci));
+            const __m128 ti = _mm_add_ps(_mm_mul_ps(xr, ci), _mm_mul_ps(xi, cr));
+            const __m128 yr = _mm_loadu_ps(ar + j);
+            const __m128 yi = _mm_loadu_ps(ai + j);
+            _mm_storeu_ps(br + j, _mm_sub_ps(yr, tr));
+            _mm_storeu_ps(bi + j, _mm_sub_ps(yi, ti));
+            _mm_storeu_ps(ar + j, _mm_add_ps(yr, tr));
+            _mm_storeu_ps(ai + j, _mm_add_ps(yi, ti));
+        }
+    }
+}
+
+__attribute__((target("avx2,fma"))) void pass_avx2(float* re, float* im, const float* wr, const float* wi, size_t n, size_t half)
+{
+    if (half < 8)
+    {
+        pass_sse2(re, im, wr, wi, n, half);
+        return;
+    }
+    for (size_t base = 0; base < n; base += 2 * half)
+    {
+        float* ar = re + base;
+        float* ai = im + base;
+        float* br = ar + half;
+        float* bi = ai + half;
+        for (size_t j = 0; j < half; j += 8)
+        {
+            const __m256 xr = _mm256_loadu_ps(br + j);
+            const __m256 xi = _mm256_loadu_ps(bi + j);
+            const __m256 cr = _mm256_loadu_ps(wr + j);
+            const __m256 ci = _mm256_loadu_ps(wi + j);
+            const __m256 tr = _mm256_fmsub_ps(xr, cr, _mm256_mul_ps(xi, ci));
+            const __m256 ti = _mm256_fmadd_ps(xr, ci, _mm256_mul_ps(xi, cr));
+            const __m256 yr = _mm256_loadu_ps(ar + j);
+            const __m256 yi = _mm256_loadu_ps(ai + j);
+            _mm256_storeu_ps(br + j, _mm256_sub_ps(yr, tr));
+            _mm256_storeu_ps(bi + j, _mm256_sub_ps(yi, ti));
+            _mm256_storeu_ps(ar + j, _mm256_add_ps(yr, tr));
+            _mm256_storeu_ps(ai + j, _mm256_add_ps(yi, ti));
+        }
+    }
+}
+
+#endif
+
+#ifdef FFT_ENGINE_NEON
+
+void pass_neon(float* re, float* im, const float* wr, const float* wi, size_t n, size_t half)
+{
+    if (half < 4)
+    {
+        pass_scalar(re, im, wr, wi, n, half);
+        return;
+    }
+    for (size_t base = 0; base < n; base += 2 * half)
+    {
+        float* ar = re + base;
+        float* ai = im + base;
+        float* br = ar + half;
+        float* bi = ai + half;
+        for (size_t j = 0; j < half; j += 4)
+        {
+            const float32x4_t xr = vld1q_f32(br + j);
+            const float32x4_t xi = vld1q_f32(bi + j);
+            const float32x4_t cr = vld1q_f32(wr + j);
+            const float32x4_t ci = vld1q_f32(wi + j);
+            const float32x4_t tr = vfmsq_f32(vmulq_f32(xr, cr), xi, ci);
+            const float32x4_t ti = vfmaq_f32(vmulq_f32(xr, ci), xi, cr);
+            const float32x4_t yr = vld1q_f32(ar + j);
+            const float32x4_t yi = vld1q_f32(ai + j);
+            vst1q_f32(br + j, vsubq_f32(yr, tr));
+            vst1q_f32(bi + j, vsubq_f32(yi, ti));
+            vst1q_f32(ar + j, vaddq_f32(yr, tr));
+            vst1q_f32(ai + j, vaddq_f32(yi, ti));
+        }
+    }
+}
+
+#endif
+
+struct kernel_set
+{
+    void (*pass)(float*, float*, const float*, const float*, size_t, size_t);
+    const char* name;
+};
+
+const dispatch_table<kernel_set>& kernels()
+{
+    static const dispatch_table<kernel_set> table{
+#ifdef FFT_ENGINE_X86
+        {cpu_feature::kAvx2 | cpu_feature::kFma, {pass_avx2, "avx2"}},
+        {cpu_feature::kSse2, {pass_sse2, "sse2"}},
+#endif
+#ifdef FFT_ENGINE_NEON
+        {cpu_feature::kNeon, {pass_neon, "neon"}},
+#endif
+        {cpu_feature::kNone, {pass_scalar, "scalar"}},
+    };
+    return table;
+}
+
+}  // namespace
+
+const char* fft_engine::kernel_name() { return kernels()[0].name; }
+
+size_t fft_engine::clamp_size(size_t size)
+{
+    size_t power = kMinSize;
+    while (power < size && power < kMaxSize)
+    {
+        power <<= 1;
+    }
+    return power;
+}
+
+fft_engine::fft_engine(size_t size) : size_(clamp_size(size)), half_(size_ / 2), kernel_(kernels().names())
+{
+    window_.resize(size_);
+    for (size_t i = 0; i < size_; ++i)
+    {
+        window_[i] = static_cast<float>(0.5 * (1.0 - std::cos(2.0 * kPi * static_cast<double>(i) / static_cast<double>(size_ - 1))));
+    }
+
+    size_t bits = 0;
+    while ((size_t{1} << bits) < half_)
+    {
+        ++bits;
+    }
+    bit_reverse_.resize(half_);
+    for (size_t i = 0; i < half_; ++i)
+    {
+        uint32_t reversed = 0;
+        for (size_t b = 0; b < bits; ++b)
+        {
+            reversed |= static_cast<uint32_t>((i >> b) & 1U) << (bits - 1 - b);
+        }
+        bit_reverse_[i] = reversed;
+    }
+
+    twiddle_re_.resize(half_);
+    twiddle_im_.resize(half_);
+    for (size_t stage = 1; stage < half_; stage <<= 1)
+    {
+        for (size_t j = 0; j < stage; ++j)
+        {
+            const double angle = -kPi * static_cast<double>(j) / static_cast<double>(stage);
+            twiddle_re_[stage - 1 + j] = static_cast<float>(std::cos(angle));
+            twiddle_im_[stage - 1 + j] = static_cast<float>(std::sin(angle));
+        }
+    }
+
+    split_re_.resize(half_);
+    split_im_.resize(half_);
+    for (size_t k = 0; k < half_; ++k)
+    {
+        const double angle = -2.0 * kPi * static_cast<double>(k) / static_cast<double>(size_);
+        split_re_[k] = static_cast<float>(std::cos(angle));
+        split_im_[k] = static_cast<float>(std::sin(angle));
+    }
+
+    re_.resize(half_);
+    im_.resize(half_);
+}
+
+void fft_engine::transform()
+{
+    const auto pass = kernels()[kernel_.index()].pass;
+    for (size_t stage = 1; stage < half_; stage <<= 1)
+    {
+        pass(re_.data(), im_.data(), twiddle_re_.data() + stage - 1, twiddle_im_.data() + stage - 1, half_, stage);
+    }
+}
+
+void fft_engine::magnitudes(const float* samples, float* out)
+{
+    for (size_t k = 0; k < half_; ++k)
+    {
+        const uint32_t slot = bit_reverse_[k];
+        re_[slot] = samples[2 * k] * window_[2 * k];
+        im_[slot] = samples[(2 * k) + 1] * window_[(2 * k) + 1];
+    }
+
+    transform();
+
+    for (size_t k = 0; k < half_; ++k)
+    {
+        const size_t mirror = k == 0 ? 0 : half_ - k;
+        const float zr = re_[k];
+        const float zi = im_[k];
+        const float cr = re_[mirror];
+        const float ci = -im_[mirror];
+
+        const float even_re = 0.5F * (zr + cr);
+        const float even_im = 0.5F * (zi + ci);
+        const float odd_re = 0.5F * (zi - ci);
+        const float odd_im = -0.5F * (zr - cr);
+
+        const float wr = split_re_[k];
+        const float wi = split_im_[k];
+        const float xr = even_re + (wr * odd_re) - (wi * odd_im);
+        const float xi = even_im + (wr * odd_im) + (wi * odd_re);
+        out[k] = std::sqrt((xr * xr) + (xi * xi));
+    }
+}
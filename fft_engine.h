@@ -0,0 +1,47 @@
+#ifndef FFT_ENGINE_H
+#define FFT_ENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "cpu_dispatch.h"
+
+class fft_engine
+{
+   public:
+    static constexpr size_t kMinSize = 512;
+    static constexpr size_t kMaxSize = 8192;
+
+    explicit fft_engine(size_t size);
+
+    fft_engine(const fft_engine&) = delete;
+    fft_engine& operator=(const fft_engine&) = delete;
+
+    [[nodiscard]] size_t size() const { return size_; }
+    [[nodiscard]] size_t bin_count() const { return size_ / 2; }
+    [[nodiscard]] const std::vector<float>& window() const { return window_; }
+
+    void magnitudes(const float* samples, float* out);
+    kernel_choice& kernel() { return kernel_; }
+
+    [[nodiscard]] static size_t clamp_size(size_t size);
+    [[nodiscard]] static const char* kernel_name();
+
+   private:
+    void transform();
+
+   private:
+    size_t size_ = 0;
+    size_t half_ = 0;
+    kernel_choice kernel_;
+    std::vector<float> window_;
+    std::vector<uint32_t> bit_reverse_;
+    std::vector<float> twiddle_re_;
+    std::vector<float> twiddle_im_;
+    std::vector<float> split_re_;
+    std::vector<float> split_im_;
+    std::vector<float> re_;
+    std::vector<float> im_;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <QThread>
+#include <QSettings>
+#include <QMetaObject>
+#include "log.h"
+#include "pcm_reader.h"
+#include "media_cache.h"
+#include "loudness_meter.h"
+#include "loudness_analyzer.h"
+
+constexpr int kAnalysisBatchSize = 64;
+constexpr int kThroughputLogInterval = 10;
+
+loudness_analyzer::loudness_analyzer(QObject* parent) : QObject(parent)
+{
+    QSettings settings("MusicPlayer", "MusicPlayer");
+    const int default_threads = std::max(1, QThread::idealThreadCount() / 2);
+    pool_.setMaxThreadCount(std::max(1, settings.value("analysis/threads", default_threads).toInt()));
+}
+
+loudness_analyzer::~loudness_analyzer()
+{
+    cancel_ = true;
+    pool_.waitForDone();
+}
+
+void loudness_analyzer::start()
+{
+    if (in_flight_ > 0 || !queue_.isEmpty())
+    {
+        return;
+    }
+    last_song_id_ = 0;
+    completed_ = 0;
+    failed_ = 0;
+    elapsed_.start();
+    schedule_more();
+}
+
+void loudness_analyzer::schedule_more()
+{
+    if (queue_.isEmpty() && in_flight_ == 0)
+    {
+        queue_ = media_cache::pending_loudness_paths(last_song_id_, kAnalysisBatchSize);
+        if (queue_.isEmpty())
+        {
+            if (completed_ + failed_ > 0)
+            {
+                LOG_INFO("响度分析 完成 成功 {} 失败 {} 耗时 {}s", completed_, failed_, elapsed_.elapsed() / 1000);
+            }
+            return;
+        }
+    }
+
+    const int max_in_flight = pool_.maxThreadCount() * 2;
+    while (!queue_.isEmpty() && in_flight_ < max_in_flight)
+    {
+        const QString path = queue_.takeFirst();
+        in_flight_++;
+        pool_.start(
+            [this, path]()
+            {
+                QThread::currentThread()->setPriority(QThread::IdlePriority);
+                const bool ok = analyze(path, cancel_);
+                QMetaObject::invokeMethod(this, [this, ok]() { on_task_finished(ok); }, Qt::QueuedConnection);
+            });
+    }
+}
+
+void loudness_analyzer::on_task_finished(bool ok)
+{
+    in_flight_--;
+    ok ? completed_++ : failed_++;
+
+    const int done = completed_ + failed_;
+    if (done % kThroughputLogInterval == 0 && elapsed_.elapsed() > 0)
+    {
+        LOG_INFO("响度分析 已处理 {} 首 吞吐 {:.1f} 首每分钟", done, done * 60000.0 / static_cast<double>(elapsed_.elapsed()));
+    }
+    if (!cancel_)
+    {
+        schedule_more();
+    }
+}
+
+bool loudness_analyzer::analyze(const QString& file_path, const std::atomic<bool>& cancel)
+{
+    const media_cache::file_stamp stamp = media_cache::stamp_of(file_path);
+    pcm_reader reader;
+    loudness_meter::summary summary;
+    bool ok = reader.open(file_path);
+    if (ok)
+    {
+        loudness_meter meter(reader.sample_rate(), reader.channels());
+        ok = reader.read_all([&](const float* samples, int frames) { meter.process(samples, frames); }, cancel);
+        if (ok)
+        {
+            summary = meter.finish();
+        }
+    }
+    if (cancel.load())
+    {
+        return false;
+    }
+
+    media_cache::store_loudness(file_path, stamp, summary.serialize());
+    if (ok)
+    {
+        LOG_DEBUG("响度分析 {:.2f} LUFS 真峰值 {:.4f} {}", summary.integrated_lufs, summary.true_peak, file_path.toStdString());
+    }
+    else
+    {
+        LOG_DEBUG("响度分析 文件缺失或无法解码 记录为空结果 {}", file_path.toStdString());
+    }
+    return ok;
+}
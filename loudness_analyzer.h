@@ -0,0 +1,36 @@
+#ifndef LOUDNESS_ANALYZER_H
+#define LOUDNESS_ANALYZER_H
+
+#include <atomic>
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QElapsedTimer>
+
+class loudness_analyzer : public QObject
+{
+    Q_OBJECT
+
+   public:
+    explicit loudness_analyzer(QObject* parent = nullptr);
+    ~loudness_analyzer() override;
+
+    void start();
+
+   private:
+    void schedule_more();
+    void on_task_finished(bool ok);
+    static bool analyze(const QString& file_path, const std::atomic<bool>& cancel);
+
+   private:
+    QThreadPool pool_;
+    std::atomic<bool> cancel_{false};
+    QStringList queue_;
+    qint64 last_song_id_ = 0;
+    int in_flight_ = 0;
+    int completed_ = 0;
+    int failed_ = 0;
+    QElapsedTimer elapsed_;
+};
+
+#endif
@@ -0,0 +1,534 @@
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LOUDNESS_METER_X86 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define LOUDNESS_METER_NEON 1
+#endif
+
+#include <QDataStream>
+#include <QIODevice>
+#include "loudness_meter.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+constexpr quint8 kLoudnessBlobVersion = 1;
+
+static double energy_to_lufs(double energy) { return -0.691 + (10.0 * std::log10(energy)); }
+
+static double lufs_to_energy(double lufs) { return std::pow(10.0, (lufs + 0.691) / 10.0); }
+
+static double bin_lufs(int bin) { return loudness_meter::kAbsoluteGateLufs + ((bin + 0.5) * loudness_meter::kHistogramStepLu); }
+
+namespace
+{
+
+using biquad = loudness_meter::biquad;
+constexpr int kStages = loudness_meter::kStages;
+constexpr int kOversample = loudness_meter::kOversample;
+constexpr int kTaps = loudness_meter::kTapsPerPhase;
+
+// Filter state index of stage s, delay k (0 for z1, 1 for z2), channel c.
+inline size_t state_slot(int s, int k, int c, int channels) { return static_cast<size_t>((((s * 2) + k) * channels) + c); }
+
+// Runs both K-weighting stages over one channel and adds its squared output to sums[c].
+void k_weight_channel(const biquad* stages, double* state, double* sums, const float* in, int channels, int frames, int c)
+{
+    double z1[kStages];
+    double z2[kStages];
+    for (int s = 0; s < kStages; ++s)
+    {
+        z1[s] = state[state_slot(s, 0, c, channels)];
+        z2[s] = state[state_slot(s, 1, c, channels)];
+    }
+    double sum = 0.0;
+    for (int i = 0; i < frames; ++i)
+    {
+        double x = in[(static_cast<ptrdiff_t>(i) * channels) + c];
+        for (int s = 0; s < kStages; ++s)
+        {
+            const biquad& f = stages[s];
+            const double y = (f.b0 * x) + z1[s];
+            z1[s] = (f.b1 * x) - (f.a1 * y) + z2[s];
+            z2[s] = (f.b2 * x) - (f.a2 * y);
+            x = y;
+        }
+        sum += x * x;
+    }
+    for (int s = 0; s < kStages; ++s)
+    {
+        state[state_slot(s, 0, c, channels)] = z1[s];
+        state[state_slot(s, 1, c, channels)] = z2[s];
+    }
+    sums[c] += sum;
+}
+
+void k_weight_scalar(const biquad* stages, double* state, double* sums, const float* in, int channels, int frames)
+{
+    for (int c = 0; c < channels; ++c)
+    {
+        k_weight_channel(stages, state, sums, in, channels, frames, c);
+    }
+}
+
+// Pushes frames samples, stride apart, through the doubled ring and the polyphase FIR and returns the largest |output|.
+float true_peak_scalar(const float* taps, float* history, int& pos, const float* in, ptrdiff_t stride, int frames, float peak)
+{
+    for (int i = 0; i < frames; ++i)
+    {
+        const float x = in[i * stride];
+        history[pos] = x;
+        history[pos + kTaps] = x;
+        pos = pos + 1 == kTaps ? 0 : pos + 1;
+        const float* window = history + pos;
+
+        float acc[kOversample] = {};
+        for (int j = 0; j < kTaps; ++j)
+        {
+            for (int p = 0; p < kOversample; ++p)
+            {
+                acc[p] += taps[(j * kOversample) + p] * window[j];
+            }
+        }
+        for (float a : acc)
+        {
+            peak = std::max(peak, std::abs(a));
+        }
+    }
+    return peak;
+}
+
+#ifdef LOUDNESS_METER_X86
+
+// Filters channels from first onwards, two per register, and the odd one out in scalar.
+__attribute__((target("sse2"))) void k_weight_pairs_sse2(
+    const biquad* stages, double* state, double* sums, const float* in, int channels, int frames, int first)
+{
+    int c = first;
+    for (; c + 2 <= channels; c += 2)
+    {
+        __m128d b0[kStages], b1[kStages], b2[kStages], a1[kStages], a2[kStages], z1[kStages], z2[kStages];
+        for (int s = 0; s < kStages; ++s)
+        {
+            b0[s] = _mm_set1_pd(stages[s].b0);
+            b1[s] = _mm_set1_pd(stages[s].b1);
+            b2[s] = _mm_set1_pd(stages[s].b2);
+            a1[s] = _mm_set1_pd(stages[s].a1);
+            a2[s] = _mm_set1_pd(stages[s].a2);
+            z1[s] = _mm_loadu_pd(state + state_slot(s, 0, c, channels));
+            z2[s] = _mm_loadu_pd(state + state_slot(s, 1, c, channels));
+        }
+        __m128d sum = _mm_setzero_pd();
+        for (int i = 0; i < frames; ++i)
+        {
+            const float* frame = in + (static_cast<ptrdiff_t>(i) * channels) + c;
+            __m128d x = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(frame))));
+            for (int s = 0; s < kStages; ++s)
+            {
+                const __m128d y = _mm_add_pd(_mm_mul_pd(b0[s], x), z1[s]);
+                z1[s] = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(b1[s], x), _mm_mul_pd(a1[s], y)), z2[s]);
+                z2[s] = _mm_sub_pd(_mm_mul_pd(b2[s], x), _mm_mul_pd(a2[s], y));
+                x = y;
+            }
+            sum = _mm_add_pd(sum, _mm_mul_pd(x, x));
+        }
+        for (int s = 0; s < kStages; ++s)
+        {
+            _mm_storeu_pd(state + state_slot(s, 0, c, channels), z1[s]);
+            _mm_storeu_pd(state + state_slot(s, 1, c, channels), z2[s]);
+        }
+        _mm_storeu_pd(sums + c, _mm_add_pd(_mm_loadu_pd(sums + c), sum));
+    }
+    for (; c < channels; ++c)
+    {
+        k_weight_channel(stages, state, sums, in, channels, frames, c);
+    }
+}
+
+__attribute__((target("sse2"))) void k_weight_sse2(const biquad* stages, double* state, double* sums, const float* in, int channels, int frames)
+{
+    k_weight_pairs_sse2(stages, state, sums, in, channels, frames, 0);
+}
+
+__attribute__((target("avx2"))) void k_weight_avx2(const biquad* stages, double* state, double* sums, const float* in, int channels, int frames)
+{
+    int c = 0;
+    for (; c + 4 <= channels; c += 4)
+    {
+        __m256d b0[kStages], b1[kStages], b2[kStages], a1[kStages], a2[kStages], z1[kStages], z2[kStages];
+        for (int s = 0; s < kStages; ++s)
+        {
+            b0[s] = _mm256_set1_pd(stages[s].b0);
+            b1[s] = _mm256_set1_pd(stages[s].b1);
+            b2[s] = _mm256_set1_pd(stages[s].b2);
+            a1[s] = _mm256_set1_pd(stages[s].a1);
+            a2[s] = _mm256_set1_pd(stages[s].a2);
+            z1[s] = _mm256_loadu_pd(state + state_slot(s, 0, c, channels));
+            z2[s] = _mm256_loadu_pd(state + state_slot(s, 1, c, channels));
+        }
+        __m256d sum = _mm256_setzero_pd();
+        for (int i = 0; i < frames; ++i)
+        {
+            __m256d x = _mm256_cvtps_pd(_mm_loadu_ps(in + (static_cast<ptrdiff_t>(i) * channels) + c));
+            for (int s = 0; s < kStages; ++s)
+            {
+                const __m256d y = _mm256_add_pd(_mm256_mul_pd(b0[s], x), z1[s]);
+                z1[s] = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(b1[s], x), _mm256_mul_pd(a1[s], y)), z2[s]);
+                z2[s] = _mm256_sub_pd(_mm256_mul_pd(b2[s], x), _mm256_mul_pd(a2[s], y));
+                x = y;
+            }
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(x, x));
+        }
+        for (int s = 0; s < kStages; ++s)
+        {
+            _mm256_storeu_pd(state + state_slot(s, 0, c, channels), z1[s]);
+            _mm256_storeu_pd(state + state_slot(s, 1, c, channels), z2[s]);
+        }
+        _mm256_storeu_pd(sums + c, _mm256_add_pd(_mm256_loadu_pd(sums + c), sum));
+    }
+    k_weight_pairs_sse2(stages, state, sums, in, channels, frames, c);
+}
+
+__attribute__((target("sse2"))) float true_peak_sse2(
+    const float* taps, float* history, int& pos, const float* in, ptrdiff_t stride, int frames, float peak)
+{
+    __m128 coef[kTaps];
+    for (int j = 0; j < kTaps; ++j)
+    {
+        coef[j] = _mm_loadu_ps(taps + (j * kOversample));
+    }
+    const __m128 sign = _mm_set1_ps(-0.0F);
+    __m128 peaks = _mm_set1_ps(peak);
+    for (int i = 0; i < frames; ++i)
+    {
+        const float x = in[i * stride];
+        history[pos] = x;
+        history[pos + kTaps] = x;
+        pos = pos + 1 == kTaps ? 0 : pos + 1;
+        const float* window = history + pos;
+
+        // Three partial sums keep the add chain short; the taps split evenly across them.
+        __m128 acc0 = _mm_mul_ps(coef[0], _mm_set1_ps(window[0]));
+        __m128 acc1 = _mm_mul_ps(coef[1], _mm_set1_ps(window[1]));
+        __m128 acc2 = _mm_mul_ps(coef[2], _mm_set1_ps(window[2]));
+        for (int j = 3; j < kTaps; j += 3)
+        {
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(coef[j], _mm_set1_ps(window[j])));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(coef[j + 1], _mm_set1_ps(window[j + 1])));
+            acc2 = _mm_add_ps(acc2, _mm_mul_ps(coef[j + 2], _mm_set1_ps(window[j + 2])));
+        }
+        const __m128 acc = _mm_add_ps(_mm_add_ps(acc0, acc1), acc2);
+        peaks = _mm_max_ps(peaks, _mm_andnot_ps(sign, acc));
+    }
+    alignas(16) float lanes[kOversample];
+    _mm_store_ps(lanes, peaks);
+    return std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+}
+
+#endif
+
+#ifdef LOUDNESS_METER_NEON
+
+void k_weight_neon(const biquad* stages, double* state, double* sums, const float* in, int channels, int frames)
+{
+    int c = 0;
+    for (; c + 2 <= channels; c += 2)
+    {
+        float64x2_t b0[kStages], b1[kStages], b2[kStages], a1[kStages], a2[kStages], z1[kStages], z2[kStages];
+        for (int s = 0; s < kStages; ++s)
+        {
+            b0[s] = vdupq_n_f64(stages[s].b0);
+            b1[s] = vdupq_n_f64(stages[s].b1);
+            b2[s] = vdupq_n_f64(stages[s].b2);
+            a1[s] = vdupq_n_f64(stages[s].a1);
+            a2[s] = vdupq_n_f64(stages[s].a2);
+            z1[s] = vld1q_f64(state + state_slot(s, 0, c, channels));
+            z2[s] = vld1q_f64(state + state_slot(s, 1, c, channels));
+        }
+        float64x2_t sum = vdupq_n_f64(0.0);
+        for (int i = 0; i < frames; ++i)
+        {
+            float64x2_t x = vcvt_f64_f32(vld1_f32(in + (static_cast<ptrdiff_t>(i) * channels) + c));
+            for (int s = 0; s < kStages; ++s)
+            {
+                const float64x2_t y = vaddq_f64(vmulq_f64(b0[s], x), z1[s]);
+                z1[s] = vaddq_f64(vsubq_f64(vmulq_f64(b1[s], x), vmulq_f64(a1[s], y)), z2[s]);
+                z2[s] = vsubq_f64(vmulq_f64(b2[s], x), vmulq_f64(a2[s], y));
+                x = y;
+            }
+            sum = vaddq_f64(sum, vmulq_f64(x, x));
+        }
+        for (int s = 0; s < kStages; ++s)
+        {
+            vst1q_f64(state + state_slot(s, 0, c, channels), z1[s]);
+            vst1q_f64(state + state_slot(s, 1, c, channels), z2[s]);
+        }
+        vst1q_f64(sums + c, vaddq_f64(vld1q_f64(sums + c), sum));
+    }
+    for (; c < channels; ++c)
+    {
+        k_weight_channel(stages, state, sums, in, channels, frames, c);
+    }
+}
+
+float true_peak_neon(const float* taps, float* history, int& pos, const float* in, ptrdiff_t stride, int frames, float peak)
+{
+    float32x4_t coef[kTaps];
+    for (int j = 0; j < kTaps; ++j)
+    {
+        coef[j] = vld1q_f32(taps + (j * kOversample));
+    }
+    float32x4_t peaks = vdupq_n_f32(peak);
+    for (int i = 0; i < frames; ++i)
+    {
+        const float x = in[i * stride];
+        history[pos] = x;
+        history[pos + kTaps] = x;
+        pos = pos + 1 == kTaps ? 0 : pos + 1;
+        const float* window = history + pos;
+
+        float32x4_t acc = vdupq_n_f32(0.0F);
+        for (int j = 0; j < kTaps; ++j)
+        {
+            acc = vaddq_f32(acc, vmulq_n_f32(coef[j], window[j]));
+        }
+        peaks = vmaxq_f32(peaks, vabsq_f32(acc));
+    }
+    return vmaxvq_f32(peaks);
+}
+
+#endif
+
+struct kernel_set
+{
+    void (*k_weight)(const biquad*, double*, double*, const float*, int, int);
+    float (*true_peak)(const float*, float*, int&, const float*, ptrdiff_t, int, float);
+    const char* name;
+};
+
+const dispatch_table<kernel_set>& kernels()
+{
+    static const dispatch_table<kernel_set> table{
+#ifdef LOUDNESS_METER_X86
+        {cpu_feature::kAvx2, {k_weight_avx2, true_peak_sse2, "avx2"}},
+        {cpu_feature::kSse2, {k_weight_sse2, true_peak_sse2, "sse2"}},
+#endif
+#ifdef LOUDNESS_METER_NEON
+        {cpu_feature::kNeon, {k_weight_neon, true_peak_neon, "neon"}},
+#endif
+        {cpu_feature::kNone, {k_weight_scalar, true_peak_scalar, "scalar"}},
+    };
+    return table;
+}
+
+}  // namespace
+
+loudness_meter::loudness_meter(int sample_rate, int channels)
+    : sample_rate_(sample_rate), histogram_(kHistogramBins, 0), kernel_(kernels().names())
+{
+    const double rate = static_cast<double>(sample_rate);
+
+    {
+        const double f0 = 1681.974450955533;
+        const double gain_db = 3.999843853973347;
+        const double q = 0.7071752369554196;
+        const double k = std::tan(M_PI * f0 / rate);
+        const double vh = std::pow(10.0, gain_db / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + (k / q) + (k * k);
+        stages_[0].b0 = (vh + (vb * k / q) + (k * k)) / a0;
+        stages_[0].b1 = 2.0 * ((k * k) - vh) / a0;
+        stages_[0].b2 = (vh - (vb * k / q) + (k * k)) / a0;
+        stages_[0].a1 = 2.0 * ((k * k) - 1.0) / a0;
+        stages_[0].a2 = (1.0 - (k / q) + (k * k)) / a0;
+    }
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+        const double k = std::tan(M_PI * f0 / rate);
+        const double a0 = 1.0 + (k / q) + (k * k);
+        stages_[1].b0 = 1.0;
+        stages_[1].b1 = -2.0;
+        stages_[1].b2 = 1.0;
+        stages_[1].a1 = 2.0 * ((k * k) - 1.0) / a0;
+        stages_[1].a2 = (1.0 - (k / q) + (k * k)) / a0;
+    }
+
+    constexpr int kFilterTaps = kOversample * kTapsPerPhase;
+    for (int n = 0; n < kFilterTaps; ++n)
+    {
+        const double m = n - ((kFilterTaps - 1) / 2.0);
+        const double x = m / kOversample;
+        const double sinc = std::abs(x) < 1e-12 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+        const double window = 0.5 * (1.0 - std::cos(2.0 * M_PI * (n + 0.5) / kFilterTaps));
+        // Tap t of a phase multiplies the sample t steps back, which is the (kTapsPerPhase - 1 - t)-th oldest.
+        taps_[kTapsPerPhase - 1 - (n / kOversample)][n % kOversample] = static_cast<float>(sinc * window);
+    }
+
+    channels_.resize(static_cast<size_t>(channels));
+    filter_state_.assign(static_cast<size_t>(kStages * 2 * channels), 0.0);
+    sub_block_sums_.assign(static_cast<size_t>(channels), 0.0);
+    for (int c = 0; c < channels; ++c)
+    {
+        channel_state& state = channels_[static_cast<size_t>(c)];
+        state.history.assign(2 * kTapsPerPhase, 0.0F);
+        if (channels >= 6 && c == 3)
+        {
+            state.weight = 0.0;
+        }
+        else if (c >= 3)
+        {
+            state.weight = 1.41;
+        }
+    }
+    sub_block_frames_ = std::max(1, sample_rate / 10);
+}
+
+void loudness_meter::process(const float* interleaved, int frames)
+{
+    const auto channel_count = static_cast<int>(channels_.size());
+    const kernel_set& set = kernels()[kernel_.index()];
+    int done = 0;
+    while (done < frames)
+    {
+        const int count = std::min(frames - done, sub_block_frames_ - sub_block_fill_);
+        const float* in = interleaved + (static_cast<ptrdiff_t>(done) * channel_count);
+
+        set.k_weight(stages_.data(), filter_state_.data(), sub_block_sums_.data(), in, channel_count, count);
+        for (int c = 0; c < channel_count; ++c)
+        {
+            channel_state& state = channels_[static_cast<size_t>(c)];
+            state.peak = set.true_peak(taps_[0].data(), state.history.data(), state.history_pos, in + c, channel_count, count, state.peak);
+        }
+
+        done += count;
+        sub_block_fill_ += count;
+        if (sub_block_fill_ == sub_block_frames_)
+        {
+            close_sub_block();
+        }
+    }
+}
+
+void loudness_meter::close_sub_block()
+{
+    double energy = 0.0;
+    for (size_t c = 0; c < channels_.size(); ++c)
+    {
+        energy += channels_[c].weight * sub_block_sums_[c] / sub_block_frames_;
+        sub_block_sums_[c] = 0.0;
+    }
+    sub_block_fill_ = 0;
+
+    recent_energy_[static_cast<size_t>(recent_count_ % 4)] = energy;
+    recent_count_++;
+    if (recent_count_ < 4)
+    {
+        return;
+    }
+
+    const double block_energy = (recent_energy_[0] + recent_energy_[1] + recent_energy_[2] + recent_energy_[3]) / 4.0;
+    if (block_energy <= 0.0)
+    {
+        return;
+    }
+    const double lufs = energy_to_lufs(block_energy);
+    if (lufs < kAbsoluteGateLufs)
+    {
+        return;
+    }
+    const int bin = std::min(kHistogramBins - 1, static_cast<int>((lufs - kAbsoluteGateLufs) / kHistogramStepLu));
+    histogram_[static_cast<size_t>(bin)]++;
+}
+
+loudness_meter::summary loudness_meter::finish() const
+{
+    summary s;
+    s.histogram = histogram_;
+    s.integrated_lufs = gated_loudness(histogram_);
+    for (const channel_state& state : channels_)
+    {
+        s.true_peak = std::max(s.true_peak, static_cast<double>(state.peak));
+    }
+    return s;
+}
+
+double loudness_meter::gated_loudness(const std::vector<uint32_t>& histogram)
+{
+    double energy_sum = 0.0;
+    uint64_t blocks = 0;
+    for (size_t i = 0; i < histogram.size(); ++i)
+    {
+        energy_sum += histogram[i] * lufs_to_energy(bin_lufs(static_cast<int>(i)));
+        blocks += histogram[i];
+    }
+    if (blocks == 0)
+    {
+        return kAbsoluteGateLufs;
+    }
+
+    const double relative_gate = energy_to_lufs(energy_sum / static_cast<double>(blocks)) - 10.0;
+    energy_sum = 0.0;
+    blocks = 0;
+    for (size_t i = 0; i < histogram.size(); ++i)
+    {
+        if (bin_lufs(static_cast<int>(i)) < relative_gate)
+        {
+            continue;
+        }
+        energy_sum += histogram[i] * lufs_to_energy(bin_lufs(static_cast<int>(i)));
+        blocks += histogram[i];
+    }
+    return blocks == 0 ? kAbsoluteGateLufs : energy_to_lufs(energy_sum / static_cast<double>(blocks));
+}
+
+QByteArray loudness_meter::summary::serialize() const
+{
+    QByteArray blob;
+    QDataStream out(&blob, QIODevice::WriteOnly);
+    quint32 used = 0;
+    for (uint32_t count : histogram)
+    {
+        used += count != 0 ? 1 : 0;
+    }
+    out << kLoudnessBlobVersion << integrated_lufs << true_peak << used;
+    for (size_t i = 0; i < histogram.size(); ++i)
+    {
+        if (histogram[i] != 0)
+        {
+            out << static_cast<quint16>(i) << static_cast<quint32>(histogram[i]);
+        }
+    }
+    return blob;
+}
+
+bool loudness_meter::summary::deserialize(const QByteArray& blob, summary& out)
+{
+    QDataStream in(blob);
+    quint8 version = 0;
+    quint32 used = 0;
+    in >> version;
+    if (version != kLoudnessBlobVersion)
+    {
+        return false;
+    }
+    in >> out.integrated_lufs >> out.true_peak >> used;
+    out.histogram.assign(kHistogramBins, 0);
+    for (quint32 i = 0; i < used && in.status() == QDataStream::Ok; ++i)
+    {
+        quint16 bin = 0;
+        quint32 count = 0;
+        in >> bin >> count;
+        if (bin < kHistogramBins)
+        {
+            out.histogram[bin] = count;
+        }
+    }
+    return in.status() == QDataStream::Ok;
+}
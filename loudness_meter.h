@@ -0,0 +1,73 @@
+#ifndef LOUDNESS_METER_H
+#define LOUDNESS_METER_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <QByteArray>
+#include "cpu_dispatch.h"
+
+class loudness_meter
+{
+   public:
+    static constexpr double kAbsoluteGateLufs = -70.0;
+    static constexpr double kHistogramTopLufs = 5.0;
+    static constexpr double kHistogramStepLu = 0.05;
+    static constexpr int kHistogramBins = static_cast<int>((kHistogramTopLufs - kAbsoluteGateLufs) / kHistogramStepLu);
+    static constexpr int kOversample = 4;
+    static constexpr int kTapsPerPhase = 12;
+    static constexpr int kStages = 2;
+
+    struct biquad
+    {
+        double b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+    };
+
+    struct summary
+    {
+        double integrated_lufs = kAbsoluteGateLufs;
+        double true_peak = 0.0;
+        std::vector<uint32_t> histogram;
+
+        [[nodiscard]] QByteArray serialize() const;
+        static bool deserialize(const QByteArray& blob, summary& out);
+    };
+
+    loudness_meter(int sample_rate, int channels);
+
+    void process(const float* interleaved, int frames);
+    [[nodiscard]] summary finish() const;
+    kernel_choice& kernel() { return kernel_; }
+
+    static double gated_loudness(const std::vector<uint32_t>& histogram);
+
+   private:
+    struct channel_state
+    {
+        double weight = 1.0;
+        // Doubled ring: each sample is written at pos and pos + kTapsPerPhase, so the last taps are always contiguous.
+        std::vector<float> history;
+        int history_pos = 0;
+        float peak = 0.0F;
+    };
+
+    void close_sub_block();
+
+   private:
+    int sample_rate_ = 0;
+    int sub_block_frames_ = 0;
+    int sub_block_fill_ = 0;
+    std::array<biquad, kStages> stages_;
+    std::vector<channel_state> channels_;
+    // Filter memory laid out [stage][z1, z2][channel] so neighbouring channels share SIMD lanes.
+    std::vector<double> filter_state_;
+    std::vector<double> sub_block_sums_;
+    // taps_[j][phase] weights the j-th oldest of the last kTapsPerPhase input samples.
+    std::array<std::array<float, kOversample>, kTapsPerPhase> taps_{};
+    std::array<double, 4> recent_energy_{};
+    int recent_count_ = 0;
+    std::vector<uint32_t> histogram_;
+    kernel_choice kernel_;
+};
+
+#endif
@@ -0,0 +1,240 @@
+#include <atomic>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QStringList>
+#include "log.h"
+#include "media_cache.h"
+#include "database_manager.h"
+
+constexpr int kBusyTimeoutMs = 250;
+
+static std::atomic<quint64> connection_counter{0};
+static const char* const kCacheColumns[] = {"seek_index", "stream_params", "loudness", "waveform"};
+
+class cache_connection
+{
+   public:
+    cache_connection() : name_(QString("media_cache_%1").arg(connection_counter.fetch_add(1))) {}
+
+    cache_connection(const cache_connection&) = delete;
+    cache_connection& operator=(const cache_connection&) = delete;
+
+    ~cache_connection()
+    {
+        if (!QSqlDatabase::contains(name_))
+        {
+            return;
+        }
+        {
+            QSqlDatabase db = QSqlDatabase::database(name_, false);
+            db.close();
+        }
+        QSqlDatabase::removeDatabase(name_);
+    }
+
+    QSqlDatabase database()
+    {
+        if (!QSqlDatabase::contains(name_))
+        {
+            QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name_);
+            db.setDatabaseName(database_manager::database_path());
+            db.setConnectOptions(QString("QSQLITE_BUSY_TIMEOUT=%1").arg(kBusyTimeoutMs));
+        }
+        QSqlDatabase db = QSqlDatabase::database(name_, false);
+        if (!db.isOpen() && !db.open())
+        {
+            LOG_WARN("媒体缓存 无法打开数据库 {}", db.lastError().text().toStdString());
+        }
+        return db;
+    }
+
+   private:
+    QString name_;
+};
+
+template <typename Callback>
+static void with_connection(Callback&& callback)
+{
+    thread_local cache_connection connection;
+    QSqlDatabase db = connection.database();
+    if (db.isOpen())
+    {
+        callback(db);
+    }
+}
+
+media_cache::file_stamp media_cache::stamp_of(const QString& file_path)
+{
+    const QFileInfo info(file_path);
+    file_stamp stamp;
+    if (info.exists())
+    {
+        stamp.size = info.size();
+        stamp.mtime_ms = info.lastModified().toMSecsSinceEpoch();
+    }
+    return stamp;
+}
+
+static QList<QByteArray> load_blobs(const QString& file_path, const media_cache::file_stamp& stamp, const QStringList& columns)
+{
+    QList<QByteArray> blobs(columns.size());
+    if (!stamp.valid())
+    {
+        return blobs;
+    }
+
+    with_connection(
+        [&](QSqlDatabase& db)
+        {
+            QSqlQuery query(db);
+            query.prepare(QString("SELECT file_size, file_mtime, %1 FROM Songs WHERE file_path = :path").arg(columns.join(", ")));
+            query.bindValue(":path", file_path);
+            if (!query.exec() || !query.next())
+            {
+                return;
+            }
+            if (query.value(0).toLongLong() != stamp.size || query.value(1).toLongLong() != stamp.mtime_ms)
+            {
+                return;
+            }
+            for (qsizetype i = 0; i < columns.size(); ++i)
+            {
+                blobs[i] = query.value(static_cast<int>(i + 2)).toByteArray();
+            }
+        });
+    return blobs;
+}
+
+static QByteArray load_blob(const QString& file_path, const media_cache::file_stamp& stamp, const QString& column)
+{
+    return load_blobs(file_path, stamp, {column}).front();
+}
+
+static bool store_blob(const QString& file_path, const media_cache::file_stamp& stamp, const QString& column, const QByteArray& blob)
+{
+    QStringList assignments = {QString("%1 = :blob").arg(column)};
+    for (const char* other : kCacheColumns)
+    {
+        if (column != QLatin1String(other))
+        {
+            assignments << QString("%1 = CASE WHEN file_size IS :old_size AND file_mtime IS :old_mtime THEN %1 ELSE NULL END").arg(other);
+        }
+    }
+
+    bool stored = false;
+    with_connection(
+        [&](QSqlDatabase& db)
+        {
+            QSqlQuery query(db);
+            query.prepare(QString("UPDATE Songs SET %1, file_size = :size, file_mtime = :mtime WHERE file_path = :path").arg(assignments.join(", ")));
+            query.bindValue(":blob", blob);
+            query.bindValue(":old_size", stamp.size);
+            query.bindValue(":old_mtime", stamp.mtime_ms);
+            query.bindValue(":size", stamp.size);
+            query.bindValue(":mtime", stamp.mtime_ms);
+            query.bindValue(":path", file_path);
+            if (!query.exec())
+            {
+                LOG_WARN("媒体缓存 写入 {} 失败 {}", column.toStdString(), query.lastError().text().toStdString());
+                return;
+            }
+            stored = query.numRowsAffected() > 0;
+        });
+    return stored;
+}
+
+bool media_cache::store_seek_index(const QString& file_path, const file_stamp& stamp, const QByteArray& blob)
+{
+    return store_blob(file_path, stamp, "seek_index", blob);
+}
+
+QByteArray media_cache::load_stream_params(const QString& file_path, const file_stamp& stamp)
+{
+    return load_blob(file_path, stamp, "stream_params");
+}
+
+media_cache::open_blobs media_cache::load_open_blobs(const QString& file_path, const file_stamp& stamp)
+{
+    const QList<QByteArray> blobs = load_blobs(file_path, stamp, {"stream_params", "seek_index"});
+    return {blobs[0], blobs[1]};
+}
+
+bool media_cache::store_stream_params(const QString& file_path, const file_stamp& stamp, const QByteArray& blob)
+{
+    return store_blob(file_path, stamp, "stream_params", blob);
+}
+
+QByteArray media_cache::load_loudness(const QString& file_path, const file_stamp& stamp)
+{
+    return load_blob(file_path, stamp, "loudness");
+}
+
+bool media_cache::store_loudness(const QString& file_path, const file_stamp& stamp, const QByteArray& blob)
+{
+    return store_blob(file_path, stamp, "loudness", blob);
+}
+
+QByteArray media_cache::load_waveform(const QString& file_path, const file_stamp& stamp)
+{
+    return load_blob(file_path, stamp, "waveform");
+}
+
+bool media_cache::store_waveform(const QString& file_path, const file_stamp& stamp, const QByteArray& blob)
+{
+    return store_blob(file_path, stamp, "waveform", blob);
+}
+
+QList<QByteArray> media_cache::load_album_loudness(const QString& file_path)
+{
+    QList<QByteArray> blobs;
+    const QString directory = QFileInfo(file_path).absolutePath();
+    with_connection(
+        [&](QSqlDatabase& db)
+        {
+            QSqlQuery query(db);
+            query.prepare(
+                "SELECT s.file_path, s.loudness FROM Songs s JOIN Songs t ON s.album = t.album "
+                "WHERE t.file_path = :path AND s.file_path != t.file_path AND t.album IS NOT NULL AND t.album != '' "
+                "AND s.loudness IS NOT NULL");
+            query.bindValue(":path", file_path);
+            if (!query.exec())
+            {
+                return;
+            }
+            while (query.next())
+            {
+                if (QFileInfo(query.value(0).toString()).absolutePath() == directory)
+                {
+                    blobs.append(query.value(1).toByteArray());
+                }
+            }
+        });
+    return blobs;
+}
+
+QStringList media_cache::pending_loudness_paths(qint64& after_song_id, int limit)
+{
+    QStringList paths;
+    with_connection(
+        [&](QSqlDatabase& db)
+        {
+            QSqlQuery query(db);
+            query.prepare("SELECT song_id, file_path FROM Songs WHERE loudness IS NULL AND song_id > :after ORDER BY song_id LIMIT :limit");
+            query.bindValue(":after", after_song_id);
+            query.bindValue(":limit", limit);
+            if (!query.exec())
+            {
+                return;
+            }
+            while (query.next())
+            {
+                after_song_id = query.value(0).toLongLong();
+                paths.append(query.value(1).toString());
+            }
+        });
+    return paths;
+}
@@ -0,0 +1,43 @@
+#ifndef MEDIA_CACHE_H
+#define MEDIA_CACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QStringList>
+
+class media_cache
+{
+   public:
+    struct file_stamp
+    {
+        qint64 size = -1;
+        qint64 mtime_ms = -1;
+
+        [[nodiscard]] bool valid() const { return size >= 0 && mtime_ms >= 0; }
+    };
+
+    struct open_blobs
+    {
+        QByteArray stream_params;
+        QByteArray seek_index;
+    };
+
+    static file_stamp stamp_of(const QString& file_path);
+
+    static bool store_seek_index(const QString& file_path, const file_stamp& stamp, const QByteArray& blob);
+
+    static QByteArray load_stream_params(const QString& file_path, const file_stamp& stamp);
+    static open_blobs load_open_blobs(const QString& file_path, const file_stamp& stamp);
+    static bool store_stream_params(const QString& file_path, const file_stamp& stamp, const QByteArray& blob);
+
+    static QByteArray load_loudness(const QString& file_path, const file_stamp& stamp);
+    static bool store_loudness(const QString& file_path, const file_stamp& stamp, const QByteArray& blob);
+    static QList<QByteArray> load_album_loudness(const QString& file_path);
+    static QStringList pending_loudness_paths(qint64& after_song_id, int limit);
+
+    static QByteArray load_waveform(const QString& file_path, const file_stamp& stamp);
+    static bool store_waveform(const QString& file_path, const file_stamp& stamp, const QByteArray& blob);
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "log.h"
+#include "scoped_exit.h"
+#include "media_probe.h"
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+}
+
+static void collect_tags(const AVDictionary* dict, QMap<QString, QString>& tags)
+{
+    const AVDictionaryEntry* tag = nullptr;
+    while ((tag = av_dict_get(dict, "", tag, AV_DICT_IGNORE_SUFFIX)) != nullptr)
+    {
+        tags.insert(QString::fromUtf8(tag->key), QString::fromUtf8(tag->value));
+    }
+}
+
+static bool header_is_sufficient(const AVFormatContext* ctx, const AVStream* stream)
+{
+    const AVCodecParameters* par = stream->codecpar;
+    const bool has_duration = ctx->duration != AV_NOPTS_VALUE || stream->duration != AV_NOPTS_VALUE;
+    return par->codec_id != AV_CODEC_ID_NONE && par->sample_rate > 0 && par->ch_layout.nb_channels > 0 && has_duration;
+}
+
+QString media_probe::result::tag(const QString& key) const
+{
+    for (auto it = tags.constKeyValueBegin(); it != tags.constKeyValueEnd(); ++it)
+    {
+        if (it->first.compare(key, Qt::CaseInsensitive) == 0)
+        {
+            return it->second;
+        }
+    }
+    return {};
+}
+
+media_probe::result media_probe::probe(const QString& file_path)
+{
+    result r;
+    AVFormatContext* ctx = nullptr;
+    int ret = avformat_open_input(&ctx, file_path.toUtf8().constData(), nullptr, nullptr);
+    if (ret != 0)
+    {
+        LOG_DEBUG("媒体探测 无法打开 {}", file_path.toStdString());
+        return r;
+    }
+    DEFER(avformat_close_input(&ctx));
+
+    int audio_index = -1;
+    for (unsigned int i = 0; i < ctx->nb_streams; ++i)
+    {
+        const AVStream* st = ctx->streams[i];
+        if ((st->disposition & AV_DISPOSITION_ATTACHED_PIC) != 0)
+        {
+            if (r.cover_art_offset < 0 && st->attached_pic.size > 0)
+            {
+                r.cover_art_offset = st->attached_pic.pos;
+                r.cover_art_size = st->attached_pic.size;
+            }
+            continue;
+        }
+        if (audio_index < 0 && st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+        {
+            audio_index = static_cast<int>(i);
+        }
+    }
+
+    if (audio_index < 0 || !header_is_sufficient(ctx, ctx->streams[audio_index]))
+    {
+        if (avformat_find_stream_info(ctx, nullptr) < 0)
+        {
+            LOG_DEBUG("媒体探测 无法读取流信息 {}", file_path.toStdString());
+            return r;
+        }
+        r.stream_info_probed = true;
+        audio_index = av_find_best_stream(ctx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+        if (audio_index < 0)
+        {
+            return r;
+        }
+    }
+
+    const AVStream* stream = ctx->streams[audio_index];
+    const AVCodecParameters* par = stream->codecpar;
+
+    collect_tags(ctx->metadata, r.tags);
+    collect_tags(stream->metadata, r.tags);
+
+    if (ctx->duration != AV_NOPTS_VALUE)
+    {
+        r.duration_ms = ctx->duration / (AV_TIME_BASE / 1000);
+    }
+    else if (stream->duration != AV_NOPTS_VALUE)
+    {
+        r.duration_ms = av_rescale_q(stream->duration, stream->time_base, {1, 1000});
+    }
+
+    r.container = QString::fromUtf8(ctx->iformat->name);
+    r.codec = QString::fromUtf8(avcodec_get_name(par->codec_id));
+    r.sample_rate = par->sample_rate;
+    r.channels = par->ch_layout.nb_channels;
+    r.bit_rate = par->bit_rate > 0 ? par->bit_rate : ctx->bit_rate;
+    r.ok = true;
+    return r;
+}
@@ -0,0 +1,31 @@
+#ifndef MEDIA_PROBE_H
+#define MEDIA_PROBE_H
+
+#include <cstdint>
+#include <QMap>
+#include <QString>
+
+class media_probe
+{
+   public:
+    struct result
+    {
+        bool ok = false;
+        bool stream_info_probed = false;
+        QMap<QString, QString> tags;
+        qint64 duration_ms = -1;
+        QString container;
+        QString codec;
+        int sample_rate = 0;
+        int channels = 0;
+        int64_t bit_rate = 0;
+        int64_t cover_art_offset = -1;
+        int cover_art_size = 0;
+
+        [[nodiscard]] QString tag(const QString& key) const;
+    };
+
+    static result probe(const QString& file_path);
+};
+
+#endif
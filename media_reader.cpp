@@ -0,0 +1,113 @@
+#include <QThreadPool>
+#include "log.h"
+#include "media_reader.h"
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#endif
+
+extern "C"
+{
+#include <libavutil/mem.h>
+#include <libavutil/error.h>
+}
+
+media_reader::~media_reader()
+{
+    if (io_ != nullptr)
+    {
+        av_freep(&io_->buffer);
+        avio_context_free(&io_);
+    }
+}
+
+bool media_reader::open(const QString& file_path, int read_ahead_bytes)
+{
+    file_.setFileName(file_path);
+    if (!file_.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+    {
+        LOG_WARN("媒体读取 无法打开 {} {}", file_path.toStdString(), file_.errorString().toStdString());
+        return false;
+    }
+#ifdef Q_OS_UNIX
+    posix_fadvise(file_.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    auto* buffer = static_cast<uint8_t*>(av_malloc(static_cast<size_t>(read_ahead_bytes)));
+    if (buffer == nullptr)
+    {
+        return false;
+    }
+    io_ = avio_alloc_context(buffer, read_ahead_bytes, 0, this, &media_reader::read_packet, nullptr, &media_reader::seek);
+    if (io_ == nullptr)
+    {
+        av_free(buffer);
+        return false;
+    }
+    return true;
+}
+
+int media_reader::read_packet(void* opaque, uint8_t* buffer, int size)
+{
+    auto* reader = static_cast<media_reader*>(opaque);
+    const qint64 n = reader->file_.read(reinterpret_cast<char*>(buffer), size);
+    if (n < 0)
+    {
+        return AVERROR(EIO);
+    }
+    if (n == 0)
+    {
+        return AVERROR_EOF;
+    }
+    reader->stats_.reads++;
+    reader->stats_.bytes += static_cast<uint64_t>(n);
+    return static_cast<int>(n);
+}
+
+int64_t media_reader::seek(void* opaque, int64_t offset, int whence)
+{
+    auto* reader = static_cast<media_reader*>(opaque);
+    switch (whence & ~AVSEEK_FORCE)
+    {
+        case AVSEEK_SIZE:
+            return reader->file_.size();
+        case SEEK_SET:
+            break;
+        case SEEK_CUR:
+            offset += reader->file_.pos();
+            break;
+        case SEEK_END:
+            offset += reader->file_.size();
+            break;
+        default:
+            return AVERROR(EINVAL);
+    }
+    if (!reader->file_.seek(offset))
+    {
+        return AVERROR(EIO);
+    }
+    return offset;
+}
+
+void media_reader::prefetch(const QStringList& file_paths, qint64 bytes_per_file)
+{
+#ifdef Q_OS_UNIX
+    for (const QString& path : file_paths)
+    {
+        QThreadPool::globalInstance()->start(
+            [path, bytes_per_file]()
+            {
+                QFile file(path);
+                if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+                {
+                    return;
+                }
+                const int ret = posix_fadvise(file.handle(), 0, static_cast<off_t>(bytes_per_file), POSIX_FADV_WILLNEED);
+                LOG_DEBUG("预读 {} 字节 {} 结果 {}", bytes_per_file, path.toStdString(), ret);
+            });
+    }
+#else
+    (void)file_paths;
+    (void)bytes_per_file;
+#endif
+}
@@ -0,0 +1,45 @@
+#ifndef MEDIA_READER_H
+#define MEDIA_READER_H
+
+#include <cstdint>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+
+extern "C"
+{
+#include <libavformat/avio.h>
+}
+
+class media_reader
+{
+   public:
+    struct stats
+    {
+        uint64_t reads = 0;
+        uint64_t bytes = 0;
+    };
+
+    media_reader() = default;
+    ~media_reader();
+
+    media_reader(const media_reader&) = delete;
+    media_reader& operator=(const media_reader&) = delete;
+
+    bool open(const QString& file_path, int read_ahead_bytes);
+    [[nodiscard]] AVIOContext* io() const { return io_; }
+    [[nodiscard]] stats snapshot() const { return stats_; }
+
+    static void prefetch(const QStringList& file_paths, qint64 bytes_per_file);
+
+   private:
+    static int read_packet(void* opaque, uint8_t* buffer, int size);
+    static int64_t seek(void* opaque, int64_t offset, int whence);
+
+   private:
+    QFile file_;
+    AVIOContext* io_ = nullptr;
+    stats stats_;
+};
+
+#endif
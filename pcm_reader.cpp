@@ -0,0 +1,161 @@
+#include "log.h"
+#include "scoped_exit.h"
+#include "pcm_reader.h"
+
+extern "C"
+{
+#include <libavutil/channel_layout.h>
+}
+
+pcm_reader::~pcm_reader() { close(); }
+
+void pcm_reader::close()
+{
+    if (swr_data_ != nullptr)
+    {
+        av_freep(&swr_data_);
+    }
+    swr_free(&swr_ctx_);
+    avcodec_free_context(&codec_ctx_);
+    avformat_close_input(&format_ctx_);
+}
+
+bool pcm_reader::open(const QString& file_path)
+{
+    close();
+    auto guard = make_scoped_exit([this]() { close(); });
+
+    if (avformat_open_input(&format_ctx_, file_path.toUtf8().constData(), nullptr, nullptr) != 0)
+    {
+        return false;
+    }
+    if (avformat_find_stream_info(format_ctx_, nullptr) < 0)
+    {
+        return false;
+    }
+
+    const AVCodec* codec = nullptr;
+    stream_index_ = av_find_best_stream(format_ctx_, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+    if (stream_index_ < 0 || codec == nullptr)
+    {
+        return false;
+    }
+
+    codec_ctx_ = avcodec_alloc_context3(codec);
+    if (codec_ctx_ == nullptr || avcodec_parameters_to_context(codec_ctx_, format_ctx_->streams[stream_index_]->codecpar) < 0)
+    {
+        return false;
+    }
+    if (avcodec_open2(codec_ctx_, codec, nullptr) < 0)
+    {
+        return false;
+    }
+
+    sample_rate_ = codec_ctx_->sample_rate;
+    channels_ = codec_ctx_->ch_layout.nb_channels;
+    if (sample_rate_ <= 0 || channels_ <= 0)
+    {
+        return false;
+    }
+
+    if (swr_alloc_set_opts2(&swr_ctx_,
+                            &codec_ctx_->ch_layout,
+                            AV_SAMPLE_FMT_FLT,
+                            sample_rate_,
+                            &codec_ctx_->ch_layout,
+                            codec_ctx_->sample_fmt,
+                            sample_rate_,
+                            0,
+                            nullptr) != 0 ||
+        swr_init(swr_ctx_) != 0)
+    {
+        return false;
+    }
+
+    guard.cancel();
+    return true;
+}
+
+bool pcm_reader::emit_frame(const AVFrame* frame, const block_callback& callback)
+{
+    if (frame->nb_samples > swr_capacity_)
+    {
+        av_freep(&swr_data_);
+        if (av_samples_alloc(&swr_data_, nullptr, channels_, frame->nb_samples, AV_SAMPLE_FMT_FLT, 0) < 0)
+        {
+            swr_capacity_ = 0;
+            return false;
+        }
+        swr_capacity_ = frame->nb_samples;
+    }
+
+    const int converted = swr_convert(swr_ctx_, &swr_data_, swr_capacity_, const_cast<const uint8_t**>(frame->extended_data), frame->nb_samples);
+    if (converted < 0)
+    {
+        return false;
+    }
+    if (converted > 0)
+    {
+        callback(reinterpret_cast<const float*>(swr_data_), converted);
+    }
+    return true;
+}
+
+bool pcm_reader::read_all(const block_callback& callback, const std::atomic<bool>& cancel)
+{
+    if (codec_ctx_ == nullptr)
+    {
+        return false;
+    }
+
+    AVPacket* packet = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+    DEFER(av_packet_free(&packet));
+    DEFER(av_frame_free(&frame));
+    if (packet == nullptr || frame == nullptr)
+    {
+        return false;
+    }
+
+    bool draining = false;
+    while (!cancel.load(std::memory_order_relaxed))
+    {
+        const int receive_ret = avcodec_receive_frame(codec_ctx_, frame);
+        if (receive_ret == 0)
+        {
+            const bool ok = emit_frame(frame, callback);
+            av_frame_unref(frame);
+            if (!ok)
+            {
+                return false;
+            }
+            continue;
+        }
+        if (receive_ret == AVERROR_EOF)
+        {
+            return true;
+        }
+        if (receive_ret != AVERROR(EAGAIN))
+        {
+            return false;
+        }
+        if (draining)
+        {
+            return true;
+        }
+
+        const int read_ret = av_read_frame(format_ctx_, packet);
+        if (read_ret < 0)
+        {
+            avcodec_send_packet(codec_ctx_, nullptr);
+            draining = true;
+            continue;
+        }
+        if (packet->stream_index == stream_index_)
+        {
+            avcodec_send_packet(codec_ctx_, packet);
+        }
+        av_packet_unref(packet);
+    }
+    return false;
+}
@@ -0,0 +1,47 @@
+#ifndef PCM_READER_H
+#define PCM_READER_H
+
+#include <atomic>
+#include <functional>
+#include <QString>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswresample/swresample.h>
+}
+
+class pcm_reader
+{
+   public:
+    using block_callback = std::function<void(const float* samples, int frames)>;
+
+    pcm_reader() = default;
+    ~pcm_reader();
+
+    pcm_reader(const pcm_reader&) = delete;
+    pcm_reader& operator=(const pcm_reader&) = delete;
+
+    bool open(const QString& file_path);
+    bool read_all(const block_callback& callback, const std::atomic<bool>& cancel);
+
+    [[nodiscard]] int sample_rate() const { return sample_rate_; }
+    [[nodiscard]] int channels() const { return channels_; }
+
+   private:
+    bool emit_frame(const AVFrame* frame, const block_callback& callback);
+    void close();
+
+   private:
+    AVFormatContext* format_ctx_ = nullptr;
+    AVCodecContext* codec_ctx_ = nullptr;
+    SwrContext* swr_ctx_ = nullptr;
+    uint8_t* swr_data_ = nullptr;
+    int swr_capacity_ = 0;
+    int stream_index_ = -1;
+    int sample_rate_ = 0;
+    int channels_ = 0;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef PCM_RING_H
+#define PCM_RING_H
+
+#include <atomic>
+#include <memory>
+#include <boost/lockfree/spsc_queue.hpp>
+
+#include "audio_packet.h"
+#include "spectrum_timeline.h"
+
+class pcm_ring
+{
+   public:
+    static constexpr size_t kCapacity = 1024;
+
+    pcm_ring() = default;
+
+    pcm_ring(const pcm_ring&) = delete;
+    pcm_ring& operator=(const pcm_ring&) = delete;
+
+    bool push(const audio_packet_ptr& packet)
+    {
+        if (!queue_.push(packet))
+        {
+            return false;
+        }
+        buffered_bytes_.fetch_add(static_cast<int64_t>(packet->data.size()), std::memory_order_relaxed);
+        return true;
+    }
+
+    bool pop(audio_packet_ptr& packet)
+    {
+        if (!queue_.pop(packet))
+        {
+            return false;
+        }
+        buffered_bytes_.fetch_sub(static_cast<int64_t>(packet->data.size()), std::memory_order_relaxed);
+        return true;
+    }
+    [[nodiscard]] bool is_current(const audio_packet_ptr& packet) const { return packet->serial == serial_.load(std::memory_order_acquire); }
+
+    [[nodiscard]] bool empty() const { return queue_.read_available() == 0; }
+    [[nodiscard]] int64_t buffered_bytes() const { return buffered_bytes_.load(std::memory_order_relaxed); }
+
+    void set_water_marks(int64_t low_bytes, int64_t high_bytes)
+    {
+        low_water_bytes_.store(low_bytes, std::memory_order_relaxed);
+        high_water_bytes_.store(high_bytes, std::memory_order_relaxed);
+    }
+    [[nodiscard]] bool above_high_water() const
+    {
+        return queue_.write_available() == 0 || buffered_bytes() >= high_water_bytes_.load(std::memory_order_relaxed);
+    }
+    [[nodiscard]] bool below_low_water() const { return buffered_bytes() < low_water_bytes_.load(std::memory_order_relaxed); }
+
+    [[nodiscard]] uint32_t serial() const { return serial_.load(std::memory_order_acquire); }
+    uint32_t begin_serial()
+    {
+        finished_.store(false, std::memory_order_release);
+        return serial_.fetch_add(1, std::memory_order_acq_rel) + 1;
+    }
+
+    void mark_finished() { finished_.store(true, std::memory_order_release); }
+    [[nodiscard]] bool is_finished() const { return finished_.load(std::memory_order_acquire); }
+
+    void set_replay_gain(float factor) { replay_gain_.store(factor, std::memory_order_release); }
+    [[nodiscard]] float replay_gain() const { return replay_gain_.load(std::memory_order_acquire); }
+
+    spectrum_timeline& spectrum() { return spectrum_; }
+    [[nodiscard]] const spectrum_timeline& spectrum() const { return spectrum_; }
+
+   private:
+    boost::lockfree::spsc_queue<audio_packet_ptr, boost::lockfree::capacity<kCapacity>> queue_;
+    std::atomic<int64_t> buffered_bytes_{0};
+    std::atomic<int64_t> low_water_bytes_{0};
+    std::atomic<int64_t> high_water_bytes_{INT64_MAX};
+    std::atomic<uint32_t> serial_{0};
+    std::atomic<bool> finished_{false};
+    std::atomic<float> replay_gain_{1.0F};
+    spectrum_timeline spectrum_;
+};
+
+Q_DECLARE_METATYPE(std::shared_ptr<pcm_ring>);
+
+#endif
@@ -0,0 +1,110 @@
+#include <chrono>
+#include <algorithm>
+#include "playback_clock.h"
+
+qint64 steady_clock_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+playback_clock::state playback_clock::load() const
+{
+    state s;
+    uint32_t before = 0;
+    uint32_t after = 0;
+    do
+    {
+        before = sequence_.load(std::memory_order_acquire);
+        s.session_id = session_id_.load(std::memory_order_relaxed);
+        s.offset_ms = offset_ms_.load(std::memory_order_relaxed);
+        s.sample_rate = sample_rate_.load(std::memory_order_relaxed);
+        s.latency_frames = latency_frames_.load(std::memory_order_relaxed);
+        s.anchor_frames = anchor_frames_.load(std::memory_order_relaxed);
+        s.written_frames = written_frames_.load(std::memory_order_relaxed);
+        s.anchor_ns = anchor_ns_.load(std::memory_order_relaxed);
+        s.running = running_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = sequence_.load(std::memory_order_relaxed);
+    } while ((before & 1U) != 0 || before != after);
+    return s;
+}
+
+void playback_clock::store(const state& s)
+{
+    const uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    session_id_.store(s.session_id, std::memory_order_relaxed);
+    offset_ms_.store(s.offset_ms, std::memory_order_relaxed);
+    sample_rate_.store(s.sample_rate, std::memory_order_relaxed);
+    latency_frames_.store(s.latency_frames, std::memory_order_relaxed);
+    anchor_frames_.store(s.anchor_frames, std::memory_order_relaxed);
+    written_frames_.store(s.written_frames, std::memory_order_relaxed);
+    anchor_ns_.store(s.anchor_ns, std::memory_order_relaxed);
+    running_.store(s.running, std::memory_order_relaxed);
+    sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+int64_t playback_clock::frames_at(const state& s, int64_t now_ns)
+{
+    int64_t frames = s.anchor_frames;
+    if (s.running && s.sample_rate > 0 && now_ns > s.anchor_ns)
+    {
+        frames += (now_ns - s.anchor_ns) * s.sample_rate / 1000000000;
+    }
+    return std::min(frames, s.written_frames);
+}
+
+void playback_clock::reset(qint64 session_id, qint64 offset_ms, int sample_rate, int64_t latency_frames)
+{
+    state s;
+    s.session_id = session_id;
+    s.offset_ms = offset_ms;
+    s.sample_rate = sample_rate;
+    s.latency_frames = latency_frames;
+    s.anchor_frames = -latency_frames;
+    s.written_frames = 0;
+    s.anchor_ns = steady_clock_ns();
+    s.running = true;
+    store(s);
+}
+
+void playback_clock::advance(int64_t frames_written, int64_t now_ns)
+{
+    state s = load();
+    s.anchor_frames = frames_written - s.latency_frames;
+    s.written_frames = frames_written;
+    s.anchor_ns = now_ns;
+    store(s);
+}
+
+void playback_clock::set_running(bool running, int64_t now_ns)
+{
+    state s = load();
+    if (s.running == running)
+    {
+        return;
+    }
+    s.anchor_frames = frames_at(s, now_ns);
+    s.anchor_ns = now_ns;
+    s.running = running;
+    store(s);
+}
+
+void playback_clock::stop() { store(state{}); }
+
+playback_clock::reading playback_clock::read(int64_t now_ns) const
+{
+    const state s = load();
+    reading r;
+    r.session_id = s.session_id;
+    r.running = s.running;
+    if (s.session_id == 0 || s.sample_rate <= 0)
+    {
+        return r;
+    }
+
+    const int64_t frames = std::max<int64_t>(0, frames_at(s, now_ns));
+    r.position_us = (s.offset_ms * 1000) + (frames * 1000000 / s.sample_rate);
+    return r;
+}
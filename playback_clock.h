@@ -0,0 +1,64 @@
+#ifndef PLAYBACK_CLOCK_H
+#define PLAYBACK_CLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <QtGlobal>
+
+qint64 steady_clock_ns();
+
+class playback_clock
+{
+   public:
+    struct reading
+    {
+        qint64 session_id = 0;
+        qint64 position_us = -1;
+        bool running = false;
+
+        [[nodiscard]] qint64 position_ms() const { return position_us < 0 ? -1 : position_us / 1000; }
+    };
+
+    playback_clock() = default;
+
+    playback_clock(const playback_clock&) = delete;
+    playback_clock& operator=(const playback_clock&) = delete;
+
+    void reset(qint64 session_id, qint64 offset_ms, int sample_rate, int64_t latency_frames);
+    void advance(int64_t frames_written, int64_t now_ns);
+    void set_running(bool running, int64_t now_ns);
+    void stop();
+
+    [[nodiscard]] reading read(int64_t now_ns) const;
+    [[nodiscard]] reading read() const { return read(steady_clock_ns()); }
+
+   private:
+    struct state
+    {
+        qint64 session_id = 0;
+        qint64 offset_ms = 0;
+        int64_t sample_rate = 0;
+        int64_t latency_frames = 0;
+        int64_t anchor_frames = 0;
+        int64_t written_frames = 0;
+        int64_t anchor_ns = 0;
+        bool running = false;
+    };
+
+    [[nodiscard]] state load() const;
+    void store(const state& s);
+    [[nodiscard]] static int64_t frames_at(const state& s, int64_t now_ns);
+
+   private:
+    std::atomic<uint32_t> sequence_{0};
+    std::atomic<qint64> session_id_{0};
+    std::atomic<qint64> offset_ms_{0};
+    std::atomic<int64_t> sample_rate_{0};
+    std::atomic<int64_t> latency_frames_{0};
+    std::atomic<int64_t> anchor_frames_{0};
+    std::atomic<int64_t> written_frames_{0};
+    std::atomic<int64_t> anchor_ns_{0};
+    std::atomic<bool> running_{false};
+};
+
+#endif
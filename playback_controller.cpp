@@ -1,50 +1,111 @@
+#include <utility>
+#include <algorithm>
 #include <QMetaObject>
 #include <QThread>
 #include <QFileInfo>
+#include <QSettings>
 #include "log.h"
 #include "audio_player.h"
 #include "audio_decoder.h"
 #include "spectrum_widget.h"
+#include "media_reader.h"
+#include "audio_packet_pool.h"
 #include "playback_controller.h"
 
+constexpr qint64 kDefaultPrefetchKb = 4096;
+constexpr qint64 kDefaultPrimedCacheMb = 32;
+constexpr qint64 kPrimedSeconds = 3;
+constexpr qint64 kPrimedGranularityMs = 40;
+constexpr int kPrimerPollIntervalMs = 20;
+
 playback_controller::playback_controller(QObject* parent) : QObject(parent)
 {
-    qRegisterMetaType<std::shared_ptr<audio_packet>>("std::shared_ptr<audio_packet>");
+    qRegisterMetaType<audio_packet_ptr>("audio_packet_ptr");
+    qRegisterMetaType<std::shared_ptr<pcm_ring>>("std::shared_ptr<pcm_ring>");
     qRegisterMetaType<QMap<QString, QString>>("QMap<QString, QString>");
     qRegisterMetaType<QByteArray>("QByteArray");
     qRegisterMetaType<QList<LyricLine>>("QList<LyricLine>");
     qRegisterMetaType<playback_mode>("playback_mode");
 
     decoder_thread_ = new QThread(this);
-    decoder_ = new audio_decoder();
-    decoder_->moveToThread(decoder_thread_);
+    decoder_ = create_decoder(decoder_thread_);
+    next_decoder_thread_ = new QThread(this);
+    next_decoder_ = create_decoder(next_decoder_thread_);
 
-    connect(decoder_, &audio_decoder::duration_ready, this, &playback_controller::on_duration_ready, Qt::QueuedConnection);
-    connect(decoder_, &audio_decoder::packet_ready, this, &playback_controller::on_packet_from_decoder, Qt::QueuedConnection);
-    connect(decoder_, &audio_decoder::seek_finished, this, &playback_controller::on_decoder_seek_finished, Qt::QueuedConnection);
-    connect(decoder_, &audio_decoder::decoding_error, this, &playback_controller::on_decoding_error, Qt::QueuedConnection);
-    connect(decoder_, &audio_decoder::metadata_ready, this, &playback_controller::on_metadata_ready, Qt::QueuedConnection);
-    connect(decoder_, &audio_decoder::cover_art_ready, this, &playback_controller::on_cover_art_ready, Qt::QueuedConnection);
-    connect(decoder_, &audio_decoder::lyrics_ready, this, &playback_controller::on_lyrics_ready, Qt::QueuedConnection);
+    player_thread_ = new QThread(this);
+    player_ = new audio_player();
+    player_->set_volume(cached_volume_);
+    clock_ = player_->clock();
+    decoder_->set_output_preference(player_->preferred_format());
+    next_decoder_->set_output_preference(player_->preferred_format());
+
+    primer_thread_ = new QThread(this);
+    primer_decoder_ = new audio_decoder();
+    primer_decoder_->set_output_preference(player_->preferred_format());
+    primer_decoder_->moveToThread(primer_thread_);
+    connect(primer_decoder_, &audio_decoder::duration_ready, this, &playback_controller::on_primer_duration_ready, Qt::QueuedConnection);
+    connect(primer_decoder_, &audio_decoder::decoding_error, this, &playback_controller::on_primer_error, Qt::QueuedConnection);
+    connect(primer_thread_, &QThread::finished, primer_decoder_, &QObject::deleteLater);
+    primer_timer_ = new QTimer(this);
+    primer_timer_->setInterval(kPrimerPollIntervalMs);
+    connect(primer_timer_, &QTimer::timeout, this, &playback_controller::on_primer_tick);
+    QSettings settings("MusicPlayer", "MusicPlayer");
+    primed_cache_.set_budget(settings.value("cache/primed_mb", kDefaultPrimedCacheMb).toLongLong() * 1024 * 1024);
+    scrub_enabled_ = settings.value("playback/scrub_preview", true).toBool();
+    scrub_preview_ = std::make_unique<scrub_preview>([player = player_](const audio_packet_ptr& grain, qint64 requested_ns)
+                                                     { player->queue_scrub_grain(grain, requested_ns); });
+    player_->moveToThread(player_thread_);
 
-    connect(decoder_thread_, &QThread::finished, decoder_, &QObject::deleteLater);
+    connect(player_, &audio_player::playback_finished, this, &playback_controller::on_playback_completed, Qt::QueuedConnection);
+    connect(player_, &audio_player::playback_ready, this, &playback_controller::on_player_ready_for_spectrum, Qt::QueuedConnection);
+    connect(player_, &audio_player::playback_error, this, &playback_controller::on_player_error, Qt::QueuedConnection);
+    connect(player_, &audio_player::seek_handled, this, &playback_controller::on_player_seek_handled, Qt::QueuedConnection);
+    connect(player_, &audio_player::track_switched, this, &playback_controller::on_player_track_switched, Qt::QueuedConnection);
+    connect(player_thread_, &QThread::finished, player_, &QObject::deleteLater);
 
     decoder_thread_->start();
-    LOG_INFO("播放控制器已初始化解码器线程已启动");
+    next_decoder_thread_->start();
+    primer_thread_->start();
+    player_thread_->start();
+    player_thread_->setPriority(QThread::TimeCriticalPriority);
+    LOG_INFO("播放控制器已初始化 解码器与输出引擎线程已启动");
 }
 playback_controller::~playback_controller()
 {
     stop();
+    scrub_preview_.reset();
+    cleanup_player();
     decoder_thread_->quit();
+    next_decoder_thread_->quit();
+    primer_thread_->quit();
     decoder_thread_->wait();
+    next_decoder_thread_->wait();
+    primer_thread_->wait();
     LOG_INFO("播放控制器已销毁");
 }
 
+audio_decoder* playback_controller::create_decoder(QThread* thread)
+{
+    auto* decoder = new audio_decoder();
+    decoder->moveToThread(thread);
+
+    connect(decoder, &audio_decoder::duration_ready, this, &playback_controller::on_duration_ready, Qt::QueuedConnection);
+    connect(decoder, &audio_decoder::seek_finished, this, &playback_controller::on_decoder_seek_finished, Qt::QueuedConnection);
+    connect(decoder, &audio_decoder::decoding_error, this, &playback_controller::on_decoding_error, Qt::QueuedConnection);
+    connect(decoder, &audio_decoder::metadata_ready, this, &playback_controller::on_metadata_ready, Qt::QueuedConnection);
+    connect(decoder, &audio_decoder::cover_art_ready, this, &playback_controller::on_cover_art_ready, Qt::QueuedConnection);
+    connect(decoder, &audio_decoder::lyrics_ready, this, &playback_controller::on_lyrics_ready, Qt::QueuedConnection);
+
+    connect(thread, &QThread::finished, decoder, &QObject::deleteLater);
+    return decoder;
+}
+
 void playback_controller::set_spectrum_widget(spectrum_widget* widget)
 {
     spectrum_widget_ = widget;
     if (spectrum_widget_ != nullptr)
     {
+        spectrum_widget_->set_playback_clock(clock_);
         connect(
             spectrum_widget_, &spectrum_widget::playback_started, this, &playback_controller::on_spectrum_ready_for_decoding, Qt::QueuedConnection);
         LOG_INFO("已为播放控制器设置频谱部件");
@@ -57,14 +118,308 @@ void playback_controller::set_playback_mode(playback_mode mode)
     current_mode_ = mode;
 }
 
+void playback_controller::prefetch(const QStringList& file_paths)
+{
+    if (file_paths.isEmpty())
+    {
+        return;
+    }
+    QSettings settings("MusicPlayer", "MusicPlayer");
+    const qint64 bytes = settings.value("decoder/prefetch_kb", kDefaultPrefetchKb).toLongLong() * 1024;
+    media_reader::prefetch(file_paths, bytes);
+}
+
+bool playback_controller::start_from_primed(const QString& file_path)
+{
+    const auto entry = primed_cache_.find(file_path);
+    if (!entry)
+    {
+        return false;
+    }
+
+    LOG_INFO("播放流程三 使用预解码缓存 {}ms 解码器从该位置续接", entry->primed_ms);
+    current_ring_ = std::make_shared<pcm_ring>();
+    current_ring_->set_replay_gain(entry->replay_gain);
+    current_ring_->spectrum().assign(current_ring_->serial(), entry->spectrum);
+    const qint64 frame_bytes = std::max(1, entry->format.bytesPerFrame());
+    const qint64 sample_rate = std::max(1, entry->format.sampleRate());
+    for (qsizetype offset = 0; offset < entry->pcm.size(); offset += static_cast<qsizetype>(kPacketSlabBytes))
+    {
+        const qsizetype size = std::min<qsizetype>(static_cast<qsizetype>(kPacketSlabBytes), entry->pcm.size() - offset);
+        auto packet = audio_packet_pool::instance().acquire(static_cast<size_t>(size));
+        const auto* begin = reinterpret_cast<const uint8_t*>(entry->pcm.constData()) + offset;
+        packet->data.assign(begin, begin + size);
+        packet->ms = offset / frame_bytes * 1000 / sample_rate;
+        packet->format = entry->format.sampleFormat();
+        packet->channels = entry->format.channelCount();
+        packet->sample_rate = entry->format.sampleRate();
+        packet->serial = current_ring_->serial();
+        current_ring_->push(packet);
+    }
+
+    QMetaObject::invokeMethod(decoder_,
+                              "continue_decoding",
+                              Qt::QueuedConnection,
+                              Q_ARG(qint64, current_session_id_),
+                              Q_ARG(QString, file_path),
+                              Q_ARG(std::shared_ptr<pcm_ring>, current_ring_),
+                              Q_ARG(qint64, entry->primed_ms));
+    on_duration_ready(current_session_id_, entry->total_duration_ms, entry->format);
+    return true;
+}
+
+void playback_controller::prime(const QStringList& file_paths)
+{
+    if (primed_cache_.snapshot().budget <= 0)
+    {
+        return;
+    }
+    primer_queue_.clear();
+    for (const QString& path : file_paths)
+    {
+        if (!path.isEmpty() && !primed_cache_.contains(path) && (!primer_entry_ || primer_entry_->file_path != path))
+        {
+            primer_queue_ << path;
+        }
+    }
+    if (primer_session_id_ == 0)
+    {
+        start_next_prime();
+    }
+}
+
+void playback_controller::start_next_prime()
+{
+    if (primer_queue_.isEmpty())
+    {
+        return;
+    }
+    const QString path = primer_queue_.takeFirst();
+    primer_session_id_ = ++session_id_counter_;
+    primer_ring_ = std::make_shared<pcm_ring>();
+    primer_entry_ = std::make_shared<primed_cache::entry>();
+    primer_entry_->file_path = path;
+    primer_entry_->stamp = media_cache::stamp_of(path);
+    LOG_DEBUG("预解码缓存 开始预解码 会话id {} 文件 {}", primer_session_id_, path.toStdString());
+    QMetaObject::invokeMethod(primer_decoder_,
+                              "start_decoding",
+                              Qt::QueuedConnection,
+                              Q_ARG(qint64, primer_session_id_),
+                              Q_ARG(QString, path),
+                              Q_ARG(std::shared_ptr<pcm_ring>, primer_ring_),
+                              Q_ARG(qint64, -1));
+}
+
+void playback_controller::on_primer_duration_ready(qint64 session_id, qint64 duration_ms, const QAudioFormat& format)
+{
+    if (session_id != primer_session_id_ || !primer_entry_)
+    {
+        return;
+    }
+    primer_entry_->format = format;
+    primer_entry_->total_duration_ms = duration_ms;
+    primer_entry_->replay_gain = primer_ring_->replay_gain();
+    primer_timer_->start();
+}
+
+void playback_controller::on_primer_error(qint64 session_id, const QString& error_message)
+{
+    if (session_id != primer_session_id_)
+    {
+        return;
+    }
+    LOG_DEBUG("预解码缓存 预解码失败 {}", error_message.toStdString());
+    finish_prime(false);
+}
+
+void playback_controller::on_primer_tick()
+{
+    if (!primer_entry_ || !primer_ring_)
+    {
+        primer_timer_->stop();
+        return;
+    }
+
+    const QAudioFormat& format = primer_entry_->format;
+    const qint64 frame_bytes = format.bytesPerFrame();
+    const qint64 target_bytes = frame_bytes * format.sampleRate() * kPrimedSeconds;
+
+    audio_packet_ptr packet;
+    while (primer_entry_->pcm.size() < target_bytes && primer_ring_->pop(packet))
+    {
+        primer_entry_->pcm.append(reinterpret_cast<const char*>(packet->data.data()), static_cast<qsizetype>(packet->data.size()));
+    }
+
+    if (primer_entry_->pcm.size() < target_bytes && !(primer_ring_->is_finished() && primer_ring_->empty()))
+    {
+        return;
+    }
+
+    const qint64 granule_frames = format.sampleRate() * kPrimedGranularityMs / 1000;
+    const qint64 frames = primer_entry_->pcm.size() / std::max<qint64>(1, frame_bytes);
+    const qint64 kept_frames = frames - (frames % std::max<qint64>(1, granule_frames));
+    primer_entry_->pcm.truncate(static_cast<qsizetype>(kept_frames * frame_bytes));
+    primer_entry_->primed_ms = format.sampleRate() > 0 ? kept_frames * 1000 / format.sampleRate() : 0;
+    primer_entry_->spectrum = primer_ring_->spectrum().copy_until(primer_entry_->primed_ms);
+    finish_prime(kept_frames > 0);
+}
+
+void playback_controller::finish_prime(bool store)
+{
+    primer_timer_->stop();
+    QMetaObject::invokeMethod(primer_decoder_, "shutdown", Qt::QueuedConnection);
+    if (store && primer_entry_)
+    {
+        primed_cache_.insert(primer_entry_);
+        const auto stats = primed_cache_.snapshot();
+        LOG_DEBUG("预解码缓存 已缓存 {}ms {} 占用 {}/{} 字节",
+                  primer_entry_->primed_ms,
+                  primer_entry_->file_path.toStdString(),
+                  stats.bytes,
+                  stats.budget);
+    }
+    primer_entry_.reset();
+    primer_ring_.reset();
+    primer_session_id_ = 0;
+    start_next_prime();
+}
+
+void playback_controller::prepare_next(const QString& file_path)
+{
+    if (next_track_.session_id != 0 && next_track_.file_path == file_path)
+    {
+        return;
+    }
+
+    cancel_preload();
+
+    if (file_path.isEmpty() || current_session_id_ == 0)
+    {
+        return;
+    }
+
+    next_track_.session_id = ++session_id_counter_;
+    next_track_.owner_session_id = current_session_id_;
+    next_track_.file_path = file_path;
+    next_track_.ring = std::make_shared<pcm_ring>();
+    LOG_INFO("无缝播放 预加载下一首 会话id {} 文件 {}", next_track_.session_id, file_path.toStdString());
+
+    QMetaObject::invokeMethod(next_decoder_,
+                              "start_decoding",
+                              Qt::QueuedConnection,
+                              Q_ARG(qint64, next_track_.session_id),
+                              Q_ARG(QString, file_path),
+                              Q_ARG(std::shared_ptr<pcm_ring>, next_track_.ring),
+                              Q_ARG(qint64, -1));
+}
+
+void playback_controller::cancel_preload()
+{
+    if (next_track_.session_id == 0)
+    {
+        return;
+    }
+
+    LOG_INFO("无缝播放 取消预加载 会话id {}", next_track_.session_id);
+    QMetaObject::invokeMethod(next_decoder_, "shutdown", Qt::QueuedConnection);
+    if (next_track_.queued && player_ != nullptr)
+    {
+        player_->cancel_next();
+        QMetaObject::invokeMethod(player_,
+                                  "queue_next",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(qint64, 0),
+                                  Q_ARG(std::shared_ptr<pcm_ring>, std::shared_ptr<pcm_ring>()),
+                                  Q_ARG(quint64, player_->preload_generation()));
+    }
+    next_track_ = preloaded_track{};
+}
+
+void playback_controller::on_next_track_ready(qint64 duration_ms, const QAudioFormat& format)
+{
+    next_track_.duration_ms = duration_ms;
+    next_track_.format = format;
+
+    if (player_ == nullptr || format != current_format_)
+    {
+        LOG_INFO("无缝播放 下一首格式与当前不同 将在曲目结束后重新打开设备 会话id {}", next_track_.session_id);
+        return;
+    }
+
+    next_track_.queued = true;
+    QMetaObject::invokeMethod(player_,
+                              "queue_next",
+                              Qt::QueuedConnection,
+                              Q_ARG(qint64, next_track_.session_id),
+                              Q_ARG(std::shared_ptr<pcm_ring>, next_track_.ring),
+                              Q_ARG(quint64, player_->preload_generation()));
+}
+
+void playback_controller::on_player_track_switched(qint64 from_session_id, qint64 session_id)
+{
+    if (session_id == 0 || session_id != next_track_.session_id || next_track_.owner_session_id != current_session_id_)
+    {
+        if (from_session_id != 0 && from_session_id == current_session_id_ && is_playing_)
+        {
+            LOG_WARN("无缝播放 播放器从当前会话 {} 切换到已取消的会话 {} 按播放结束处理", from_session_id, session_id);
+            on_playback_completed(from_session_id);
+            return;
+        }
+        LOG_INFO("无缝播放 忽略已过时的切换通知 会话id {} -> {} 当前会话 {}", from_session_id, session_id, current_session_id_);
+        return;
+    }
+
+    LOG_INFO("无缝播放 控制中心切换到下一首 会话id {} -> {}", current_session_id_, session_id);
+    QMetaObject::invokeMethod(decoder_, "shutdown", Qt::QueuedConnection);
+    std::swap(decoder_, next_decoder_);
+    std::swap(decoder_thread_, next_decoder_thread_);
+
+    preloaded_track track = std::move(next_track_);
+    next_track_ = preloaded_track{};
+
+    current_session_id_ = track.session_id;
+    current_ring_ = track.ring;
+    current_format_ = track.format;
+    current_file_path_ = track.file_path;
+    total_duration_ms_ = track.duration_ms;
+    playback_start_position_ms_ = 0;
+    is_seeking_ = false;
+    pending_seek_ms_ = -1;
+
+    QFileInfo file_info(track.file_path);
+    emit gapless_track_started(track.file_path);
+    emit playback_started(track.file_path, file_info.fileName());
+    emit track_info_ready(track.duration_ms);
+    if (!track.metadata.isEmpty())
+    {
+        emit metadata_ready(track.metadata);
+    }
+    if (!track.cover_art.isEmpty())
+    {
+        emit cover_art_ready(track.cover_art);
+    }
+    emit lyrics_updated(track.lyrics);
+
+    if (spectrum_widget_ != nullptr)
+    {
+        QMetaObject::invokeMethod(spectrum_widget_,
+                                  "reset_and_start",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(qint64, session_id),
+                                  Q_ARG(std::shared_ptr<pcm_ring>, current_ring_));
+    }
+}
+
 void playback_controller::play_file(const QString& file_path, qint64 start_position_ms)
 {
     LOG_INFO("播放流程二 控制中心收到文件播放请求");
+    play_request_time_ns_ = steady_clock_ns();
     stop();
     is_paused_ = false;
     playback_start_position_ms_ = qMax<qint64>(0, start_position_ms);
     LOG_INFO("重置暂停状态");
     current_session_id_ = ++session_id_counter_;
+    current_file_path_ = file_path;
     LOG_INFO("生成新会话id {}", current_session_id_);
 
     QFileInfo file_info(file_path);
@@ -72,18 +427,31 @@ void playback_controller::play_file(const QString& file_path, qint64 start_posit
     LOG_INFO("控制器发出playbackstarted信号");
     emit playback_started(file_path, file_name);
 
+    if (playback_start_position_ms_ == 0 && start_from_primed(file_path))
+    {
+        return;
+    }
+
     LOG_INFO("播放流程三 通知解码器开始处理文件");
+    current_ring_ = std::make_shared<pcm_ring>();
     const qint64 decoder_start_position_ms = playback_start_position_ms_ > 0 ? playback_start_position_ms_ : -1;
     QMetaObject::invokeMethod(decoder_,
                               "start_decoding",
                               Qt::QueuedConnection,
                               Q_ARG(qint64, current_session_id_),
                               Q_ARG(QString, file_path),
+                              Q_ARG(std::shared_ptr<pcm_ring>, current_ring_),
                               Q_ARG(qint64, decoder_start_position_ms));
 }
 
 void playback_controller::stop()
 {
+    cancel_preload();
+    if (is_scrubbing_)
+    {
+        is_scrubbing_ = false;
+        scrub_preview_->end();
+    }
     if (!is_media_loaded_ && !is_playing_)
     {
         return;
@@ -97,8 +465,8 @@ void playback_controller::stop()
     LOG_INFO("停止流程二 通知解码器关闭");
     QMetaObject::invokeMethod(decoder_, "shutdown", Qt::QueuedConnection);
 
-    LOG_INFO("停止流程三 通知播放器停止并清理");
-    cleanup_player();
+    LOG_INFO("停止流程三 通知播放器停止");
+    QMetaObject::invokeMethod(player_, "stop_playback", Qt::QueuedConnection);
 
     if (spectrum_widget_ != nullptr)
     {
@@ -110,6 +478,8 @@ void playback_controller::stop()
     pending_seek_ms_ = -1;
     playback_start_position_ms_ = 0;
     current_session_id_ = 0;
+    current_file_path_.clear();
+    current_ring_.reset();
 }
 
 void playback_controller::pause_resume()
@@ -167,6 +537,36 @@ void playback_controller::seek(qint64 position_ms)
     QMetaObject::invokeMethod(decoder_, "seek", Qt::QueuedConnection, Q_ARG(qint64, current_session_id_), Q_ARG(qint64, position_ms));
 }
 
+void playback_controller::begin_scrub()
+{
+    if (!scrub_enabled_ || !is_media_loaded_ || is_scrubbing_ || current_file_path_.isEmpty())
+    {
+        return;
+    }
+    is_scrubbing_ = true;
+    scrub_preview_->begin(current_file_path_, current_format_);
+    QMetaObject::invokeMethod(player_, "begin_scrub", Qt::QueuedConnection, Q_ARG(qint64, current_session_id_));
+}
+
+void playback_controller::scrub_to(qint64 position_ms)
+{
+    if (is_scrubbing_)
+    {
+        scrub_preview_->move_to(position_ms);
+    }
+}
+
+void playback_controller::end_scrub()
+{
+    if (!is_scrubbing_)
+    {
+        return;
+    }
+    is_scrubbing_ = false;
+    scrub_preview_->end();
+    QMetaObject::invokeMethod(player_, "end_scrub", Qt::QueuedConnection, Q_ARG(qint64, current_session_id_));
+}
+
 void playback_controller::set_volume(int volume_percent)
 {
     cached_volume_ = volume_percent;
@@ -178,6 +578,11 @@ void playback_controller::set_volume(int volume_percent)
 
 void playback_controller::on_duration_ready(qint64 session_id, qint64 duration_ms, const QAudioFormat& format)
 {
+    if (session_id != 0 && session_id == next_track_.session_id)
+    {
+        on_next_track_ready(duration_ms, format);
+        return;
+    }
     if (session_id != current_session_id_)
     {
         LOG_WARN("忽略已过时会话的durationready信号");
@@ -185,35 +590,21 @@ void playback_controller::on_duration_ready(qint64 session_id, qint64 duration_m
     }
     LOG_INFO("播放流程六 从解码器收到音频信息");
     total_duration_ms_ = duration_ms;
+    current_format_ = format;
     is_media_loaded_ = true;
     emit track_info_ready(duration_ms);
 
-    cleanup_player();
-
-    player_thread_ = new QThread(this);
-    player_ = new audio_player();
-    player_->set_volume(cached_volume_);
-
-    player_->moveToThread(player_thread_);
-
-    connect(player_, &audio_player::progress_update, this, &playback_controller::on_progress_update, Qt::QueuedConnection);
-    connect(player_, &audio_player::playback_finished, this, &playback_controller::on_playback_completed, Qt::QueuedConnection);
-    connect(player_, &audio_player::playback_ready, this, &playback_controller::on_player_ready_for_spectrum, Qt::QueuedConnection);
-    connect(player_, &audio_player::playback_error, this, &playback_controller::on_player_error, Qt::QueuedConnection);
-    connect(player_, &audio_player::packet_played, this, &playback_controller::on_packet_for_spectrum, Qt::QueuedConnection);
-    connect(player_, &audio_player::seek_handled, this, &playback_controller::on_player_seek_handled, Qt::QueuedConnection);
-    connect(player_, &audio_player::buffer_level_low, this, &playback_controller::on_buffer_level_low, Qt::QueuedConnection);
-    connect(player_, &audio_player::buffer_level_high, this, &playback_controller::on_buffer_level_high, Qt::QueuedConnection);
-    connect(player_thread_, &QThread::finished, player_, &QObject::deleteLater);
-
-    player_thread_->start();
-    player_thread_->setPriority(QThread::TimeCriticalPriority);
-
     const qint64 player_start_position_ms = qBound<qint64>(0, playback_start_position_ms_, duration_ms);
 
     LOG_INFO("播放流程八 通知播放器准备启动");
-    QMetaObject::invokeMethod(
-        player_, "start_playback", Qt::QueuedConnection, Q_ARG(qint64, session_id), Q_ARG(QAudioFormat, format), Q_ARG(qint64, player_start_position_ms));
+    QMetaObject::invokeMethod(player_,
+                              "start_playback",
+                              Qt::QueuedConnection,
+                              Q_ARG(qint64, session_id),
+                              Q_ARG(QAudioFormat, format),
+                              Q_ARG(std::shared_ptr<pcm_ring>, current_ring_),
+                              Q_ARG(qint64, player_start_position_ms),
+                              Q_ARG(qint64, play_request_time_ns_));
 }
 
 void playback_controller::on_player_ready_for_spectrum(qint64 session_id)
@@ -229,7 +620,11 @@ void playback_controller::on_player_ready_for_spectrum(qint64 session_id)
     }
     LOG_INFO("播放流程十 收到播放器的就绪信号");
     LOG_INFO("播放流程十一 通知频谱部件准备");
-    QMetaObject::invokeMethod(spectrum_widget_, "reset_and_start", Qt::QueuedConnection, Q_ARG(qint64, session_id), Q_ARG(qint64, 0));
+    QMetaObject::invokeMethod(spectrum_widget_,
+                              "reset_and_start",
+                              Qt::QueuedConnection,
+                              Q_ARG(qint64, session_id),
+                              Q_ARG(std::shared_ptr<pcm_ring>, current_ring_));
 }
 
 void playback_controller::on_spectrum_ready_for_decoding(qint64 session_id)
@@ -251,68 +646,36 @@ void playback_controller::on_player_error(const QString& error_message)
     stop();
 }
 
-void playback_controller::on_decoding_error(const QString& error_message)
-{
-    LOG_ERROR("收到解码器错误 {}", error_message.toStdString());
-    emit playback_error(error_message);
-    stop();
-}
-
-void playback_controller::on_packet_from_decoder(qint64 session_id, const std::shared_ptr<audio_packet>& packet)
+void playback_controller::on_decoding_error(qint64 session_id, const QString& error_message)
 {
-    if (session_id != current_session_id_ || player_ == nullptr)
+    if (session_id != 0 && session_id == next_track_.session_id)
     {
+        LOG_WARN("无缝播放 预加载下一首失败 {}", error_message.toStdString());
+        cancel_preload();
         return;
     }
-
-    if (packet)
-    {
-        LOG_TRACE("控制器->播放器 入队数据包 ms {} size {}", packet->ms, packet->data.size());
-    }
-    else
-    {
-        LOG_INFO("结束流程二 从解码器收到文件结束信号转发至播放器");
-    }
-
-    QMetaObject::invokeMethod(
-        player_, "enqueue_packet", Qt::QueuedConnection, Q_ARG(qint64, session_id), Q_ARG(std::shared_ptr<audio_packet>, packet));
-}
-
-void playback_controller::on_packet_for_spectrum(const std::shared_ptr<audio_packet>& packet)
-{
-    if (spectrum_widget_ != nullptr && is_playing_)
-    {
-        spectrum_widget_->enqueue_packet(packet);
-    }
-}
-
-void playback_controller::on_buffer_level_low(qint64 session_id)
-{
-    if (session_id != current_session_id_ || !is_playing_ || is_seeking_)
+    if (session_id != current_session_id_)
     {
         return;
     }
-    LOG_TRACE("缓冲区事件 触发低水位线请求解码器继续解码");
-    QMetaObject::invokeMethod(decoder_, "resume_decoding", Qt::QueuedConnection);
+    LOG_ERROR("收到解码器错误 {}", error_message.toStdString());
+    emit playback_error(error_message);
+    stop();
 }
 
-void playback_controller::on_buffer_level_high(qint64 session_id)
+qint64 playback_controller::current_position_ms() const
 {
-    if (session_id != current_session_id_ || !is_playing_ || is_seeking_)
+    if (!is_playing_)
     {
-        return;
+        return -1;
     }
-    LOG_TRACE("缓冲区事件 触发高水位线 请求解码器暂停解码");
-    QMetaObject::invokeMethod(decoder_, "pause_decoding", Qt::QueuedConnection);
-}
 
-void playback_controller::on_progress_update(qint64 session_id, qint64 current_ms)
-{
-    if (session_id != current_session_id_ || !is_playing_)
+    const playback_clock::reading reading = clock_->read();
+    if (reading.session_id != current_session_id_ || reading.position_us < 0)
     {
-        return;
+        return -1;
     }
-    emit progress_updated(current_ms, total_duration_ms_);
+    return total_duration_ms_ > 0 ? qMin(reading.position_ms(), total_duration_ms_) : reading.position_ms();
 }
 
 void playback_controller::on_playback_completed(qint64 session_id)
@@ -361,6 +724,7 @@ void playback_controller::on_decoder_seek_finished(qint64 session_id, qint64 act
     {
         LOG_INFO("跳转结果已在文件末尾转换到结束状态");
         is_seeking_ = false;
+        cancel_preload();
         if (player_ != nullptr)
         {
             QMetaObject::invokeMethod(player_, "handle_seek", Qt::QueuedConnection, Q_ARG(qint64, session_id), Q_ARG(qint64, actual_seek_ms));
@@ -394,8 +758,11 @@ void playback_controller::on_player_seek_handled(qint64 session_id)
 
     if (spectrum_widget_ != nullptr)
     {
-        QMetaObject::invokeMethod(
-            spectrum_widget_, "reset_and_start", Qt::QueuedConnection, Q_ARG(qint64, session_id), Q_ARG(qint64, seek_result_ms_));
+        QMetaObject::invokeMethod(spectrum_widget_,
+                                  "reset_and_start",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(qint64, session_id),
+                                  Q_ARG(std::shared_ptr<pcm_ring>, current_ring_));
     }
     else
     {
@@ -416,6 +783,11 @@ void playback_controller::on_player_seek_handled(qint64 session_id)
 }
 void playback_controller::on_metadata_ready(qint64 session_id, const QMap<QString, QString>& metadata)
 {
+    if (session_id != 0 && session_id == next_track_.session_id)
+    {
+        next_track_.metadata = metadata;
+        return;
+    }
     if (session_id != current_session_id_)
     {
         return;
@@ -426,6 +798,11 @@ void playback_controller::on_metadata_ready(qint64 session_id, const QMap<QStrin
 
 void playback_controller::on_cover_art_ready(qint64 session_id, const QByteArray& image_data)
 {
+    if (session_id != 0 && session_id == next_track_.session_id)
+    {
+        next_track_.cover_art = image_data;
+        return;
+    }
     if (session_id != current_session_id_)
     {
         return;
@@ -436,6 +813,11 @@ void playback_controller::on_cover_art_ready(qint64 session_id, const QByteArray
 
 void playback_controller::on_lyrics_ready(qint64 session_id, const QList<LyricLine>& lyrics)
 {
+    if (session_id != 0 && session_id == next_track_.session_id)
+    {
+        next_track_.lyrics = lyrics;
+        return;
+    }
     if (session_id != current_session_id_)
     {
         return;
@@ -454,9 +836,8 @@ void playback_controller::cleanup_player()
         }
         player_thread_->quit();
         player_thread_->wait();
-        player_thread_->deleteLater();
         player_thread_ = nullptr;
         player_ = nullptr;
-        LOG_DEBUG("播放器和播放器线程已清理");
+        LOG_DEBUG("输出引擎和播放器线程已清理");
     }
 }
@@ -2,12 +2,18 @@
 #define PLAYBACK_CONTROLLER_H
 
 #include <QObject>
+#include <QTimer>
 #include <QAudioFormat>
 #include <atomic>
 #include <memory>
 #include <QMap>
 #include <QByteArray>
 #include <QList>
+#include <QStringList>
+#include "pcm_ring.h"
+#include "primed_cache.h"
+#include "scrub_preview.h"
+#include "playback_clock.h"
 #include "audio_packet.h"
 #include "player_window.h"
 
@@ -17,6 +23,20 @@ class audio_player;
 class spectrum_widget;
 struct audio_packet;
 
+struct preloaded_track
+{
+    qint64 session_id = 0;
+    qint64 owner_session_id = 0;
+    QString file_path;
+    std::shared_ptr<pcm_ring> ring;
+    QAudioFormat format;
+    qint64 duration_ms = 0;
+    bool queued = false;
+    QMap<QString, QString> metadata;
+    QByteArray cover_art;
+    QList<LyricLine> lyrics;
+};
+
 class playback_controller : public QObject
 {
     Q_OBJECT
@@ -27,6 +47,8 @@ class playback_controller : public QObject
 
     void set_spectrum_widget(spectrum_widget* widget);
     bool is_media_loaded() const { return is_media_loaded_; }
+    [[nodiscard]] qint64 current_position_ms() const;
+    [[nodiscard]] qint64 total_duration_ms() const { return total_duration_ms_; }
 
    public slots:
     void play_file(const QString& file_path, qint64 start_position_ms = 0);
@@ -35,14 +57,20 @@ class playback_controller : public QObject
     void pause_resume();
     void set_volume(int volume_percent);
     void set_playback_mode(playback_mode mode);
+    void prepare_next(const QString& file_path);
+    void prefetch(const QStringList& file_paths);
+    void prime(const QStringList& file_paths);
+    void begin_scrub();
+    void scrub_to(qint64 position_ms);
+    void end_scrub();
 
    signals:
     void track_info_ready(qint64 duration_ms);
-    void progress_updated(qint64 current_ms, qint64 total_ms);
     void playback_finished();
     void playback_error(const QString& error_message);
     void seek_finished(bool success);
     void playback_started(const QString& file_path, const QString& file_name);
+    void gapless_track_started(const QString& file_path);
     void seek_completed(qint64 actual_ms);
     void metadata_ready(const QMap<QString, QString>& metadata);
     void cover_art_ready(const QByteArray& image_data);
@@ -51,30 +79,53 @@ class playback_controller : public QObject
 
    private slots:
     void on_duration_ready(qint64 session_id, qint64 duration_ms, const QAudioFormat& format);
-    void on_packet_from_decoder(qint64 session_id, const std::shared_ptr<audio_packet>& packet);
     void on_decoder_seek_finished(qint64 session_id, qint64 actual_seek_ms);
-    void on_decoding_error(const QString& error_message);
+    void on_decoding_error(qint64 session_id, const QString& error_message);
     void on_player_ready_for_spectrum(qint64 session_id);
     void on_player_seek_handled(qint64 session_id);
     void on_spectrum_ready_for_decoding(qint64 session_id);
     void on_player_error(const QString& error_message);
-    void on_progress_update(qint64 session_id, qint64 current_ms);
     void on_playback_completed(qint64 session_id);
-    void on_packet_for_spectrum(const std::shared_ptr<audio_packet>& packet);
-    void on_buffer_level_low(qint64 session_id);
-    void on_buffer_level_high(qint64 session_id);
+    void on_player_track_switched(qint64 from_session_id, qint64 session_id);
     void on_metadata_ready(qint64 session_id, const QMap<QString, QString>& metadata);
     void on_cover_art_ready(qint64 session_id, const QByteArray& image_data);
     void on_lyrics_ready(qint64 session_id, const QList<LyricLine>& lyrics);
+    void on_primer_duration_ready(qint64 session_id, qint64 duration_ms, const QAudioFormat& format);
+    void on_primer_error(qint64 session_id, const QString& error_message);
+    void on_primer_tick();
 
    private:
     void cleanup_player();
+    audio_decoder* create_decoder(QThread* thread);
+    void on_next_track_ready(qint64 duration_ms, const QAudioFormat& format);
+    void cancel_preload();
+    bool start_from_primed(const QString& file_path);
+    void start_next_prime();
+    void finish_prime(bool store);
 
     QThread* decoder_thread_ = nullptr;
     audio_decoder* decoder_ = nullptr;
+    QThread* next_decoder_thread_ = nullptr;
+    audio_decoder* next_decoder_ = nullptr;
+    preloaded_track next_track_;
+    QThread* primer_thread_ = nullptr;
+    audio_decoder* primer_decoder_ = nullptr;
+    QTimer* primer_timer_ = nullptr;
+    QStringList primer_queue_;
+    qint64 primer_session_id_ = 0;
+    std::shared_ptr<pcm_ring> primer_ring_;
+    std::shared_ptr<primed_cache::entry> primer_entry_;
+    primed_cache primed_cache_;
+    QAudioFormat current_format_;
+    QString current_file_path_;
+    std::unique_ptr<scrub_preview> scrub_preview_;
+    bool scrub_enabled_ = true;
+    bool is_scrubbing_ = false;
     QThread* player_thread_ = nullptr;
     audio_player* player_ = nullptr;
+    std::shared_ptr<playback_clock> clock_;
     spectrum_widget* spectrum_widget_ = nullptr;
+    std::shared_ptr<pcm_ring> current_ring_;
 
     bool is_playing_ = false;
     bool is_media_loaded_ = false;
@@ -82,13 +133,13 @@ class playback_controller : public QObject
     std::atomic<qint64> session_id_counter_{0};
     qint64 current_session_id_ = 0;
     bool is_paused_ = false;
-    std::atomic<qint64> buffered_bytes_{0};
     bool is_seeking_ = false;
     qint64 pending_seek_ms_ = -1;
     qint64 seek_result_ms_ = -1;
     qint64 playback_start_position_ms_ = 0;
     playback_mode current_mode_ = playback_mode::ListLoop;
     int cached_volume_ = 80;
+    qint64 play_request_time_ns_ = 0;
 };
 
 #endif
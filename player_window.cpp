@@ -1,6 +1,5 @@
 #include <QHBoxLayout>
 #include <QVBoxLayout>
-#include <QSlider>
 #include <QPushButton>
 #include <QLabel>
 #include <QTime>
@@ -10,8 +9,11 @@
 #include <QFontMetrics>
 #include <QEvent>
 #include <QColor>
+#include <QTimer>
 
 #include "volumemeter.h"
+#include "waveform_slider.h"
+#include "waveform_loader.h"
 #include "player_window.h"
 #include "playlist_window.h"
 #include "spectrum_widget.h"
@@ -19,9 +21,16 @@
 #include "scrolling_text_label.h"
 #include "playback_controller.h"
 
+constexpr int kClockTickIntervalMs = 16;
+
 player_window::player_window(playback_controller* controller, playlist_window* main_wnd)
     : QWidget(main_wnd), controller_(controller)
 {
+    clock_timer_ = new QTimer(this);
+    clock_timer_->setInterval(kClockTickIntervalMs);
+    connect(clock_timer_, &QTimer::timeout, this, &player_window::on_clock_tick);
+    waveform_loader_ = new waveform_loader(this);
+
     setup_ui();
     setup_connections();
     setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
@@ -60,6 +69,9 @@ void player_window::restore_idle_state(const QString& title, qint64 position_ms)
     set_track_title(title);
 
     const qint64 safe_position_ms = qMax<qint64>(0, position_ms);
+    waveform_loader_->cancel();
+    waveform_path_.clear();
+    progress_slider_->clear_waveform();
     progress_slider_->setRange(0, 100);
     progress_slider_->setValue(0);
 
@@ -120,11 +132,11 @@ void player_window::setup_ui()
     title_layout->setStretch(0, 1);
     title_layout->setStretch(1, 0);
 
-    progress_slider_ = new QSlider(Qt::Horizontal);
+    progress_slider_ = new waveform_slider(Qt::Horizontal);
     progress_slider_->setObjectName("progressSlider");
     progress_slider_->setRange(0, 100);
     progress_slider_->setValue(0);
-    progress_slider_->setFixedHeight(8);
+    progress_slider_->setFixedHeight(16);
 
     auto* progress_layout = new QHBoxLayout();
     progress_layout->setContentsMargins(0, 0, 0, 0);
@@ -183,7 +195,37 @@ void player_window::setup_ui()
 void player_window::setup_connections()
 {
     connect(progress_slider_, &QSlider::sliderReleased, this, &player_window::on_seek_requested);
-    connect(progress_slider_, &QSlider::sliderPressed, this, [this] { is_slider_pressed_ = true; });
+    connect(progress_slider_,
+            &QSlider::sliderPressed,
+            this,
+            [this]
+            {
+                is_slider_pressed_ = true;
+                if (controller_ != nullptr)
+                {
+                    controller_->begin_scrub();
+                }
+            });
+    connect(progress_slider_,
+            &QSlider::sliderMoved,
+            this,
+            [this](int position)
+            {
+                if (controller_ != nullptr)
+                {
+                    controller_->scrub_to(position);
+                }
+            });
+    connect(waveform_loader_,
+            &waveform_loader::waveform_ready,
+            this,
+            [this](const QString& file_path, std::shared_ptr<const waveform_pyramid> pyramid)
+            {
+                if (file_path == waveform_path_)
+                {
+                    progress_slider_->set_waveform(std::move(pyramid));
+                }
+            });
 
     connect(play_pause_button_, &QPushButton::clicked, this, &player_window::on_play_pause_clicked);
     connect(next_button_, &QPushButton::clicked, this, &player_window::on_next_clicked);
@@ -199,7 +241,6 @@ void player_window::setup_connections()
         controller_->set_spectrum_widget(spectrum_widget_);
         connect(controller_, &playback_controller::track_info_ready, this, &player_window::update_track_info);
         connect(controller_, &playback_controller::playback_started, this, &player_window::on_playback_started);
-        connect(controller_, &playback_controller::progress_updated, this, &player_window::update_progress);
         connect(controller_, &playback_controller::playback_error, this, &player_window::handle_playback_error);
         connect(controller_, &playback_controller::metadata_ready, this, &player_window::on_metadata_updated);
         connect(controller_, &playback_controller::cover_art_ready, this, &player_window::on_cover_art_updated);
@@ -213,10 +254,15 @@ void player_window::setup_connections()
 
 void player_window::reset_ui()
 {
+    clock_timer_->stop();
+    last_clock_ms_ = -1;
     is_paused_ = false;
     play_pause_button_->setIcon(QIcon(":/icons/play.svg"));
     set_track_title("欢迎使用");
     set_time_text("00:00");
+    waveform_loader_->cancel();
+    waveform_path_.clear();
+    progress_slider_->clear_waveform();
     progress_slider_->setRange(0, 100);
     progress_slider_->setValue(0);
     lyrics_.clear();
@@ -269,12 +315,30 @@ void player_window::on_volume_changed(int value)
 
 void player_window::on_playback_started(const QString& file_path, const QString& file_name)
 {
-    (void)file_path;
     reset_ui();
+    waveform_path_ = file_path;
+    waveform_loader_->request(file_path);
     is_paused_ = false;
     play_pause_button_->setIcon(QIcon(":/icons/pause.svg"));
     set_track_title(file_name);
     setWindowTitle(file_name);
+    clock_timer_->start();
+}
+
+void player_window::on_clock_tick()
+{
+    if (controller_ == nullptr)
+    {
+        return;
+    }
+
+    const qint64 current_ms = controller_->current_position_ms();
+    if (current_ms < 0 || current_ms == last_clock_ms_)
+    {
+        return;
+    }
+    last_clock_ms_ = current_ms;
+    update_progress(current_ms, controller_->total_duration_ms());
 }
 
 void player_window::on_cover_art_updated(const QByteArray& image_data) { (void)image_data; }
@@ -468,6 +532,10 @@ void player_window::update_spectrum_background_geometry()
 void player_window::on_seek_requested()
 {
     is_slider_pressed_ = false;
+    if (controller_ != nullptr)
+    {
+        controller_->end_scrub();
+    }
     if (controller_ != nullptr && controller_->is_media_loaded())
     {
         controller_->seek(progress_slider_->value());
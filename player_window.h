@@ -8,11 +8,13 @@
 #include "audio_packet.h"
 
 class QVBoxLayout;
-class QSlider;
 class QLabel;
 class QPushButton;
 class QEvent;
+class QTimer;
 class volume_meter;
+class waveform_slider;
+class waveform_loader;
 class spectrum_widget;
 class scrolling_text_label;
 class playback_controller;
@@ -68,6 +70,7 @@ class player_window : public QWidget
     void on_stop_clicked();
     void on_volume_changed(int value);
     void on_playback_mode_clicked();
+    void on_clock_tick();
 
    private:
     void setup_ui();
@@ -88,7 +91,9 @@ class player_window : public QWidget
 
     QVBoxLayout* left_panel_layout_ = nullptr;
 
-    QSlider* progress_slider_ = nullptr;
+    waveform_slider* progress_slider_ = nullptr;
+    waveform_loader* waveform_loader_ = nullptr;
+    QString waveform_path_;
     volume_meter* volume_meter_ = nullptr;
     spectrum_widget* spectrum_widget_ = nullptr;
 
@@ -105,6 +110,9 @@ class player_window : public QWidget
     bool is_paused_ = false;
     bool is_slider_pressed_ = false;
 
+    QTimer* clock_timer_ = nullptr;
+    qint64 last_clock_ms_ = -1;
+
     QList<LyricLine> lyrics_;
     QString current_lyric_status_;
 
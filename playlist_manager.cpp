@@ -5,11 +5,29 @@
 #include <QCollator>
 #include <QStandardPaths>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QtConcurrent>
 #include "log.h"
 #include "playlist_manager.h"
 #include "database_manager.h"
+#include "loudness_analyzer.h"
 
-playlist_manager::playlist_manager(QObject* parent) : QObject(parent) { db_manager_ = new database_manager(this); }
+static QHash<QString, media_probe::result> zip_probes(const QStringList& paths, const QList<media_probe::result>& results)
+{
+    QHash<QString, media_probe::result> probes;
+    for (qsizetype i = 0; i < paths.size() && i < results.size(); ++i)
+    {
+        probes.insert(paths[i], results[i]);
+    }
+    return probes;
+}
+
+playlist_manager::playlist_manager(QObject* parent) : QObject(parent)
+{
+    db_manager_ = new database_manager(this);
+    loudness_analyzer_ = new loudness_analyzer(this);
+}
 
 playlist_manager::~playlist_manager() = default;
 
@@ -21,6 +39,7 @@ void playlist_manager::initialize_and_load()
         return;
     }
     perform_migration();
+    loudness_analyzer_->start();
 }
 
 void playlist_manager::perform_migration()
@@ -65,7 +84,9 @@ void playlist_manager::perform_migration()
                 {
                     paths.append(song.file_path);
                 }
-                db_manager_->add_songs_to_playlist(new_db_playlist.id, paths);
+                const QStringList unknown = db_manager_->unknown_song_paths(paths);
+                const QList<media_probe::result> results = QtConcurrent::blockingMapped(unknown, &media_probe::probe);
+                db_manager_->add_songs_to_playlist(new_db_playlist.id, paths, zip_probes(unknown, results));
             }
         }
         current_playlist = Playlist();
@@ -138,8 +159,33 @@ void playlist_manager::delete_playlist(qint64 id)
 void playlist_manager::add_songs_to_playlist(qint64 playlist_id, const QStringList& file_paths)
 {
     LOG_INFO("向播放列表id {} 添加 {} 首歌曲", playlist_id, file_paths.count());
-    db_manager_->add_songs_to_playlist(playlist_id, file_paths);
+    const QStringList unknown = db_manager_->unknown_song_paths(file_paths);
+    if (unknown.isEmpty())
+    {
+        store_songs(playlist_id, file_paths, {});
+        return;
+    }
+
+    auto* watcher = new QFutureWatcher<media_probe::result>(this);
+    QElapsedTimer timer;
+    timer.start();
+    connect(watcher,
+            &QFutureWatcherBase::finished,
+            this,
+            [this, watcher, timer, playlist_id, file_paths, unknown]()
+            {
+                watcher->deleteLater();
+                LOG_INFO("后台并行探测 {} 个新文件 耗时 {} ms", unknown.count(), timer.elapsed());
+                store_songs(playlist_id, file_paths, zip_probes(unknown, watcher->future().results()));
+            });
+    watcher->setFuture(QtConcurrent::mapped(unknown, &media_probe::probe));
+}
+
+void playlist_manager::store_songs(qint64 playlist_id, const QStringList& file_paths, const QHash<QString, media_probe::result>& probes)
+{
+    db_manager_->add_songs_to_playlist(playlist_id, file_paths, probes);
     emit songs_changed_in_playlist(playlist_id);
+    loudness_analyzer_->start();
 }
 
 void playlist_manager::remove_songs_from_playlist(qint64 playlist_id, const QList<int>& song_indices)
@@ -3,9 +3,12 @@
 
 #include <QObject>
 #include <QMap>
+#include <QHash>
+#include "media_probe.h"
 #include "playlist_data.h"
 
 class database_manager;
+class loudness_analyzer;
 
 class playlist_manager : public QObject
 {
@@ -38,7 +41,9 @@ class playlist_manager : public QObject
 
    private:
     void perform_migration();
+    void store_songs(qint64 playlist_id, const QStringList& file_paths, const QHash<QString, media_probe::result>& probes);
     database_manager* db_manager_ = nullptr;
+    loudness_analyzer* loudness_analyzer_ = nullptr;
 };
 
 #endif
@@ -32,6 +32,8 @@
 #include "playback_controller.h"
 #include "music_management_dialog.h"
 
+constexpr int kPrefetchTrackCount = 3;
+
 static QTreeWidgetItem* find_item_by_id(QTreeWidget* tree, qint64 id)
 {
     if (tree == nullptr || id == -1)
@@ -275,16 +277,9 @@ void playlist_window::setup_connections()
     connect(playlist_manager_, &playlist_manager::songs_changed_in_playlist, this, &playlist_window::on_songs_changed);
 
     connect(controller_, &playback_controller::playback_started, this, &playlist_window::on_playback_started);
+    connect(controller_, &playback_controller::gapless_track_started, this, &playlist_window::on_gapless_track_started);
     connect(controller_, &playback_controller::playback_finished, this, &playlist_window::handle_playback_finished);
     connect(controller_, &playback_controller::playback_error, this, &playlist_window::handle_playback_error_strategy);
-    connect(controller_,
-            &playback_controller::progress_updated,
-            this,
-            [this](qint64 current_ms, qint64 total_ms)
-            {
-                (void)total_ms;
-                current_progress_ms_ = current_ms;
-            });
 
     connect(player_window_, &player_window::next_requested, this, &playlist_window::on_next_requested);
     connect(player_window_, &player_window::previous_requested, this, &playlist_window::on_previous_requested);
@@ -352,6 +347,7 @@ void playlist_window::on_playback_mode_changed(playback_mode new_mode)
         current_shuffle_index_ = -1;
     }
     save_playback_state();
+    prepare_next_track();
 }
 
 void playlist_window::on_stop_requested()
@@ -372,13 +368,13 @@ void playlist_window::on_play_requested()
 {
     if (restored_song_item_ != nullptr)
     {
-        play_song_item(restored_song_item_, true, current_progress_ms_);
+        play_song_item(restored_song_item_, true, playback_position_ms());
         return;
     }
 
     if (currently_playing_item_ != nullptr)
     {
-        play_song_item(currently_playing_item_, true, current_progress_ms_);
+        play_song_item(currently_playing_item_, true, playback_position_ms());
         return;
     }
 
@@ -416,6 +412,159 @@ void playlist_window::on_playback_started(const QString& file_path, const QStrin
         song_tree_widget_->scrollToItem(currently_playing_item_, QAbstractItemView::PositionAtCenter);
         save_playback_state();
     }
+
+    prepare_next_track();
+}
+
+void playlist_window::on_gapless_track_started(const QString& file_path)
+{
+    QTreeWidgetItem* item = peek_next_song_item();
+    if (item == nullptr || song_item_path(item) != file_path)
+    {
+        item = find_song_item_by_path(file_path);
+    }
+    if (item == nullptr)
+    {
+        LOG_WARN("无缝播放 列表中找不到已切换的歌曲 {}", file_path.toStdString());
+        return;
+    }
+
+    if (current_mode_ == playback_mode::Shuffle && currently_playing_item_ != nullptr && item != currently_playing_item_)
+    {
+        current_shuffle_index_++;
+    }
+
+    current_playing_file_path_ = file_path;
+    clicked_song_item_ = item;
+    restored_song_item_ = nullptr;
+    current_progress_ms_ = 0;
+    pending_restore_seek_ms_ = -1;
+    playlist_manager_->increment_play_count(current_playing_file_path_);
+}
+
+QTreeWidgetItem* playlist_window::peek_next_song_item() const
+{
+    if (currently_playing_item_ == nullptr || currently_playing_item_->parent() == nullptr)
+    {
+        return nullptr;
+    }
+
+    QTreeWidgetItem* playlist_item = currently_playing_item_->parent();
+    const int current_index = playlist_item->indexOfChild(currently_playing_item_);
+    const int song_count = playlist_item->childCount();
+
+    switch (current_mode_)
+    {
+        case playback_mode::SingleLoop:
+            return currently_playing_item_;
+
+        case playback_mode::Shuffle:
+            if (current_shuffle_index_ >= 0 && current_shuffle_index_ + 1 < shuffled_indices_.size())
+            {
+                return playlist_item->child(shuffled_indices_.at(current_shuffle_index_ + 1));
+            }
+            return nullptr;
+
+        case playback_mode::ListLoop:
+            return playlist_item->child((current_index + 1) % song_count);
+
+        case playback_mode::Sequential:
+            return current_index + 1 < song_count ? playlist_item->child(current_index + 1) : nullptr;
+    }
+    return nullptr;
+}
+
+QStringList playlist_window::upcoming_song_paths(int count) const
+{
+    QStringList paths;
+    if (currently_playing_item_ == nullptr || currently_playing_item_->parent() == nullptr)
+    {
+        return paths;
+    }
+
+    QTreeWidgetItem* playlist_item = currently_playing_item_->parent();
+    const int current_index = playlist_item->indexOfChild(currently_playing_item_);
+    const int song_count = playlist_item->childCount();
+
+    for (int i = 1; i <= count; ++i)
+    {
+        QTreeWidgetItem* item = nullptr;
+        switch (current_mode_)
+        {
+            case playback_mode::SingleLoop:
+                break;
+            case playback_mode::Shuffle:
+                if (current_shuffle_index_ >= 0 && current_shuffle_index_ + i < shuffled_indices_.size())
+                {
+                    item = playlist_item->child(shuffled_indices_.at(current_shuffle_index_ + i));
+                }
+                break;
+            case playback_mode::ListLoop:
+                item = playlist_item->child((current_index + i) % song_count);
+                break;
+            case playback_mode::Sequential:
+                item = current_index + i < song_count ? playlist_item->child(current_index + i) : nullptr;
+                break;
+        }
+        if (item == nullptr || item == currently_playing_item_)
+        {
+            break;
+        }
+        paths << song_item_path(item);
+    }
+    return paths;
+}
+
+QTreeWidgetItem* playlist_window::peek_skip_song_item(int direction) const
+{
+    if (currently_playing_item_ == nullptr || currently_playing_item_->parent() == nullptr)
+    {
+        return nullptr;
+    }
+
+    QTreeWidgetItem* playlist_item = currently_playing_item_->parent();
+    const int song_count = playlist_item->childCount();
+    if (current_mode_ == playback_mode::Shuffle)
+    {
+        const auto shuffle_count = static_cast<int>(shuffled_indices_.size());
+        const int index = current_shuffle_index_ + direction;
+        if (shuffle_count == 0 || index >= shuffle_count)
+        {
+            return nullptr;
+        }
+        return playlist_item->child(shuffled_indices_.at(index < 0 ? shuffle_count - 1 : index));
+    }
+
+    const int index = playlist_item->indexOfChild(currently_playing_item_) + direction;
+    if (index >= 0 && index < song_count)
+    {
+        return playlist_item->child(index);
+    }
+    if (current_mode_ == playback_mode::ListLoop && song_count > 0)
+    {
+        return playlist_item->child((index + song_count) % song_count);
+    }
+    return nullptr;
+}
+
+void playlist_window::prepare_next_track()
+{
+    if (currently_playing_item_ == nullptr)
+    {
+        return;
+    }
+    controller_->prepare_next(song_item_path(peek_next_song_item()));
+    controller_->prefetch(upcoming_song_paths(kPrefetchTrackCount));
+
+    QStringList neighbours;
+    for (QTreeWidgetItem* item : {peek_skip_song_item(1), peek_skip_song_item(-1)})
+    {
+        if (item != nullptr && item != currently_playing_item_)
+        {
+            neighbours << song_item_path(item);
+        }
+    }
+    controller_->prime(neighbours);
 }
 
 void playlist_window::handle_playback_error_strategy(const QString& error_message)
@@ -506,6 +655,12 @@ void playlist_window::restore_playback_state()
     save_playback_state();
 }
 
+qint64 playlist_window::playback_position_ms() const
+{
+    const qint64 live_ms = controller_->current_position_ms();
+    return live_ms >= 0 ? live_ms : current_progress_ms_;
+}
+
 void playlist_window::save_playback_state() const
 {
     QSettings settings("MusicPlayer", "MusicPlayer");
@@ -519,7 +674,7 @@ void playlist_window::save_playback_state() const
     }
 
     settings.setValue("playback/filePath", current_playing_file_path_);
-    settings.setValue("playback/positionMs", current_progress_ms_);
+    settings.setValue("playback/positionMs", playback_position_ms());
 }
 
 void playlist_window::clear_saved_playback_state() const
@@ -5,6 +5,7 @@
 #include <QList>
 #include <QMap>
 #include <QPoint>
+#include <QStringList>
 
 #include "playlist_data.h"
 #include "player_window.h"
@@ -49,6 +50,7 @@ class playlist_window : public QMainWindow
 
     void handle_playback_finished();
     void on_playback_started(const QString& file_path, const QString& file_name);
+    void on_gapless_track_started(const QString& file_path);
 
     void on_next_requested();
     void on_previous_requested();
@@ -72,12 +74,17 @@ class playlist_window : public QMainWindow
     void populate_playlists_on_startup();
     void restore_playback_state();
     void save_playback_state() const;
+    [[nodiscard]] qint64 playback_position_ms() const;
     void clear_saved_playback_state() const;
     void generate_shuffled_list(QTreeWidgetItem* playlist_item, int start_song_index = -1);
     QTreeWidgetItem* find_song_item_by_path(const QString& file_path) const;
     void mark_restored_song_item(QTreeWidgetItem* item);
     void play_song_item(QTreeWidgetItem* item, bool increment_play_count, qint64 restore_position_ms = -1);
     void play_first_song_in_list();
+    [[nodiscard]] QTreeWidgetItem* peek_next_song_item() const;
+    [[nodiscard]] QStringList upcoming_song_paths(int count) const;
+    [[nodiscard]] QTreeWidgetItem* peek_skip_song_item(int direction) const;
+    void prepare_next_track();
 
    private:
     playback_controller* controller_ = nullptr;
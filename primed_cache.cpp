@@ -0,0 +1,80 @@
+#include <algorithm>
+#include "log.h"
+#include "primed_cache.h"
+
+void primed_cache::set_budget(qint64 bytes)
+{
+    stats_.budget = std::max<qint64>(0, bytes);
+    evict_to(stats_.budget);
+}
+
+void primed_cache::insert(const std::shared_ptr<const entry>& e)
+{
+    if (!e || e->pcm.size() > stats_.budget)
+    {
+        return;
+    }
+    entries_.remove_if(
+        [&](const std::shared_ptr<const entry>& existing)
+        {
+            if (existing->file_path != e->file_path)
+            {
+                return false;
+            }
+            stats_.bytes -= existing->pcm.size();
+            return true;
+        });
+    evict_to(stats_.budget - e->pcm.size());
+    entries_.push_front(e);
+    stats_.bytes += e->pcm.size();
+}
+
+std::shared_ptr<const primed_cache::entry> primed_cache::find(const QString& file_path)
+{
+    auto it = std::find_if(entries_.begin(), entries_.end(), [&](const std::shared_ptr<const entry>& e) { return e->file_path == file_path; });
+    if (it != entries_.end())
+    {
+        const media_cache::file_stamp stamp = media_cache::stamp_of(file_path);
+        if (!stamp.valid() || stamp.size != (*it)->stamp.size || stamp.mtime_ms != (*it)->stamp.mtime_ms)
+        {
+            LOG_INFO("预解码缓存 文件已变化 丢弃缓存 {}", file_path.toStdString());
+            stats_.bytes -= (*it)->pcm.size();
+            stats_.evictions++;
+            entries_.erase(it);
+            it = entries_.end();
+        }
+    }
+    if (it == entries_.end())
+    {
+        stats_.misses++;
+        LOG_DEBUG("预解码缓存 未命中 命中 {} 未命中 {} 淘汰 {}", stats_.hits, stats_.misses, stats_.evictions);
+        return nullptr;
+    }
+    stats_.hits++;
+    entries_.splice(entries_.begin(), entries_, it);
+    LOG_INFO("预解码缓存 命中 {}ms 命中 {} 未命中 {} 淘汰 {} 占用 {}/{} 字节",
+             entries_.front()->primed_ms,
+             stats_.hits,
+             stats_.misses,
+             stats_.evictions,
+             stats_.bytes,
+             stats_.budget);
+    return entries_.front();
+}
+
+bool primed_cache::contains(const QString& file_path) const
+{
+    return std::any_of(entries_.begin(), entries_.end(), [&](const std::shared_ptr<const entry>& e) { return e->file_path == file_path; });
+}
+
+primed_cache::stats primed_cache::snapshot() const { return stats_; }
+
+void primed_cache::evict_to(qint64 budget)
+{
+    while (!entries_.empty() && stats_.bytes > budget)
+    {
+        stats_.bytes -= entries_.back()->pcm.size();
+        stats_.evictions++;
+        entries_.pop_back();
+    }
+}
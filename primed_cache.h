@@ -0,0 +1,50 @@
+#ifndef PRIMED_CACHE_H
+#define PRIMED_CACHE_H
+
+#include <list>
+#include <memory>
+#include <QAudioFormat>
+#include <QByteArray>
+#include <QString>
+#include "media_cache.h"
+#include "spectrum_timeline.h"
+
+class primed_cache
+{
+   public:
+    struct entry
+    {
+        QString file_path;
+        media_cache::file_stamp stamp;
+        QAudioFormat format;
+        qint64 total_duration_ms = 0;
+        qint64 primed_ms = 0;
+        float replay_gain = 1.0F;
+        QByteArray pcm;
+        spectrum_timeline::frames spectrum;
+    };
+
+    struct stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        qint64 bytes = 0;
+        qint64 budget = 0;
+    };
+
+    void set_budget(qint64 bytes);
+    void insert(const std::shared_ptr<const entry>& e);
+    std::shared_ptr<const entry> find(const QString& file_path);
+    [[nodiscard]] bool contains(const QString& file_path) const;
+    [[nodiscard]] stats snapshot() const;
+
+   private:
+    void evict_to(qint64 budget);
+
+   private:
+    std::list<std::shared_ptr<const entry>> entries_;
+    stats stats_;
+};
+
+#endif
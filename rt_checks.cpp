@@ -0,0 +1,94 @@
+#include "rt_checks.h"
+
+#ifdef MUSICPLAYER_RT_CHECKS
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <unistd.h>
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void __libc_free(void* ptr);
+
+namespace
+{
+
+thread_local bool in_realtime_section = false;
+
+[[noreturn]] void rt_violation(const char* what)
+{
+    in_realtime_section = false;
+    constexpr char kPrefix[] = "实时检查 音频回调内禁止调用 ";
+    ssize_t ignored = write(STDERR_FILENO, kPrefix, sizeof(kPrefix) - 1);
+    ignored = write(STDERR_FILENO, what, strlen(what));
+    ignored = write(STDERR_FILENO, "\n", 1);
+    (void)ignored;
+    abort();
+}
+
+}  // namespace
+
+rt_scope::rt_scope() { in_realtime_section = true; }
+
+rt_scope::~rt_scope() { in_realtime_section = false; }
+
+extern "C" void* malloc(size_t size)
+{
+    if (in_realtime_section)
+    {
+        rt_violation("malloc");
+    }
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    if (in_realtime_section)
+    {
+        rt_violation("calloc");
+    }
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+    if (in_realtime_section)
+    {
+        rt_violation("realloc");
+    }
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void* ptr)
+{
+    if (ptr != nullptr && in_realtime_section)
+    {
+        rt_violation("free");
+    }
+    __libc_free(ptr);
+}
+
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+    using lock_fn = int (*)(pthread_mutex_t*);
+    static std::atomic<lock_fn> real_lock{nullptr};
+
+    if (in_realtime_section)
+    {
+        rt_violation("pthread_mutex_lock");
+    }
+
+    lock_fn fn = real_lock.load(std::memory_order_acquire);
+    if (fn == nullptr)
+    {
+        fn = reinterpret_cast<lock_fn>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+        real_lock.store(fn, std::memory_order_release);
+    }
+    return fn(mutex);
+}
+
+#endif
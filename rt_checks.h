@@ -0,0 +1,24 @@
+#ifndef RT_CHECKS_H
+#define RT_CHECKS_H
+
+#ifdef MUSICPLAYER_RT_CHECKS
+
+class rt_scope
+{
+   public:
+    rt_scope();
+    ~rt_scope();
+
+    rt_scope(const rt_scope&) = delete;
+    rt_scope& operator=(const rt_scope&) = delete;
+};
+
+#define RT_SCOPE() rt_scope rt_scope_guard
+
+#else
+
+#define RT_SCOPE() ((void)0)
+
+#endif
+
+#endif
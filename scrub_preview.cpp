@@ -0,0 +1,396 @@
+#include <chrono>
+#include <algorithm>
+#include "log.h"
+#include "scoped_exit.h"
+#include "media_cache.h"
+#include "stream_params.h"
+#include "playback_clock.h"
+#include "audio_packet_pool.h"
+#include "scrub_preview.h"
+
+extern "C"
+{
+#include <libavutil/channel_layout.h>
+}
+
+constexpr qint64 kGrainMs = 40;
+constexpr qint64 kGrainIntervalNs = 40 * 1000000LL;
+constexpr qint64 kGrainFadeMs = 4;
+constexpr int kMaxGrainPackets = 64;
+
+static AVSampleFormat av_sample_format(QAudioFormat::SampleFormat format)
+{
+    switch (format)
+    {
+        case QAudioFormat::Int32:
+            return AV_SAMPLE_FMT_S32;
+        case QAudioFormat::Float:
+            return AV_SAMPLE_FMT_FLT;
+        default:
+            return AV_SAMPLE_FMT_S16;
+    }
+}
+
+template <typename Sample>
+static void apply_fade(Sample* samples, size_t frames, size_t channels, size_t fade_frames)
+{
+    fade_frames = std::min(fade_frames, frames / 2);
+    for (size_t i = 0; i < fade_frames; ++i)
+    {
+        const float gain = static_cast<float>(i) / static_cast<float>(fade_frames);
+        for (size_t c = 0; c < channels; ++c)
+        {
+            Sample& head = samples[(i * channels) + c];
+            Sample& tail = samples[((frames - 1 - i) * channels) + c];
+            head = static_cast<Sample>(static_cast<float>(head) * gain);
+            tail = static_cast<Sample>(static_cast<float>(tail) * gain);
+        }
+    }
+}
+
+static int scrub_interrupt_cb(void* ctx)
+{
+    const auto* preview = static_cast<const scrub_preview*>(ctx);
+    return preview->is_interrupted() ? 1 : 0;
+}
+
+scrub_preview::scrub_preview(grain_sink sink) : sink_(std::move(sink)) { worker_thread_ = std::thread(&scrub_preview::worker_main, this); }
+
+scrub_preview::~scrub_preview()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+        interrupted_.store(true, std::memory_order_release);
+    }
+    cv_.notify_all();
+    if (worker_thread_.joinable())
+    {
+        worker_thread_.join();
+    }
+    close();
+}
+
+void scrub_preview::begin(const QString& file_path, const QAudioFormat& format)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_ = true;
+        interrupted_.store(false, std::memory_order_release);
+        requested_file_ = file_path;
+        requested_format_ = format;
+        target_ms_ = -1;
+    }
+    cv_.notify_all();
+}
+
+void scrub_preview::move_to(qint64 position_ms)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!active_)
+        {
+            return;
+        }
+        target_ms_ = std::max<qint64>(0, position_ms);
+        target_requested_ns_ = steady_clock_ns();
+    }
+    cv_.notify_all();
+}
+
+void scrub_preview::end()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_ = false;
+        interrupted_.store(true, std::memory_order_release);
+        target_ms_ = -1;
+    }
+    cv_.notify_all();
+}
+
+void scrub_preview::worker_main()
+{
+    qint64 rendered_ms = -1;
+    qint64 next_grain_ns = 0;
+    while (true)
+    {
+        QString file_path;
+        QAudioFormat format;
+        qint64 target_ms = -1;
+        qint64 requested_ns = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock,
+                     [&]
+                     {
+                         return quit_ || (active_ && (requested_file_ != opened_file_ || requested_format_ != opened_format_ ||
+                                                      (target_ms_ >= 0 && target_ms_ != rendered_ms)));
+                     });
+            if (quit_)
+            {
+                return;
+            }
+
+            const qint64 now_ns = steady_clock_ns();
+            if (target_ms_ >= 0 && now_ns < next_grain_ns)
+            {
+                cv_.wait_for(lock, std::chrono::nanoseconds(next_grain_ns - now_ns), [this] { return quit_ || !active_; });
+                continue;
+            }
+            file_path = requested_file_;
+            format = requested_format_;
+            target_ms = target_ms_;
+            requested_ns = target_requested_ns_;
+        }
+
+        if (file_path != opened_file_ || format != opened_format_)
+        {
+            const qint64 open_started_ns = steady_clock_ns();
+            const bool ok = open(file_path, format);
+            opened_file_ = ok || !is_interrupted() ? file_path : QString();
+            opened_format_ = format;
+            rendered_ms = -1;
+            LOG_DEBUG("拖动预览 打开 {} 耗时 {:.2f} ms {}",
+                      ok ? "成功" : "失败",
+                      static_cast<double>(steady_clock_ns() - open_started_ns) / 1e6,
+                      file_path.toStdString());
+        }
+        if (target_ms < 0 || target_ms == rendered_ms)
+        {
+            continue;
+        }
+
+        rendered_ms = target_ms;
+        next_grain_ns = steady_clock_ns() + kGrainIntervalNs;
+        audio_packet_ptr grain = render_grain(target_ms);
+        if (!grain)
+        {
+            continue;
+        }
+
+        bool still_active = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            still_active = active_;
+        }
+        if (still_active)
+        {
+            sink_(grain, requested_ns);
+        }
+    }
+}
+
+void scrub_preview::close()
+{
+    if (swr_data_ != nullptr)
+    {
+        av_freep(&swr_data_);
+    }
+    swr_capacity_ = 0;
+    swr_free(&swr_ctx_);
+    avcodec_free_context(&codec_ctx_);
+    avformat_close_input(&format_ctx_);
+    stream_index_ = -1;
+    bytes_per_frame_ = 0;
+}
+
+bool scrub_preview::open(const QString& file_path, const QAudioFormat& format)
+{
+    close();
+    if (file_path.isEmpty() || !format.isValid())
+    {
+        return false;
+    }
+    auto guard = make_scoped_exit([this]() { close(); });
+
+    format_ctx_ = avformat_alloc_context();
+    if (format_ctx_ == nullptr)
+    {
+        return false;
+    }
+    format_ctx_->interrupt_callback.callback = scrub_interrupt_cb;
+    format_ctx_->interrupt_callback.opaque = this;
+
+    if (avformat_open_input(&format_ctx_, file_path.toUtf8().constData(), nullptr, nullptr) != 0)
+    {
+        return false;
+    }
+
+    const media_cache::file_stamp stamp = media_cache::stamp_of(file_path);
+    stream_index_ = stream_params::apply(media_cache::load_stream_params(file_path, stamp), format_ctx_);
+    if (stream_index_ < 0)
+    {
+        if (avformat_find_stream_info(format_ctx_, nullptr) < 0)
+        {
+            return false;
+        }
+        stream_index_ = av_find_best_stream(format_ctx_, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+        if (stream_index_ < 0)
+        {
+            return false;
+        }
+    }
+
+    AVStream* stream = format_ctx_->streams[stream_index_];
+    const AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    codec_ctx_ = avcodec_alloc_context3(codec);
+    if (codec == nullptr || codec_ctx_ == nullptr || avcodec_parameters_to_context(codec_ctx_, stream->codecpar) < 0 ||
+        avcodec_open2(codec_ctx_, codec, nullptr) < 0)
+    {
+        return false;
+    }
+    time_base_ = stream->time_base;
+
+    AVChannelLayout target_layout;
+    av_channel_layout_default(&target_layout, format.channelCount());
+    const AVSampleFormat target_fmt = av_sample_format(format.sampleFormat());
+    if (swr_alloc_set_opts2(&swr_ctx_,
+                            &target_layout,
+                            target_fmt,
+                            format.sampleRate(),
+                            &codec_ctx_->ch_layout,
+                            codec_ctx_->sample_fmt,
+                            codec_ctx_->sample_rate,
+                            0,
+                            nullptr) != 0 ||
+        swr_init(swr_ctx_) != 0)
+    {
+        return false;
+    }
+    bytes_per_frame_ = format.channelCount() * av_get_bytes_per_sample(target_fmt);
+
+    guard.cancel();
+    return true;
+}
+
+bool scrub_preview::append_frame(const AVFrame* frame, int skip_samples, std::vector<uint8_t>& out, size_t target_bytes)
+{
+    const int out_capacity = swr_get_out_samples(swr_ctx_, frame->nb_samples);
+    if (out_capacity > swr_capacity_)
+    {
+        av_freep(&swr_data_);
+        const AVSampleFormat target_fmt = av_sample_format(opened_format_.sampleFormat());
+        if (av_samples_alloc(&swr_data_, nullptr, opened_format_.channelCount(), out_capacity, target_fmt, 0) < 0)
+        {
+            swr_capacity_ = 0;
+            return false;
+        }
+        swr_capacity_ = out_capacity;
+    }
+
+    const int converted = swr_convert(swr_ctx_, &swr_data_, swr_capacity_, const_cast<const uint8_t**>(frame->extended_data), frame->nb_samples);
+    if (converted <= 0)
+    {
+        return converted == 0;
+    }
+
+    const auto skip_out = static_cast<int>(av_rescale(skip_samples, opened_format_.sampleRate(), codec_ctx_->sample_rate));
+    if (skip_out >= converted)
+    {
+        return true;
+    }
+    const size_t available = static_cast<size_t>(converted - skip_out) * static_cast<size_t>(bytes_per_frame_);
+    const size_t take = std::min(available, target_bytes - out.size());
+    const uint8_t* begin = swr_data_ + (static_cast<size_t>(skip_out) * static_cast<size_t>(bytes_per_frame_));
+    out.insert(out.end(), begin, begin + take);
+    return true;
+}
+
+audio_packet_ptr scrub_preview::render_grain(qint64 position_ms)
+{
+    if (format_ctx_ == nullptr || bytes_per_frame_ <= 0)
+    {
+        return {};
+    }
+
+    const AVStream* stream = format_ctx_->streams[stream_index_];
+    const int64_t start_pts = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    const int64_t target_pts = start_pts + av_rescale_q(position_ms, {1, 1000}, time_base_);
+    if (av_seek_frame(format_ctx_, stream_index_, target_pts, AVSEEK_FLAG_BACKWARD) < 0)
+    {
+        return {};
+    }
+    avcodec_flush_buffers(codec_ctx_);
+    swr_init(swr_ctx_);
+
+    const size_t target_bytes = static_cast<size_t>(kGrainMs * opened_format_.sampleRate() / 1000) * static_cast<size_t>(bytes_per_frame_);
+    audio_packet_ptr grain = audio_packet_pool::instance().acquire(target_bytes);
+    grain->ms = position_ms;
+    grain->format = opened_format_.sampleFormat();
+    grain->channels = opened_format_.channelCount();
+    grain->sample_rate = opened_format_.sampleRate();
+
+    AVPacket* packet = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+    DEFER(av_packet_free(&packet));
+    DEFER(av_frame_free(&frame));
+    if (packet == nullptr || frame == nullptr)
+    {
+        return {};
+    }
+
+    for (int packets = 0; packets < kMaxGrainPackets && grain->data.size() < target_bytes; ++packets)
+    {
+        if (av_read_frame(format_ctx_, packet) < 0)
+        {
+            break;
+        }
+        const bool ours = packet->stream_index == stream_index_;
+        if (ours)
+        {
+            avcodec_send_packet(codec_ctx_, packet);
+        }
+        av_packet_unref(packet);
+        if (!ours)
+        {
+            continue;
+        }
+
+        while (grain->data.size() < target_bytes && avcodec_receive_frame(codec_ctx_, frame) == 0)
+        {
+            int skip = 0;
+            if (frame->best_effort_timestamp != AV_NOPTS_VALUE)
+            {
+                const int64_t frame_pts = frame->best_effort_timestamp - start_pts;
+                const int64_t frame_ms = av_rescale_q(frame_pts, time_base_, {1, 1000});
+                if (frame_ms < position_ms)
+                {
+                    skip = static_cast<int>(std::min<int64_t>(frame->nb_samples, (position_ms - frame_ms) * codec_ctx_->sample_rate / 1000));
+                }
+            }
+            const bool ok = skip >= frame->nb_samples || append_frame(frame, skip, grain->data, target_bytes);
+            av_frame_unref(frame);
+            if (!ok)
+            {
+                return {};
+            }
+        }
+    }
+
+    if (grain->data.empty())
+    {
+        return {};
+    }
+    shape_grain(*grain);
+    return grain;
+}
+
+void scrub_preview::shape_grain(audio_packet& grain) const
+{
+    const auto channels = static_cast<size_t>(grain.channels);
+    const size_t frames = grain.data.size() / static_cast<size_t>(bytes_per_frame_);
+    const auto fade_frames = static_cast<size_t>(kGrainFadeMs * opened_format_.sampleRate() / 1000);
+    switch (grain.format)
+    {
+        case QAudioFormat::Int32:
+            apply_fade(reinterpret_cast<int32_t*>(grain.data.data()), frames, channels, fade_frames);
+            break;
+        case QAudioFormat::Float:
+            apply_fade(reinterpret_cast<float*>(grain.data.data()), frames, channels, fade_frames);
+            break;
+        default:
+            apply_fade(reinterpret_cast<int16_t*>(grain.data.data()), frames, channels, fade_frames);
+            break;
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef SCRUB_PREVIEW_H
+#define SCRUB_PREVIEW_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <QString>
+#include <QAudioFormat>
+#include "audio_packet.h"
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswresample/swresample.h>
+}
+
+class scrub_preview
+{
+   public:
+    using grain_sink = std::function<void(const audio_packet_ptr& grain, qint64 requested_ns)>;
+
+    explicit scrub_preview(grain_sink sink);
+    ~scrub_preview();
+
+    scrub_preview(const scrub_preview&) = delete;
+    scrub_preview& operator=(const scrub_preview&) = delete;
+
+    void begin(const QString& file_path, const QAudioFormat& format);
+    void move_to(qint64 position_ms);
+    void end();
+    bool is_interrupted() const { return interrupted_.load(std::memory_order_acquire); }
+
+   private:
+    void worker_main();
+    bool open(const QString& file_path, const QAudioFormat& format);
+    void close();
+    audio_packet_ptr render_grain(qint64 position_ms);
+    bool append_frame(const AVFrame* frame, int skip_samples, std::vector<uint8_t>& out, size_t target_bytes);
+    void shape_grain(audio_packet& grain) const;
+
+   private:
+    grain_sink sink_;
+    std::thread worker_thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool quit_ = false;
+    bool active_ = false;
+    std::atomic<bool> interrupted_{false};
+    QString requested_file_;
+    QAudioFormat requested_format_;
+    qint64 target_ms_ = -1;
+    qint64 target_requested_ns_ = 0;
+
+    QString opened_file_;
+    QAudioFormat opened_format_;
+    AVFormatContext* format_ctx_ = nullptr;
+    AVCodecContext* codec_ctx_ = nullptr;
+    SwrContext* swr_ctx_ = nullptr;
+    uint8_t* swr_data_ = nullptr;
+    int swr_capacity_ = 0;
+    int stream_index_ = -1;
+    AVRational time_base_{1, 1000};
+    int bytes_per_frame_ = 0;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include "seek_index.h"
+
+constexpr char kSeekIndexMagic = 'S';
+constexpr char kSeekIndexVersion = 1;
+
+static void write_varint(QByteArray& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.append(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.append(static_cast<char>(value));
+}
+
+static bool read_varint(const QByteArray& in, qsizetype& offset, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && offset < in.size(); shift += 7)
+    {
+        const auto byte = static_cast<uint8_t>(in[offset++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void seek_index::add(int64_t pts, int64_t pos, int64_t min_spacing)
+{
+    if (pts < 0 || pos < 0)
+    {
+        return;
+    }
+    if (!entries_.empty())
+    {
+        const entry& last = entries_.back();
+        if (pts < last.pts + min_spacing || pos <= last.pos)
+        {
+            return;
+        }
+    }
+    entries_.push_back({pts, pos});
+}
+
+const seek_index::entry* seek_index::find(int64_t pts) const
+{
+    auto it = std::upper_bound(entries_.begin(), entries_.end(), pts, [](int64_t value, const entry& e) { return value < e.pts; });
+    if (it == entries_.begin())
+    {
+        return nullptr;
+    }
+    return &*(it - 1);
+}
+
+const seek_index::entry* seek_index::find_pos(int64_t pos) const
+{
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), pos, [](const entry& e, int64_t value) { return e.pos < value; });
+    if (it == entries_.end() || it->pos != pos)
+    {
+        return nullptr;
+    }
+    return &*it;
+}
+
+QByteArray seek_index::serialize() const
+{
+    QByteArray out;
+    out.reserve(static_cast<qsizetype>(2 + (entries_.size() * 4)));
+    out.append(kSeekIndexMagic);
+    out.append(kSeekIndexVersion);
+    write_varint(out, entries_.size());
+
+    entry previous;
+    for (const entry& e : entries_)
+    {
+        write_varint(out, static_cast<uint64_t>(e.pts - previous.pts));
+        write_varint(out, static_cast<uint64_t>(e.pos - previous.pos));
+        previous = e;
+    }
+    return out;
+}
+
+seek_index seek_index::deserialize(const QByteArray& blob)
+{
+    seek_index index;
+    if (blob.size() < 3 || blob[0] != kSeekIndexMagic || blob[1] != kSeekIndexVersion)
+    {
+        return index;
+    }
+
+    qsizetype offset = 2;
+    uint64_t count = 0;
+    if (!read_varint(blob, offset, count))
+    {
+        return index;
+    }
+
+    index.entries_.reserve(std::min<uint64_t>(count, static_cast<uint64_t>(blob.size())));
+    entry current;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t pts_delta = 0;
+        uint64_t pos_delta = 0;
+        if (!read_varint(blob, offset, pts_delta) || !read_varint(blob, offset, pos_delta))
+        {
+            index.entries_.clear();
+            return index;
+        }
+        current.pts += static_cast<int64_t>(pts_delta);
+        current.pos += static_cast<int64_t>(pos_delta);
+        index.entries_.push_back(current);
+    }
+    return index;
+}
@@ -0,0 +1,33 @@
+#ifndef SEEK_INDEX_H
+#define SEEK_INDEX_H
+
+#include <cstdint>
+#include <vector>
+#include <QByteArray>
+
+class seek_index
+{
+   public:
+    struct entry
+    {
+        int64_t pts = 0;
+        int64_t pos = 0;
+    };
+
+    void clear() { entries_.clear(); }
+    [[nodiscard]] bool empty() const { return entries_.empty(); }
+    [[nodiscard]] size_t size() const { return entries_.size(); }
+    [[nodiscard]] int64_t last_pts() const { return entries_.empty() ? INT64_MIN : entries_.back().pts; }
+
+    void add(int64_t pts, int64_t pos, int64_t min_spacing);
+    [[nodiscard]] const entry* find(int64_t pts) const;
+    [[nodiscard]] const entry* find_pos(int64_t pos) const;
+
+    [[nodiscard]] QByteArray serialize() const;
+    static seek_index deserialize(const QByteArray& blob);
+
+   private:
+    std::vector<entry> entries_;
+};
+
+#endif
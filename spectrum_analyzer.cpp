@@ -0,0 +1,164 @@
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <numeric>
+#include <algorithm>
+#include <QSettings>
+#include "log.h"
+#include "spectrum_analyzer.h"
+
+constexpr int kDefaultFftSize = 512;
+constexpr int kDefaultHopMs = 20;
+constexpr int kMinHopMs = 15;
+constexpr int kMaxHopMs = 100;
+constexpr int kDefaultBands = 128;
+constexpr qint64 kDiscontinuityMs = 50;
+constexpr float kFloorDb = -120.0F;
+constexpr double kMinDbRange = 20.0;
+constexpr double kMaxDbDecayPerSecond = 5.0;
+constexpr double kMinDbRisePerSecond = 4.0;
+
+spectrum_analyzer::spectrum_analyzer(size_t fft_size, int hop_ms, size_t band_count, spectrum_bands::scale band_scale)
+    : fft_(fft_size), bands_(band_count, band_scale), hop_ms_(std::max(1, hop_ms))
+{
+    history_.assign(fft_.size(), 0.0F);
+    window_input_.resize(fft_.size());
+    magnitudes_.resize(fft_.bin_count());
+    band_values_.resize(bands_.band_count());
+    const float window_sum = std::accumulate(fft_.window().begin(), fft_.window().end(), 0.0F);
+    full_scale_ = window_sum > 0.0F ? 2.0F / window_sum : 1.0F;
+}
+
+std::unique_ptr<spectrum_analyzer> spectrum_analyzer::from_settings()
+{
+    QSettings settings("MusicPlayer", "MusicPlayer");
+    const auto requested_size = static_cast<size_t>(std::max(0, settings.value("spectrum/fft_size", kDefaultFftSize).toInt()));
+    const int hop_ms = std::clamp(settings.value("spectrum/hop_ms", kDefaultHopMs).toInt(), kMinHopMs, kMaxHopMs);
+    const auto band_count = static_cast<size_t>(std::max(0, settings.value("spectrum/bands", kDefaultBands).toInt()));
+    const auto band_scale = settings.value("spectrum/band_scale", "log").toString() == "mel" ? spectrum_bands::scale::Mel : spectrum_bands::scale::Log;
+    auto analyzer = std::make_unique<spectrum_analyzer>(requested_size, hop_ms, band_count, band_scale);
+    LOG_DEBUG("频谱 fft 长度 {} 帧移 {}ms 频带 {} {} 内核 {}",
+              analyzer->fft_size(),
+              analyzer->hop_ms_,
+              analyzer->band_count(),
+              band_scale == spectrum_bands::scale::Mel ? "mel" : "log",
+              fft_engine::kernel_name());
+    return analyzer;
+}
+
+void spectrum_analyzer::reset()
+{
+    std::fill(history_.begin(), history_.end(), 0.0F);
+    write_pos_ = 0;
+    filled_ = 0;
+    since_hop_ = 0;
+    expected_ms_ = -1;
+}
+
+void spectrum_analyzer::configure(int sample_rate)
+{
+    sample_rate_ = sample_rate;
+    hop_samples_ = std::max<size_t>(1, static_cast<size_t>(sample_rate) * static_cast<size_t>(hop_ms_) / 1000);
+    bands_.configure(fft_.size(), sample_rate);
+    reset();
+}
+
+void spectrum_analyzer::push(const audio_packet& packet, const frame_callback& callback)
+{
+    if (packet.sample_rate <= 0 || packet.channels <= 0 || packet.data.empty())
+    {
+        return;
+    }
+    if (packet.sample_rate != sample_rate_)
+    {
+        configure(packet.sample_rate);
+    }
+    if (packet.serial != serial_ || (expected_ms_ >= 0 && std::llabs(packet.ms - expected_ms_) > kDiscontinuityMs))
+    {
+        reset();
+    }
+    serial_ = packet.serial;
+
+    const size_t size = history_.size();
+    const size_t channels = static_cast<size_t>(packet.channels);
+    const qint64 center_offset_ms = static_cast<qint64>(size / 2) * 1000 / sample_rate_;
+    size_t frames = 0;
+
+    auto consume = [&](const auto* samples, float scale)
+    {
+        frames = packet.data.size() / (sizeof(*samples) * channels);
+        const float gain = scale / static_cast<float>(channels);
+        for (size_t i = 0; i < frames; ++i)
+        {
+            float mono = 0.0F;
+            for (size_t c = 0; c < channels; ++c)
+            {
+                mono += static_cast<float>(samples[(i * channels) + c]);
+            }
+            history_[write_pos_] = mono * gain;
+            write_pos_ = write_pos_ + 1 == size ? 0 : write_pos_ + 1;
+            filled_ = std::min(filled_ + 1, size);
+
+            if (++since_hop_ >= hop_samples_ && filled_ >= size / 2)
+            {
+                since_hop_ = 0;
+                const qint64 end_ms = packet.ms + (static_cast<qint64>(i + 1) * 1000 / sample_rate_);
+                analyze(std::max<qint64>(0, end_ms - center_offset_ms), callback);
+            }
+        }
+    };
+
+    switch (packet.format)
+    {
+        case QAudioFormat::Int32:
+            consume(reinterpret_cast<const qint32*>(packet.data.data()), 1.0F / 2147483648.0F);
+            break;
+        case QAudioFormat::Float:
+            consume(reinterpret_cast<const float*>(packet.data.data()), 1.0F);
+            break;
+        default:
+            consume(reinterpret_cast<const qint16*>(packet.data.data()), 1.0F / 32768.0F);
+            break;
+    }
+
+    expected_ms_ = packet.ms + (static_cast<qint64>(frames) * 1000 / sample_rate_);
+}
+
+void spectrum_analyzer::analyze(qint64 timestamp_ms, const frame_callback& callback)
+{
+    const size_t size = history_.size();
+    const size_t head = size - write_pos_;
+    std::memcpy(window_input_.data(), history_.data() + write_pos_, head * sizeof(float));
+    std::memcpy(window_input_.data() + head, history_.data(), write_pos_ * sizeof(float));
+
+    fft_.magnitudes(window_input_.data(), magnitudes_.data());
+    for (float& magnitude : magnitudes_)
+    {
+        magnitude *= full_scale_;
+    }
+    bands_.apply(magnitudes_.data(), magnitudes_.size(), band_values_.data());
+    normalize();
+    callback(timestamp_ms, band_values_.data(), band_values_.size());
+}
+
+void spectrum_analyzer::normalize()
+{
+    double frame_min_db = 1000.0;
+    double frame_max_db = 0.0;
+    for (float& value : band_values_)
+    {
+        value = std::max(0.0F, (20.0F * std::log10(std::max(value, 1e-12F))) - kFloorDb);
+        frame_min_db = std::min<double>(value, frame_min_db);
+        frame_max_db = std::max<double>(value, frame_max_db);
+    }
+
+    const double hop_s = static_cast<double>(hop_ms_) / 1000.0;
+    dynamic_max_db_ = frame_max_db > dynamic_max_db_ ? frame_max_db : std::max(dynamic_max_db_ - (kMaxDbDecayPerSecond * hop_s), frame_max_db);
+    dynamic_min_db_ = frame_min_db < dynamic_min_db_ ? frame_min_db : std::min(dynamic_min_db_ + (kMinDbRisePerSecond * hop_s), frame_min_db);
+    const double range = std::max(dynamic_max_db_ - dynamic_min_db_, kMinDbRange);
+
+    for (float& value : band_values_)
+    {
+        value = static_cast<float>(std::clamp((value - dynamic_min_db_) / range, 0.0, 1.0));
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef SPECTRUM_ANALYZER_H
+#define SPECTRUM_ANALYZER_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <QtGlobal>
+#include "fft_engine.h"
+#include "spectrum_bands.h"
+#include "audio_packet.h"
+
+class spectrum_analyzer
+{
+   public:
+    using frame_callback = std::function<void(qint64 timestamp_ms, const float* levels, size_t count)>;
+
+    spectrum_analyzer(size_t fft_size, int hop_ms, size_t band_count, spectrum_bands::scale band_scale);
+
+    static std::unique_ptr<spectrum_analyzer> from_settings();
+
+    spectrum_analyzer(const spectrum_analyzer&) = delete;
+    spectrum_analyzer& operator=(const spectrum_analyzer&) = delete;
+
+    void reset();
+    void push(const audio_packet& packet, const frame_callback& callback);
+
+    [[nodiscard]] size_t fft_size() const { return fft_.size(); }
+    [[nodiscard]] size_t band_count() const { return bands_.band_count(); }
+
+   private:
+    void configure(int sample_rate);
+    void analyze(qint64 timestamp_ms, const frame_callback& callback);
+    void normalize();
+
+   private:
+    fft_engine fft_;
+    spectrum_bands bands_;
+    int hop_ms_ = 0;
+    float full_scale_ = 1.0F;
+    int sample_rate_ = 0;
+    size_t hop_samples_ = 0;
+    uint32_t serial_ = 0;
+    qint64 expected_ms_ = -1;
+    double dynamic_min_db_ = 100.0;
+    double dynamic_max_db_ = 0.0;
+
+    std::vector<float> history_;
+    size_t write_pos_ = 0;
+    size_t filled_ = 0;
+    size_t since_hop_ = 0;
+
+    std::vector<float> window_input_;
+    std::vector<float> magnitudes_;
+    std::vector<float> band_values_;
+};
+
+#endif
@@ -0,0 +1,77 @@
+#include <cmath>
+#include <algorithm>
+#include "spectrum_bands.h"
+
+constexpr double kLowestHz = 30.0;
+constexpr double kHighestHz = 16000.0;
+
+static double hz_to_mel(double hz) { return 2595.0 * std::log10(1.0 + (hz / 700.0)); }
+static double mel_to_hz(double mel) { return 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0); }
+
+spectrum_bands::spectrum_bands(size_t band_count, scale band_scale)
+    : band_count_(std::clamp(band_count, kMinBands, kMaxBands)), scale_(band_scale)
+{
+}
+
+void spectrum_bands::configure(size_t fft_size, int sample_rate)
+{
+    bands_.assign(band_count_, band{});
+    const size_t bins = fft_size / 2;
+    if (bins < 2 || sample_rate <= 0)
+    {
+        return;
+    }
+
+    const double bin_hz = static_cast<double>(sample_rate) / static_cast<double>(fft_size);
+    const double high_hz = std::min(kHighestHz, static_cast<double>(sample_rate) / 2.0);
+    const double low_hz = std::min(kLowestHz, high_hz / 2.0);
+
+    auto edge_bin = [&](size_t index)
+    {
+        const double t = static_cast<double>(index) / static_cast<double>(band_count_);
+        const double hz = scale_ == scale::Mel ? mel_to_hz(hz_to_mel(low_hz) + (t * (hz_to_mel(high_hz) - hz_to_mel(low_hz))))
+                                               : low_hz * std::pow(high_hz / low_hz, t);
+        return hz / bin_hz;
+    };
+
+    double lower = edge_bin(0);
+    for (size_t i = 0; i < band_count_; ++i)
+    {
+        const double upper = edge_bin(i + 1);
+        const auto first = static_cast<size_t>(std::ceil(lower));
+        const auto last = std::min(bins, static_cast<size_t>(std::ceil(upper)));
+        band& b = bands_[i];
+        if (last > first)
+        {
+            b.first = static_cast<uint32_t>(first);
+            b.count = static_cast<uint32_t>(last - first);
+        }
+        else
+        {
+            const double center = std::clamp((lower + upper) / 2.0, 0.0, static_cast<double>(bins - 2));
+            b.first = static_cast<uint32_t>(center);
+            b.fraction = static_cast<float>(center - std::floor(center));
+        }
+        lower = upper;
+    }
+}
+
+void spectrum_bands::apply(const float* magnitudes, size_t count, float* bands) const
+{
+    for (size_t i = 0; i < bands_.size(); ++i)
+    {
+        const band& b = bands_[i];
+        if (b.count == 0)
+        {
+            const size_t next = std::min<size_t>(b.first + 1, count - 1);
+            bands[i] = magnitudes[b.first] + (b.fraction * (magnitudes[next] - magnitudes[b.first]));
+            continue;
+        }
+        float sum = 0.0F;
+        for (uint32_t j = 0; j < b.count; ++j)
+        {
+            sum += magnitudes[b.first + j];
+        }
+        bands[i] = sum / static_cast<float>(b.count);
+    }
+}
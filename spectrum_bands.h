@@ -0,0 +1,40 @@
+#ifndef SPECTRUM_BANDS_H
+#define SPECTRUM_BANDS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class spectrum_bands
+{
+   public:
+    enum class scale : uint8_t
+    {
+        Log,
+        Mel
+    };
+
+    static constexpr size_t kMinBands = 16;
+    static constexpr size_t kMaxBands = 512;
+
+    spectrum_bands(size_t band_count, scale band_scale);
+
+    void configure(size_t fft_size, int sample_rate);
+    void apply(const float* magnitudes, size_t count, float* bands) const;
+
+    [[nodiscard]] size_t band_count() const { return band_count_; }
+
+   private:
+    struct band
+    {
+        uint32_t first = 0;
+        uint32_t count = 0;
+        float fraction = 0.0F;
+    };
+
+    size_t band_count_ = 0;
+    scale scale_ = scale::Log;
+    std::vector<band> bands_;
+};
+
+#endif
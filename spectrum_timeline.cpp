@@ -0,0 +1,100 @@
+#include <cmath>
+#include <algorithm>
+#include "spectrum_timeline.h"
+
+constexpr int kLevelCount = 256;
+
+static uint8_t quantize(float level)
+{
+    return static_cast<uint8_t>(std::round(std::clamp(level, 0.0F, 1.0F) * static_cast<float>(kLevelCount - 1)));
+}
+
+void spectrum_timeline::append(uint32_t serial, qint64 timestamp_ms, const float* levels, size_t count)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (serial != serial_ || count != bands_ || (size_ > 0 && timestamp_ms < timestamps_[slot(size_ - 1)]))
+    {
+        serial_ = serial;
+        bands_ = count;
+        head_ = 0;
+        size_ = 0;
+        timestamps_.assign(kCapacity, 0);
+        levels_.assign(kCapacity * count, 0);
+    }
+
+    uint8_t* slot_levels = levels_.data() + (head_ * bands_);
+    for (size_t i = 0; i < count; ++i)
+    {
+        slot_levels[i] = quantize(levels[i]);
+    }
+    timestamps_[head_] = timestamp_ms;
+    head_ = (head_ + 1) % kCapacity;
+    size_ = std::min(size_ + 1, kCapacity);
+}
+
+bool spectrum_timeline::lookup(uint32_t serial, qint64 position_ms, std::vector<float>& levels) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (serial != serial_ || size_ == 0)
+    {
+        return false;
+    }
+
+    size_t low = 0;
+    size_t high = size_;
+    while (low < high)
+    {
+        const size_t mid = (low + high) / 2;
+        if (timestamps_[slot(mid)] <= position_ms)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    const size_t prev = slot(low == 0 ? 0 : low - 1);
+    const size_t next = slot(low == size_ ? size_ - 1 : low);
+    const qint64 interval = timestamps_[next] - timestamps_[prev];
+    const float t = interval > 0 ? static_cast<float>(position_ms - timestamps_[prev]) / static_cast<float>(interval) : 0.0F;
+    const uint8_t* a = levels_.data() + (prev * bands_);
+    const uint8_t* b = levels_.data() + (next * bands_);
+    levels.resize(bands_);
+    for (size_t i = 0; i < bands_; ++i)
+    {
+        const float level = static_cast<float>(a[i]) + (t * static_cast<float>(b[i] - a[i]));
+        levels[i] = level / static_cast<float>(kLevelCount - 1);
+    }
+    return true;
+}
+
+spectrum_timeline::frames spectrum_timeline::copy_until(qint64 position_ms) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    frames out;
+    out.bands = bands_;
+    for (size_t i = 0; i < size_ && timestamps_[slot(i)] <= position_ms; ++i)
+    {
+        const uint8_t* levels = levels_.data() + (slot(i) * bands_);
+        out.timestamps.push_back(timestamps_[slot(i)]);
+        out.levels.insert(out.levels.end(), levels, levels + bands_);
+    }
+    return out;
+}
+
+void spectrum_timeline::assign(uint32_t serial, const frames& source)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t count = std::min(source.timestamps.size(), kCapacity);
+    const size_t skip = source.timestamps.size() - count;
+    serial_ = serial;
+    bands_ = source.bands;
+    timestamps_.assign(kCapacity, 0);
+    levels_.assign(kCapacity * bands_, 0);
+    std::copy_n(source.timestamps.begin() + static_cast<std::ptrdiff_t>(skip), count, timestamps_.begin());
+    std::copy_n(source.levels.begin() + static_cast<std::ptrdiff_t>(skip * bands_), count * bands_, levels_.begin());
+    head_ = count % kCapacity;
+    size_ = count;
+}
@@ -0,0 +1,44 @@
+#ifndef SPECTRUM_TIMELINE_H
+#define SPECTRUM_TIMELINE_H
+
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <QtGlobal>
+
+class spectrum_timeline
+{
+   public:
+    static constexpr size_t kCapacity = 512;
+
+    struct frames
+    {
+        size_t bands = 0;
+        std::vector<qint64> timestamps;
+        std::vector<uint8_t> levels;
+    };
+
+    spectrum_timeline() = default;
+
+    spectrum_timeline(const spectrum_timeline&) = delete;
+    spectrum_timeline& operator=(const spectrum_timeline&) = delete;
+
+    void append(uint32_t serial, qint64 timestamp_ms, const float* levels, size_t count);
+    bool lookup(uint32_t serial, qint64 position_ms, std::vector<float>& levels) const;
+    [[nodiscard]] frames copy_until(qint64 position_ms) const;
+    void assign(uint32_t serial, const frames& source);
+
+   private:
+    [[nodiscard]] size_t slot(size_t index) const { return (head_ + kCapacity - size_ + index) % kCapacity; }
+
+   private:
+    mutable std::mutex mutex_;
+    uint32_t serial_ = 0;
+    size_t bands_ = 0;
+    size_t head_ = 0;
+    size_t size_ = 0;
+    std::vector<qint64> timestamps_;
+    std::vector<uint8_t> levels_;
+};
+
+#endif
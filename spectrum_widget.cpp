@@ -1,174 +1,270 @@
-#include <cmath>
-#include <QThread>
+#include <cstring>
+#include <QTimer>
 #include <QPainter>
 #include <algorithm>
 #include <QPaintEvent>
-#include <QMetaObject>
+#include <QResizeEvent>
+#include <QElapsedTimer>
 
+#include "log.h"
 #include "spectrum_widget.h"
-#include "spectrum_processor.h"
 
-constexpr int kNumBars = 128;
-constexpr double kMinDbRange = 20.0;
-constexpr double kMaxDbDecayPerSecond = 5.0;
-constexpr double kMinDbRisePerSecond = 4.0;
+constexpr int kRenderIntervalMs = 80;
+constexpr int kFrameCostReportFrames = 250;
+constexpr int kSubpixelSteps = 8;
 
 constexpr double kBarRiseFactor = 0.6;
 constexpr double kBarFallFactor = 0.25;
 
+static QRgb scale_pixel(QRgb pixel, uint coverage)
+{
+    const uint rb = (((pixel & 0x00ff00ffU) * coverage) >> 8) & 0x00ff00ffU;
+    const uint ag = (((pixel >> 8) & 0x00ff00ffU) * coverage) & 0xff00ff00U;
+    return rb | ag;
+}
+
 spectrum_widget::spectrum_widget(QWidget* parent) : QWidget(parent), bar_color_(Qt::blue)
 {
-    qRegisterMetaType<std::shared_ptr<audio_packet>>("std::shared_ptr<audio_packet>");
-    qRegisterMetaType<std::vector<double>>("std::vector<double>");
     setAutoFillBackground(false);
     setAttribute(Qt::WA_NoSystemBackground);
 
-    spectrum_thread_ = new QThread(this);
-    processor_ = new spectrum_processor();
-    processor_->moveToThread(spectrum_thread_);
+    render_timer_ = new QTimer(this);
+    connect(render_timer_, &QTimer::timeout, this, &spectrum_widget::on_render_timeout);
+}
 
-    connect(processor_, &spectrum_processor::magnitudes_ready, this, &spectrum_widget::update_display, Qt::QueuedConnection);
-    connect(spectrum_thread_, &QThread::finished, processor_, &QObject::deleteLater);
+void spectrum_widget::set_playback_clock(const std::shared_ptr<playback_clock>& clock) { clock_ = clock; }
 
-    spectrum_thread_->start();
-    frame_timer_.start();
+void spectrum_widget::reset_and_start(qint64 session_id, const std::shared_ptr<pcm_ring>& ring)
+{
+    session_id_ = session_id;
+    ring_ = ring;
+
+    band_levels_.clear();
+    bar_heights_.clear();
+    invalidate_sprites();
+
+    render_timer_->start(kRenderIntervalMs);
+    emit playback_started(session_id_);
 }
 
-spectrum_widget::~spectrum_widget()
+void spectrum_widget::stop_playback()
 {
-    spectrum_thread_->quit();
-    spectrum_thread_->wait();
+    render_timer_->stop();
+    ring_.reset();
+    band_levels_.clear();
+    bar_heights_.clear();
+    invalidate_sprites();
 }
 
-void spectrum_widget::enqueue_packet(const std::shared_ptr<audio_packet>& packet)
+void spectrum_widget::on_render_timeout()
 {
-    QMetaObject::invokeMethod(processor_, "process_packet", Qt::QueuedConnection, Q_ARG(std::shared_ptr<audio_packet>, packet));
+    if (!clock_ || !ring_)
+    {
+        return;
+    }
+
+    const playback_clock::reading reading = clock_->read();
+    if (reading.session_id != session_id_ || reading.position_us < 0)
+    {
+        return;
+    }
+    QElapsedTimer cost;
+    cost.start();
+    if (!ring_->spectrum().lookup(ring_->serial(), reading.position_ms(), band_levels_))
+    {
+        return;
+    }
+    update_bar_heights();
+    const QRegion dirty = rasterize_bars();
+    tick_cost_ns_ = cost.nsecsElapsed();
+    if (!dirty.isEmpty())
+    {
+        update(dirty);
+    }
 }
 
-void spectrum_widget::reset_and_start(qint64 session_id, qint64 start_offset_ms)
+void spectrum_widget::update_bar_heights()
 {
-    session_id_ = session_id;
-    dynamic_min_db_ = 100.0;
-    dynamic_max_db_ = 0.0;
-    frame_timer_.restart();
-    last_paint_time_ms_ = 0;
-
-    smoothed_bar_heights_.clear();
-    display_magnitudes_.clear();
-    update();
+    if (bar_heights_.size() != band_levels_.size())
+    {
+        bar_heights_.assign(band_levels_.size(), 0.0F);
+    }
 
-    QMetaObject::invokeMethod(processor_, "reset_and_start", Qt::QueuedConnection, Q_ARG(qint64, start_offset_ms));
-    emit playback_started(session_id_);
+    for (size_t i = 0; i < bar_heights_.size(); ++i)
+    {
+        const float target_height_ratio = band_levels_[i];
+        const float current_height_ratio = bar_heights_[i];
+        const double factor = (target_height_ratio > current_height_ratio) ? kBarRiseFactor : kBarFallFactor;
+        bar_heights_[i] += static_cast<float>((target_height_ratio - current_height_ratio) * factor);
+    }
 }
 
-void spectrum_widget::stop_playback()
+void spectrum_widget::invalidate_sprites()
 {
-    QMetaObject::invokeMethod(processor_, "stop_playback", Qt::QueuedConnection);
-    display_magnitudes_.clear();
-    smoothed_bar_heights_.clear();
+    sprites_valid_ = false;
     update();
 }
 
-void spectrum_widget::update_display(const std::vector<double>& magnitudes)
+void spectrum_widget::resizeEvent(QResizeEvent* event)
 {
-    display_magnitudes_ = magnitudes;
-    update();
+    QWidget::resizeEvent(event);
+    invalidate_sprites();
 }
 
-void spectrum_widget::paintEvent(QPaintEvent* /*event*/)
+void spectrum_widget::render_sprites()
 {
-    qint64 current_time_ms = frame_timer_.elapsed();
-    if (last_paint_time_ms_ == 0)
+    sprites_valid_ = true;
+    const qreal dpr = devicePixelRatioF();
+    const QSize device_size = (QSizeF(size()) * dpr).toSize();
+    frame_ = QImage();
+    sprites_ = QImage();
+    bar_columns_.clear();
+    drawn_levels_.assign(bar_heights_.size(), 0);
+    if (device_size.isEmpty())
     {
-        last_paint_time_ms_ = current_time_ms;
+        return;
     }
-    double delta_time_s = static_cast<double>(current_time_ms - last_paint_time_ms_) / 1000.0;
-    last_paint_time_ms_ = current_time_ms;
-
-    QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing);
 
-    if (display_magnitudes_.empty())
+    frame_ = QImage(device_size, QImage::Format_ARGB32_Premultiplied);
+    frame_.setDevicePixelRatio(dpr);
+    frame_.fill(Qt::transparent);
+    if (bar_heights_.empty())
     {
         return;
     }
 
-    std::vector<double> target_db_values;
-    target_db_values.reserve(kNumBars);
-    auto data_points_per_bar = display_magnitudes_.size() / kNumBars;
-    if (data_points_per_bar == 0)
+    const int bars = static_cast<int>(bar_heights_.size());
+    const double bar_width = static_cast<double>(device_size.width()) / bars;
+    bar_columns_.resize(bar_heights_.size() + 1);
+    for (int i = 0; i <= bars; ++i)
     {
-        data_points_per_bar = 1;
+        bar_columns_[i] = qRound(i * bar_width);
     }
 
-    for (size_t i = 0; i < kNumBars; ++i)
+    sprites_ = QImage(device_size.width(), kSubpixelSteps, QImage::Format_ARGB32_Premultiplied);
+    sprites_.fill(Qt::transparent);
     {
-        double avg_magnitude = 0;
-        int count = 0;
-        for (size_t j = i * data_points_per_bar; j < (i + 1) * data_points_per_bar && j < display_magnitudes_.size(); ++j)
+        QPainter painter(&sprites_);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setPen(Qt::NoPen);
+        QColor current_bar_color = bar_color_;
+        current_bar_color.setAlphaF(current_bar_color.alphaF() * 0.88F);
+        QColor glow_bar_color = current_bar_color;
+        glow_bar_color.setAlphaF(current_bar_color.alphaF() * 0.28F);
+        for (int i = 0; i < bars; ++i)
         {
-            avg_magnitude += display_magnitudes_[j];
-            count++;
+            const QRectF bar_rect(i * bar_width, 0.0, bar_width, kSubpixelSteps);
+            painter.setBrush(glow_bar_color);
+            painter.drawRect(bar_rect.adjusted(-dpr, 0.0, dpr, 0.0));
+            painter.setBrush(current_bar_color);
+            painter.drawRect(bar_rect);
         }
-        if (count > 0)
+    }
+
+    const auto* full = reinterpret_cast<const QRgb*>(sprites_.constScanLine(kSubpixelSteps - 1));
+    for (int step = 1; step < kSubpixelSteps; ++step)
+    {
+        auto* line = reinterpret_cast<QRgb*>(sprites_.scanLine(step - 1));
+        const uint coverage = static_cast<uint>(step * 256 / kSubpixelSteps);
+        for (int x = 0; x < sprites_.width(); ++x)
         {
-            avg_magnitude /= count;
+            line[x] = scale_pixel(full[x], coverage);
         }
-        double db_value = 20 * log10(avg_magnitude + 1e-9);
-        target_db_values.push_back(qMax(0.0, db_value));
     }
+}
 
-    double current_frame_min_db = 1000.0;
-    double current_frame_max_db = 0.0;
-    for (double db : target_db_values)
+QRegion spectrum_widget::rasterize_bars()
+{
+    if (!sprites_valid_ || drawn_levels_.size() != bar_heights_.size() || frame_.devicePixelRatio() != devicePixelRatioF())
     {
-        current_frame_min_db = std::min(db, current_frame_min_db);
-        current_frame_max_db = std::max(db, current_frame_max_db);
+        render_sprites();
     }
-    const double max_db_decay_this_frame = kMaxDbDecayPerSecond * delta_time_s;
-    const double min_db_rise_this_frame = kMinDbRisePerSecond * delta_time_s;
-    dynamic_max_db_ =
-        (current_frame_max_db > dynamic_max_db_) ? current_frame_max_db : std::max(dynamic_max_db_ - max_db_decay_this_frame, current_frame_max_db);
-    dynamic_min_db_ =
-        (current_frame_min_db < dynamic_min_db_) ? current_frame_min_db : std::min(dynamic_min_db_ + min_db_rise_this_frame, current_frame_min_db);
-    double range = std::max(dynamic_max_db_ - dynamic_min_db_, kMinDbRange);
-
-    if (smoothed_bar_heights_.size() != kNumBars)
+    if (frame_.isNull() || sprites_.isNull())
     {
-        smoothed_bar_heights_.assign(kNumBars, 0.0);
+        return {};
     }
 
-    for (size_t i = 0; i < kNumBars; ++i)
+    const int device_height = frame_.height();
+    const int top_level = device_height * kSubpixelSteps;
+    const qreal dpr = frame_.devicePixelRatio();
+    QRegion dirty;
+    for (size_t i = 0; i < bar_heights_.size(); ++i)
     {
-        double target_height_ratio = (target_db_values[i] - dynamic_min_db_) / range;
-        target_height_ratio = qBound(0.0, target_height_ratio, 1.0);
-
-        double current_height_ratio = smoothed_bar_heights_[i];
-
-        double factor = (target_height_ratio > current_height_ratio) ? kBarRiseFactor : kBarFallFactor;
+        const int level = std::clamp(qRound(bar_heights_[i] * static_cast<float>(top_level)), 0, top_level);
+        const int old_level = drawn_levels_[i];
+        if (level == old_level)
+        {
+            continue;
+        }
+        drawn_levels_[i] = level;
 
-        smoothed_bar_heights_[i] += (target_height_ratio - current_height_ratio) * factor;
+        const int x0 = bar_columns_[i];
+        const size_t bytes = static_cast<size_t>(bar_columns_[i + 1] - x0) * sizeof(QRgb);
+        const int full_rows = level / kSubpixelSteps;
+        const int partial = level % kSubpixelSteps;
+        const int first_row = std::min(level, old_level) / kSubpixelSteps;
+        const int last_row = std::min(device_height - 1, std::max(level, old_level) / kSubpixelSteps);
+        for (int row = first_row; row <= last_row; ++row)
+        {
+            auto* line = reinterpret_cast<QRgb*>(frame_.scanLine(device_height - 1 - row)) + x0;
+            if (row < full_rows)
+            {
+                std::memcpy(line, reinterpret_cast<const QRgb*>(sprites_.constScanLine(kSubpixelSteps - 1)) + x0, bytes);
+            }
+            else if (row == full_rows && partial > 0)
+            {
+                std::memcpy(line, reinterpret_cast<const QRgb*>(sprites_.constScanLine(partial - 1)) + x0, bytes);
+            }
+            else
+            {
+                std::memset(line, 0, bytes);
+            }
+        }
+        const QRectF device_rect(x0, device_height - 1 - last_row, bar_columns_[i + 1] - x0, last_row - first_row + 1);
+        dirty += QRectF(device_rect.topLeft() / dpr, device_rect.size() / dpr).toAlignedRect();
     }
+    return dirty;
+}
 
-    painter.setPen(Qt::NoPen);
-    QColor current_bar_color = bar_color_;
-    current_bar_color.setAlphaF(current_bar_color.alphaF() * 0.88F);
-    QColor glow_bar_color = current_bar_color;
-    glow_bar_color.setAlphaF(current_bar_color.alphaF() * 0.28F);
-    double bar_width = static_cast<double>(width()) / kNumBars;
+void spectrum_widget::record_frame_cost(qint64 paint_ns)
+{
+    const qint64 frame_ns = tick_cost_ns_ + paint_ns;
+    frame_cost_total_ns_ += frame_ns;
+    frame_cost_max_ns_ = std::max(frame_cost_max_ns_, frame_ns);
+    if (++frame_cost_samples_ < kFrameCostReportFrames)
+    {
+        return;
+    }
+    LOG_DEBUG("频谱 界面线程每帧 平均 {:.3f} ms 最大 {:.3f} ms 频带 {} 尺寸 {}x{}",
+              static_cast<double>(frame_cost_total_ns_) / frame_cost_samples_ / 1e6,
+              static_cast<double>(frame_cost_max_ns_) / 1e6,
+              bar_heights_.size(),
+              width(),
+              height());
+    frame_cost_total_ns_ = 0;
+    frame_cost_max_ns_ = 0;
+    frame_cost_samples_ = 0;
+}
 
-    for (size_t i = 0; i < kNumBars; ++i)
+void spectrum_widget::paintEvent(QPaintEvent* event)
+{
+    QElapsedTimer cost;
+    cost.start();
+    if (!sprites_valid_)
+    {
+        rasterize_bars();
+    }
+    if (frame_.isNull())
     {
-        double bar_height = smoothed_bar_heights_[i] * height();
+        return;
+    }
 
-        if (bar_height > 0)
-        {
-            double x = static_cast<double>(i) * bar_width;
-            QRectF bar_rect(x, height() - bar_height, bar_width, bar_height);
-            painter.setBrush(glow_bar_color);
-            painter.drawRect(bar_rect.adjusted(-1.0, 0.0, 1.0, 0.0));
-            painter.setBrush(current_bar_color);
-            painter.drawRect(bar_rect);
-        }
+    const qreal dpr = frame_.devicePixelRatio();
+    QPainter painter(this);
+    for (const QRect& target : event->region())
+    {
+        painter.drawImage(target, frame_, QRectF(QPointF(target.topLeft()) * dpr, QSizeF(target.size()) * dpr));
     }
+    painter.end();
+    record_frame_cost(cost.nsecsElapsed());
 }
@@ -4,12 +4,13 @@
 #include <vector>
 #include <memory>
 #include <QWidget>
-#include <QElapsedTimer>
 #include <QColor>
-#include "audio_packet.h"
+#include <QImage>
+#include <QRegion>
+#include "pcm_ring.h"
+#include "playback_clock.h"
 
-class QThread;
-class spectrum_processor;
+class QTimer;
 
 class spectrum_widget : public QWidget
 {
@@ -18,18 +19,19 @@ class spectrum_widget : public QWidget
 
    public:
     explicit spectrum_widget(QWidget* parent = nullptr);
-    ~spectrum_widget() override;
+    ~spectrum_widget() override = default;
+
+    void set_playback_clock(const std::shared_ptr<playback_clock>& clock);
 
     QColor getBarColor() const { return bar_color_; }
     void setBarColor(const QColor& color)
     {
         bar_color_ = color;
-        update();
+        invalidate_sprites();
     }
 
    public slots:
-    void enqueue_packet(const std::shared_ptr<audio_packet>& packet);
-    void reset_and_start(qint64 session_id, qint64 start_offset_ms = 0);
+    void reset_and_start(qint64 session_id, const std::shared_ptr<pcm_ring>& ring);
     void stop_playback();
 
    signals:
@@ -37,21 +39,36 @@ class spectrum_widget : public QWidget
 
    protected:
     void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
 
    private slots:
-    void update_display(const std::vector<double>& magnitudes);
+    void on_render_timeout();
+
+   private:
+    void update_bar_heights();
+    void invalidate_sprites();
+    void render_sprites();
+    QRegion rasterize_bars();
+    void record_frame_cost(qint64 paint_ns);
 
    private:
-    QThread* spectrum_thread_;
-    spectrum_processor* processor_;
+    QTimer* render_timer_;
+    std::shared_ptr<playback_clock> clock_;
+    std::shared_ptr<pcm_ring> ring_;
     qint64 session_id_ = 0;
-    double dynamic_min_db_ = 100.0;
-    double dynamic_max_db_ = 0.0;
-    std::vector<double> display_magnitudes_;
+    std::vector<float> band_levels_;
+    std::vector<float> bar_heights_;
+
+    QImage frame_;
+    QImage sprites_;
+    bool sprites_valid_ = false;
+    std::vector<int> bar_columns_;
+    std::vector<int> drawn_levels_;
 
-    QElapsedTimer frame_timer_;
-    qint64 last_paint_time_ms_ = 0;
-    std::vector<double> smoothed_bar_heights_;
+    qint64 tick_cost_ns_ = 0;
+    qint64 frame_cost_total_ns_ = 0;
+    qint64 frame_cost_max_ns_ = 0;
+    int frame_cost_samples_ = 0;
 
     QColor bar_color_;
 };
@@ -0,0 +1,122 @@
+#include <cstring>
+#include <QDataStream>
+#include <QIODevice>
+#include "stream_params.h"
+
+constexpr quint8 kStreamParamsVersion = 1;
+
+QByteArray stream_params::capture(const AVFormatContext* ctx, int stream_index)
+{
+    const AVStream* stream = ctx->streams[stream_index];
+    const AVCodecParameters* par = stream->codecpar;
+
+    QByteArray blob;
+    QDataStream out(&blob, QIODevice::WriteOnly);
+    out << kStreamParamsVersion << static_cast<qint32>(stream_index) << static_cast<qint32>(par->codec_id)
+        << static_cast<qint32>(par->format) << static_cast<qint32>(par->sample_rate) << static_cast<qint32>(par->ch_layout.order)
+        << static_cast<qint32>(par->ch_layout.nb_channels)
+        << static_cast<quint64>(par->ch_layout.order == AV_CHANNEL_ORDER_NATIVE ? par->ch_layout.u.mask : 0)
+        << static_cast<qint64>(par->bit_rate) << static_cast<qint32>(par->bits_per_coded_sample)
+        << static_cast<qint32>(par->bits_per_raw_sample) << static_cast<qint32>(par->profile) << static_cast<qint32>(par->block_align)
+        << static_cast<qint32>(par->frame_size) << static_cast<qint32>(par->initial_padding) << static_cast<qint32>(par->trailing_padding)
+        << static_cast<qint32>(par->seek_preroll)
+        << QByteArray(reinterpret_cast<const char*>(par->extradata), par->extradata != nullptr ? par->extradata_size : 0)
+        << static_cast<qint32>(stream->time_base.num) << static_cast<qint32>(stream->time_base.den) << static_cast<qint64>(stream->start_time)
+        << static_cast<qint64>(stream->duration) << static_cast<qint64>(ctx->duration);
+    return blob;
+}
+
+int stream_params::apply(const QByteArray& blob, AVFormatContext* ctx)
+{
+    QDataStream in(blob);
+    quint8 version = 0;
+    qint32 stream_index = -1;
+    qint32 codec_id = 0;
+    qint32 format = 0;
+    qint32 sample_rate = 0;
+    qint32 order = 0;
+    qint32 channels = 0;
+    quint64 mask = 0;
+    qint64 bit_rate = 0;
+    qint32 bits_per_coded_sample = 0;
+    qint32 bits_per_raw_sample = 0;
+    qint32 profile = 0;
+    qint32 block_align = 0;
+    qint32 frame_size = 0;
+    qint32 initial_padding = 0;
+    qint32 trailing_padding = 0;
+    qint32 seek_preroll = 0;
+    QByteArray extradata;
+    qint32 tb_num = 0;
+    qint32 tb_den = 0;
+    qint64 start_time = 0;
+    qint64 duration = 0;
+    qint64 format_duration = 0;
+
+    in >> version;
+    if (version != kStreamParamsVersion)
+    {
+        return -1;
+    }
+    in >> stream_index >> codec_id >> format >> sample_rate >> order >> channels >> mask >> bit_rate >> bits_per_coded_sample >>
+        bits_per_raw_sample >> profile >> block_align >> frame_size >> initial_padding >> trailing_padding >> seek_preroll >> extradata >>
+        tb_num >> tb_den >> start_time >> duration >> format_duration;
+    if (in.status() != QDataStream::Ok || stream_index < 0 || static_cast<unsigned int>(stream_index) >= ctx->nb_streams || tb_den <= 0)
+    {
+        return -1;
+    }
+
+    AVStream* stream = ctx->streams[stream_index];
+    AVCodecParameters* par = stream->codecpar;
+    if (par->codec_type != AVMEDIA_TYPE_AUDIO || par->codec_id != static_cast<AVCodecID>(codec_id) || sample_rate <= 0 || channels <= 0)
+    {
+        return -1;
+    }
+
+    par->format = format;
+    par->sample_rate = sample_rate;
+    av_channel_layout_uninit(&par->ch_layout);
+    if (order == AV_CHANNEL_ORDER_NATIVE && mask != 0)
+    {
+        av_channel_layout_from_mask(&par->ch_layout, mask);
+    }
+    else
+    {
+        av_channel_layout_default(&par->ch_layout, channels);
+    }
+    par->bit_rate = bit_rate;
+    par->bits_per_coded_sample = bits_per_coded_sample;
+    par->bits_per_raw_sample = bits_per_raw_sample;
+    par->profile = profile;
+    par->block_align = block_align;
+    par->frame_size = frame_size;
+    par->initial_padding = initial_padding;
+    par->trailing_padding = trailing_padding;
+    par->seek_preroll = seek_preroll;
+
+    if (par->extradata == nullptr && !extradata.isEmpty())
+    {
+        par->extradata = static_cast<uint8_t*>(av_mallocz(static_cast<size_t>(extradata.size()) + AV_INPUT_BUFFER_PADDING_SIZE));
+        if (par->extradata == nullptr)
+        {
+            return -1;
+        }
+        memcpy(par->extradata, extradata.constData(), static_cast<size_t>(extradata.size()));
+        par->extradata_size = static_cast<int>(extradata.size());
+    }
+
+    const AVRational cached_tb{tb_num, tb_den};
+    if (start_time != AV_NOPTS_VALUE)
+    {
+        stream->start_time = av_rescale_q(start_time, cached_tb, stream->time_base);
+    }
+    if (duration != AV_NOPTS_VALUE && stream->duration == AV_NOPTS_VALUE)
+    {
+        stream->duration = av_rescale_q(duration, cached_tb, stream->time_base);
+    }
+    if (format_duration != AV_NOPTS_VALUE && ctx->duration == AV_NOPTS_VALUE)
+    {
+        ctx->duration = format_duration;
+    }
+    return stream_index;
+}
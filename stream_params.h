@@ -0,0 +1,18 @@
+#ifndef STREAM_PARAMS_H
+#define STREAM_PARAMS_H
+
+#include <QByteArray>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+class stream_params
+{
+   public:
+    static QByteArray capture(const AVFormatContext* ctx, int stream_index);
+    static int apply(const QByteArray& blob, AVFormatContext* ctx);
+};
+
+#endif
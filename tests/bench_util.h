@@ -0,0 +1,43 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "cpu_dispatch.h"
+
+// Mean wall time of one call to fn over rounds calls, in nanoseconds.
+template <typename Fn>
+double time_ns(int rounds, Fn&& fn)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round)
+    {
+        fn();
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / rounds;
+}
+
+// Switches choice to every kernel in turn and calls run(); returns how many runs reported a failure.
+template <typename Run>
+int for_each_kernel(kernel_choice& choice, Run&& run)
+{
+    int failures = 0;
+    for (const char* name : choice.names())
+    {
+        choice.use(name);
+        failures += run() ? 0 : 1;
+    }
+    return failures;
+}
+
+// One result line: case label, kernel, time, speedup over the baseline and the error against the reference.
+inline bool report_kernel(const char* label, const kernel_choice& choice, double ns, double baseline_ns, double error, double tolerance)
+{
+    const bool ok = error <= tolerance;
+    std::printf("%-6s %-6s %10.0f ns  %5.1fx  max error %.3g %s\n", label, choice.active(), ns, baseline_ns / ns, error, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+#endif
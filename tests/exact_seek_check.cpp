@@ -0,0 +1,485 @@
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <QCoreApplication>
+#include <QDeadlineTimer>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include "scoped_exit.h"
+#include "pcm_ring.h"
+#include "audio_decoder.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+}
+
+constexpr int kSampleRate = 48000;
+constexpr int64_t kPacketSamples = 480;
+constexpr int64_t kStartTimeMs = 250;
+constexpr int64_t kDurationMs = 6000;
+constexpr int kWaitMs = 5000;
+constexpr qint64 kSessionId = 1;
+constexpr int64_t kSeekTargetsMs[] = {1000, 2345, 4007, 20, 0};
+constexpr double kPi = 3.14159265358979323846;
+constexpr int kLossyBitRate = 128000;
+// Samples skipped after a seek while the codec settles, then the span compared with the uninterrupted decode.
+constexpr size_t kSettleSamples = 2048;
+constexpr size_t kMatchSamples = 4096;
+constexpr int64_t kMaxLagSamples = kSampleRate / 5;
+
+// Sample n of the test file holds (n mod 65536) - 32768, so the first delivered sample names its own position.
+static int16_t ramp_value(int64_t sample) { return static_cast<int16_t>((sample % 65536) - 32768); }
+
+static bool write_ramp_file(const QString& path)
+{
+    AVFormatContext* out = nullptr;
+    if (avformat_alloc_output_context2(&out, nullptr, "matroska", path.toUtf8().constData()) < 0)
+    {
+        return false;
+    }
+    DEFER(avformat_free_context(out));
+
+    AVStream* stream = avformat_new_stream(out, nullptr);
+    if (stream == nullptr)
+    {
+        return false;
+    }
+    stream->time_base = {1, kSampleRate};
+    AVCodecParameters* par = stream->codecpar;
+    par->codec_type = AVMEDIA_TYPE_AUDIO;
+    par->codec_id = AV_CODEC_ID_PCM_S16LE;
+    par->format = AV_SAMPLE_FMT_S16;
+    par->sample_rate = kSampleRate;
+    par->bits_per_coded_sample = 16;
+    par->block_align = 2;
+    par->bit_rate = static_cast<int64_t>(kSampleRate) * 16;
+    av_channel_layout_default(&par->ch_layout, 1);
+
+    if (avio_open(&out->pb, path.toUtf8().constData(), AVIO_FLAG_WRITE) < 0)
+    {
+        return false;
+    }
+    DEFER(avio_closep(&out->pb));
+    if (avformat_write_header(out, nullptr) < 0)
+    {
+        return false;
+    }
+
+    AVPacket* packet = av_packet_alloc();
+    DEFER(av_packet_free(&packet));
+    const int64_t start_sample = kStartTimeMs * kSampleRate / 1000;
+    const int64_t total_samples = kDurationMs * kSampleRate / 1000;
+    for (int64_t first = 0; first < total_samples; first += kPacketSamples)
+    {
+        if (av_new_packet(packet, static_cast<int>(kPacketSamples * 2)) < 0)
+        {
+            return false;
+        }
+        auto* samples = reinterpret_cast<int16_t*>(packet->data);
+        for (int64_t i = 0; i < kPacketSamples; ++i)
+        {
+            samples[i] = ramp_value(first + i);
+        }
+        packet->stream_index = stream->index;
+        packet->pts = av_rescale_q(start_sample + first, {1, kSampleRate}, stream->time_base);
+        packet->dts = packet->pts;
+        packet->duration = av_rescale_q(kPacketSamples, {1, kSampleRate}, stream->time_base);
+        packet->flags |= AV_PKT_FLAG_KEY;
+        if (av_interleaved_write_frame(out, packet) < 0)
+        {
+            return false;
+        }
+    }
+    return av_write_trailer(out) == 0;
+}
+
+// A linear 200 Hz to 4 kHz sweep has no period, so a lag shows up as a clear offset of the correlation peak.
+static float sweep_value(int64_t sample)
+{
+    const double t = static_cast<double>(sample) / kSampleRate;
+    const double span = static_cast<double>(kDurationMs) / 1000.0;
+    return static_cast<float>(0.5 * std::sin(2.0 * kPi * ((200.0 * t) + (3800.0 * t * t / (2.0 * span)))));
+}
+
+static bool encode_frames(AVCodecContext* enc, const AVFrame* frame, AVFormatContext* out, const AVStream* stream, AVPacket* packet)
+{
+    if (avcodec_send_frame(enc, frame) < 0)
+    {
+        return false;
+    }
+    while (avcodec_receive_packet(enc, packet) == 0)
+    {
+        av_packet_rescale_ts(packet, enc->time_base, stream->time_base);
+        packet->stream_index = stream->index;
+        if (av_interleaved_write_frame(out, packet) < 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool write_sweep_file(const QString& path, const char* muxer, AVCodecID codec_id)
+{
+    const AVCodec* codec = avcodec_find_encoder(codec_id);
+    AVFormatContext* out = nullptr;
+    if (codec == nullptr || avformat_alloc_output_context2(&out, nullptr, muxer, path.toUtf8().constData()) < 0)
+    {
+        return false;
+    }
+    DEFER(avformat_free_context(out));
+
+    AVCodecContext* enc = avcodec_alloc_context3(codec);
+    DEFER(avcodec_free_context(&enc));
+    if (enc == nullptr)
+    {
+        return false;
+    }
+    enc->sample_rate = kSampleRate;
+    enc->sample_fmt = codec->sample_fmts != nullptr ? codec->sample_fmts[0] : AV_SAMPLE_FMT_FLTP;
+    enc->bit_rate = kLossyBitRate;
+    enc->time_base = {1, kSampleRate};
+    av_channel_layout_default(&enc->ch_layout, 1);
+    if ((out->oformat->flags & AVFMT_GLOBALHEADER) != 0)
+    {
+        enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+    if (avcodec_open2(enc, codec, nullptr) < 0)
+    {
+        return false;
+    }
+
+    AVStream* stream = avformat_new_stream(out, nullptr);
+    if (stream == nullptr || avcodec_parameters_from_context(stream->codecpar, enc) < 0)
+    {
+        return false;
+    }
+    stream->time_base = enc->time_base;
+    if (avio_open(&out->pb, path.toUtf8().constData(), AVIO_FLAG_WRITE) < 0)
+    {
+        return false;
+    }
+    DEFER(avio_closep(&out->pb));
+    if (avformat_write_header(out, nullptr) < 0)
+    {
+        return false;
+    }
+
+    AVFrame* frame = av_frame_alloc();
+    DEFER(av_frame_free(&frame));
+    AVPacket* packet = av_packet_alloc();
+    DEFER(av_packet_free(&packet));
+    frame->nb_samples = enc->frame_size;
+    frame->format = enc->sample_fmt;
+    frame->sample_rate = kSampleRate;
+    if (av_channel_layout_copy(&frame->ch_layout, &enc->ch_layout) < 0 || av_frame_get_buffer(frame, 0) < 0)
+    {
+        return false;
+    }
+
+    const int64_t total_samples = kDurationMs * kSampleRate / 1000;
+    for (int64_t first = 0; first < total_samples; first += enc->frame_size)
+    {
+        if (av_frame_make_writable(frame) < 0)
+        {
+            return false;
+        }
+        for (int i = 0; i < enc->frame_size; ++i)
+        {
+            const float value = sweep_value(first + i);
+            if (enc->sample_fmt == AV_SAMPLE_FMT_S16 || enc->sample_fmt == AV_SAMPLE_FMT_S16P)
+            {
+                reinterpret_cast<int16_t*>(frame->data[0])[i] = static_cast<int16_t>(std::lrint(value * 32767.0F));
+            }
+            else
+            {
+                reinterpret_cast<float*>(frame->data[0])[i] = value;
+            }
+        }
+        frame->pts = first;
+        if (!encode_frames(enc, frame, out, stream, packet))
+        {
+            return false;
+        }
+    }
+    return encode_frames(enc, nullptr, out, stream, packet) && av_write_trailer(out) == 0;
+}
+
+// Appends the first channel of a decoded packet as floats in [-1, 1].
+static void append_first_channel(const audio_packet_ptr& packet, std::vector<float>& out)
+{
+    const auto channels = static_cast<size_t>(std::max(1, packet->channels));
+    const uint8_t* data = packet->data.data();
+    switch (packet->format)
+    {
+        case QAudioFormat::Int16:
+            for (size_t i = 0; i + channels <= packet->data.size() / sizeof(int16_t); i += channels)
+            {
+                out.push_back(static_cast<float>(reinterpret_cast<const int16_t*>(data)[i]) / 32768.0F);
+            }
+            break;
+        case QAudioFormat::Int32:
+            for (size_t i = 0; i + channels <= packet->data.size() / sizeof(int32_t); i += channels)
+            {
+                out.push_back(static_cast<float>(reinterpret_cast<const int32_t*>(data)[i]) / 2147483648.0F);
+            }
+            break;
+        case QAudioFormat::Float:
+            for (size_t i = 0; i + channels <= packet->data.size() / sizeof(float); i += channels)
+            {
+                out.push_back(reinterpret_cast<const float*>(data)[i]);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Pops current packets until wanted samples arrived or the decoder stays silent for a while.
+static std::vector<float> collect_samples(pcm_ring& ring, size_t wanted)
+{
+    std::vector<float> samples;
+    QDeadlineTimer idle(kWaitMs / 5);
+    audio_packet_ptr packet;
+    while (samples.size() < wanted && !idle.hasExpired())
+    {
+        if (ring.pop(packet))
+        {
+            if (ring.is_current(packet) && !packet->data.empty())
+            {
+                append_first_channel(packet, samples);
+                idle.setRemainingTime(kWaitMs / 5);
+            }
+            continue;
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 5);
+    }
+    return samples;
+}
+
+// Lag in samples at which the delivered span best matches the uninterrupted decode around the target.
+static int64_t best_lag(const std::vector<float>& reference, const std::vector<float>& delivered, int64_t target_sample)
+{
+    int64_t best = std::numeric_limits<int64_t>::max();
+    double best_error = std::numeric_limits<double>::max();
+    for (int64_t lag = -kMaxLagSamples; lag <= kMaxLagSamples; ++lag)
+    {
+        const int64_t start = target_sample + lag + static_cast<int64_t>(kSettleSamples);
+        if (start < 0 || static_cast<size_t>(start) + kMatchSamples > reference.size())
+        {
+            continue;
+        }
+        double error = 0.0;
+        for (size_t i = 0; i < kMatchSamples; ++i)
+        {
+            const double d = static_cast<double>(delivered[kSettleSamples + i]) - reference[static_cast<size_t>(start) + i];
+            error += d * d;
+        }
+        if (error < best_error)
+        {
+            best_error = error;
+            best = lag;
+        }
+    }
+    return best;
+}
+
+static int64_t probe_start_time_ms(const QString& path)
+{
+    AVFormatContext* ctx = nullptr;
+    if (avformat_open_input(&ctx, path.toUtf8().constData(), nullptr, nullptr) != 0)
+    {
+        return AV_NOPTS_VALUE;
+    }
+    DEFER(avformat_close_input(&ctx));
+    if (avformat_find_stream_info(ctx, nullptr) < 0 || ctx->nb_streams == 0 || ctx->streams[0]->start_time == AV_NOPTS_VALUE)
+    {
+        return AV_NOPTS_VALUE;
+    }
+    return av_rescale_q(ctx->streams[0]->start_time, ctx->streams[0]->time_base, {1, 1000});
+}
+
+static audio_packet_ptr wait_first_packet(pcm_ring& ring)
+{
+    const QDeadlineTimer deadline(kWaitMs);
+    audio_packet_ptr packet;
+    while (!deadline.hasExpired())
+    {
+        if (ring.pop(packet))
+        {
+            if (ring.is_current(packet) && !packet->data.empty())
+            {
+                return packet;
+            }
+            continue;
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 5);
+    }
+    return {};
+}
+
+static bool check_packet(const char* label, int64_t target_ms, const audio_packet_ptr& packet)
+{
+    if (!packet)
+    {
+        std::printf("%s %lldms: no packet\n", label, static_cast<long long>(target_ms));
+        return false;
+    }
+    const int16_t first = *reinterpret_cast<const int16_t*>(packet->data.data());
+    const int64_t expected_sample = target_ms * kSampleRate / 1000;
+    const auto offset = static_cast<int16_t>(static_cast<uint16_t>(first) - static_cast<uint16_t>(ramp_value(expected_sample)));
+    const bool ok = offset == 0 && packet->ms == target_ms;
+    std::printf("%s %lldms: packet at %lldms first sample offset %d %s\n",
+                label,
+                static_cast<long long>(target_ms),
+                static_cast<long long>(packet->ms),
+                offset,
+                ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static bool wait_seek(audio_decoder& decoder, const qint64& seek_result_ms, int64_t target_ms)
+{
+    decoder.seek(kSessionId, target_ms);
+    const QDeadlineTimer deadline(kWaitMs);
+    while (seek_result_ms < 0 && !deadline.hasExpired())
+    {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 5);
+    }
+    if (seek_result_ms != target_ms)
+    {
+        std::printf("seek %lldms: decoder reported %lldms FAILED\n", static_cast<long long>(target_ms), static_cast<long long>(seek_result_ms));
+        return false;
+    }
+    return true;
+}
+
+// PCM ramp in Matroska with a start_time: every delivered sample names its own position.
+static int check_ramp(audio_decoder& decoder, qint64& seek_result_ms, const QString& path)
+{
+    auto ring = std::make_shared<pcm_ring>();
+    int failures = 0;
+    decoder.start_decoding(kSessionId, path, ring, -1);
+    failures += check_packet("start", 0, wait_first_packet(*ring)) ? 0 : 1;
+
+    for (const int64_t target_ms : kSeekTargetsMs)
+    {
+        seek_result_ms = -1;
+        if (!wait_seek(decoder, seek_result_ms, target_ms))
+        {
+            ++failures;
+            continue;
+        }
+        failures += check_packet("seek", target_ms, wait_first_packet(*ring)) ? 0 : 1;
+    }
+    return failures;
+}
+
+// Lossy sweep: after each seek the decoder must deliver the same samples an uninterrupted decode has at the target,
+// which catches codec delay and frame-granular seeks that land tens of milliseconds off.
+static int check_lossy(audio_decoder& decoder, qint64& seek_result_ms, const QString& path, const char* label)
+{
+    auto ring = std::make_shared<pcm_ring>();
+    decoder.start_decoding(kSessionId, path, ring, -1);
+    const std::vector<float> reference = collect_samples(*ring, static_cast<size_t>(kDurationMs * kSampleRate / 1000));
+    if (reference.size() < static_cast<size_t>(kSampleRate))
+    {
+        std::printf("%s: decoded only %zu samples FAILED\n", label, reference.size());
+        return 1;
+    }
+
+    int failures = 0;
+    for (const int64_t target_ms : kSeekTargetsMs)
+    {
+        seek_result_ms = -1;
+        if (!wait_seek(decoder, seek_result_ms, target_ms))
+        {
+            ++failures;
+            continue;
+        }
+        const std::vector<float> delivered = collect_samples(*ring, kSettleSamples + kMatchSamples);
+        if (delivered.size() < kSettleSamples + kMatchSamples)
+        {
+            std::printf("%s seek %lldms: only %zu samples FAILED\n", label, static_cast<long long>(target_ms), delivered.size());
+            ++failures;
+            continue;
+        }
+        const int64_t lag = best_lag(reference, delivered, target_ms * kSampleRate / 1000);
+        const bool ok = lag == 0;
+        failures += ok ? 0 : 1;
+        std::printf("%s seek %lldms: lag %lld samples %s\n",
+                    label,
+                    static_cast<long long>(target_ms),
+                    static_cast<long long>(lag),
+                    ok ? "ok" : "FAILED");
+    }
+    return failures;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStandardPaths::setTestModeEnabled(true);
+
+    QTemporaryDir dir;
+    const QString ramp_path = dir.filePath("ramp.mka");
+    if (!dir.isValid() || !write_ramp_file(ramp_path))
+    {
+        std::printf("failed to write %s\n", ramp_path.toUtf8().constData());
+        return 1;
+    }
+    const int64_t start_time_ms = probe_start_time_ms(ramp_path);
+    if (start_time_ms != kStartTimeMs)
+    {
+        std::printf("test file start_time is %lld ms, expected %lld ms\n",
+                    static_cast<long long>(start_time_ms),
+                    static_cast<long long>(kStartTimeMs));
+        return 1;
+    }
+
+    audio_decoder decoder;
+    qint64 seek_result_ms = -1;
+    QObject::connect(&decoder,
+                     &audio_decoder::seek_finished,
+                     &app,
+                     [&](qint64 session_id, qint64 actual_ms)
+                     {
+                         if (session_id == kSessionId)
+                         {
+                             seek_result_ms = actual_ms;
+                         }
+                     });
+
+    int failures = check_ramp(decoder, seek_result_ms, ramp_path);
+
+    struct lossy_case
+    {
+        const char* file;
+        const char* muxer;
+        AVCodecID codec;
+    };
+    const lossy_case lossy_cases[] = {
+        {"sweep.mp2", "mp2", AV_CODEC_ID_MP2},
+        {"sweep.aac", "adts", AV_CODEC_ID_AAC},
+    };
+    for (const lossy_case& lc : lossy_cases)
+    {
+        const QString path = dir.filePath(lc.file);
+        if (!write_sweep_file(path, lc.muxer, lc.codec))
+        {
+            std::printf("failed to encode %s FAILED\n", lc.file);
+            ++failures;
+            continue;
+        }
+        failures += check_lossy(decoder, seek_result_ms, path, lc.file);
+    }
+
+    decoder.shutdown();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "fft_engine.h"
+#include "bench_util.h"
+#include "fftreal.h"
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kTolerance = 1e-5;
+constexpr int kTimingRounds = 500;
+
+static std::vector<float> make_signal(size_t size)
+{
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> noise(-0.05F, 0.05F);
+    std::vector<float> samples(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        const double t = static_cast<double>(i) / 48000.0;
+        const double tone =
+            (0.6 * std::sin(2.0 * kPi * 440.0 * t)) + (0.25 * std::sin(2.0 * kPi * 3520.0 * t)) + (0.1 * std::sin(2.0 * kPi * 15000.0 * t));
+        samples[i] = static_cast<float>(tone) + noise(rng);
+    }
+    return samples;
+}
+
+static std::vector<double> dft_magnitudes(const std::vector<float>& samples, const std::vector<float>& window)
+{
+    const size_t n = samples.size();
+    std::vector<double> cos_table(n);
+    std::vector<double> sin_table(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        cos_table[i] = std::cos(2.0 * kPi * static_cast<double>(i) / static_cast<double>(n));
+        sin_table[i] = std::sin(2.0 * kPi * static_cast<double>(i) / static_cast<double>(n));
+    }
+
+    std::vector<double> out(n / 2);
+    for (size_t k = 0; k < n / 2; ++k)
+    {
+        double re = 0.0;
+        double im = 0.0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const double x = static_cast<double>(samples[i]) * static_cast<double>(window[i]);
+            const size_t slot = (k * i) % n;
+            re += x * cos_table[slot];
+            im -= x * sin_table[slot];
+        }
+        out[k] = std::sqrt((re * re) + (im * im));
+    }
+    return out;
+}
+
+// The path fft_engine replaced: a per-sample cos() Hann window feeding fft_real<double>.
+static void fft_real_magnitudes(fft_real<double>& fft, const std::vector<float>& samples, std::vector<double>& input, std::vector<double>& out)
+{
+    const size_t n = samples.size();
+    for (size_t i = 0; i < n; ++i)
+    {
+        const double window = 0.5 * (1.0 - std::cos(2.0 * kPi * static_cast<double>(i) / static_cast<double>(n - 1)));
+        input[i] = static_cast<double>(samples[i]) * window;
+    }
+    fft.do_fft(input.data());
+    for (size_t k = 0; k < n / 2; ++k)
+    {
+        const double re = fft.get_real(k);
+        const double im = fft.get_imag(k);
+        out[k] = std::sqrt((re * re) + (im * im));
+    }
+}
+
+int main()
+{
+    int failures = 0;
+    for (size_t size = fft_engine::kMinSize; size <= fft_engine::kMaxSize; size <<= 1)
+    {
+        const std::vector<float> samples = make_signal(size);
+        fft_engine probe(size);
+        const std::vector<double> expected = dft_magnitudes(samples, probe.window());
+        const double peak = *std::max_element(expected.begin(), expected.end());
+
+        fft_real<double> fft(size);
+        std::vector<double> input(size);
+        std::vector<double> reference(size / 2);
+        const double reference_ns = time_ns(kTimingRounds, [&] { fft_real_magnitudes(fft, samples, input, reference); });
+        std::printf("%-6zu fft_real<double> %10.0f ns\n", size, reference_ns);
+
+        fft_engine engine(size);
+        std::vector<float> out(engine.bin_count());
+        const std::string label = std::to_string(size);
+        failures += for_each_kernel(engine.kernel(),
+                                    [&]
+                                    {
+                                        engine.magnitudes(samples.data(), out.data());
+                                        double worst = 0.0;
+                                        for (size_t k = 0; k < out.size(); ++k)
+                                        {
+                                            worst = std::max(worst, std::abs(static_cast<double>(out[k]) - expected[k]) / peak);
+                                        }
+                                        const double engine_ns = time_ns(kTimingRounds, [&] { engine.magnitudes(samples.data(), out.data()); });
+                                        return report_kernel(label.c_str(), engine.kernel(), engine_ns, reference_ns, worst, kTolerance);
+                                    });
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <SDL.h>
+#include "audio_output_stage.h"
+#include "bench_util.h"
+
+constexpr size_t kFrames = 2048;
+constexpr size_t kChannels = 2;
+constexpr int kVolume = 96;
+constexpr int kRounds = 20000;
+
+struct format_case
+{
+    SDL_AudioFormat format;
+    size_t sample_bytes;
+    const char* name;
+};
+
+static std::vector<uint8_t> make_input(const format_case& fc)
+{
+    std::mt19937 rng(6789);
+    std::vector<uint8_t> bytes(kFrames * kChannels * fc.sample_bytes);
+    const size_t samples = kFrames * kChannels;
+    if (fc.format == AUDIO_S16SYS)
+    {
+        std::uniform_int_distribution<int> dist(-32768, 32767);
+        auto* data = reinterpret_cast<int16_t*>(bytes.data());
+        for (size_t i = 0; i < samples; ++i)
+        {
+            data[i] = static_cast<int16_t>(dist(rng));
+        }
+    }
+    else if (fc.format == AUDIO_S32SYS)
+    {
+        std::uniform_int_distribution<int32_t> dist(INT32_MIN, INT32_MAX);
+        auto* data = reinterpret_cast<int32_t*>(bytes.data());
+        for (size_t i = 0; i < samples; ++i)
+        {
+            data[i] = dist(rng);
+        }
+    }
+    else
+    {
+        std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+        auto* data = reinterpret_cast<float*>(bytes.data());
+        for (size_t i = 0; i < samples; ++i)
+        {
+            data[i] = dist(rng);
+        }
+    }
+    return bytes;
+}
+
+static double max_difference(const format_case& fc, const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+{
+    double worst = 0.0;
+    const size_t samples = kFrames * kChannels;
+    for (size_t i = 0; i < samples; ++i)
+    {
+        double x = 0.0;
+        double y = 0.0;
+        if (fc.format == AUDIO_S16SYS)
+        {
+            x = reinterpret_cast<const int16_t*>(a.data())[i];
+            y = reinterpret_cast<const int16_t*>(b.data())[i];
+        }
+        else if (fc.format == AUDIO_S32SYS)
+        {
+            x = reinterpret_cast<const int32_t*>(a.data())[i] / 65536.0;
+            y = reinterpret_cast<const int32_t*>(b.data())[i] / 65536.0;
+        }
+        else
+        {
+            x = reinterpret_cast<const float*>(a.data())[i] * 32768.0;
+            y = reinterpret_cast<const float*>(b.data())[i] * 32768.0;
+        }
+        worst = std::max(worst, std::abs(x - y));
+    }
+    return worst;
+}
+
+int main()
+{
+    const format_case cases[] = {
+        {AUDIO_S16SYS, sizeof(int16_t), "s16"},
+        {AUDIO_S32SYS, sizeof(int32_t), "s32"},
+        {AUDIO_F32SYS, sizeof(float), "f32"},
+    };
+
+    int failures = 0;
+    for (const format_case& fc : cases)
+    {
+        const std::vector<uint8_t> input = make_input(fc);
+        const auto len = static_cast<Uint32>(input.size());
+        std::vector<uint8_t> mixed(input.size());
+        const double sdl_ns = time_ns(kRounds,
+                                      [&]
+                                      {
+                                          std::memset(mixed.data(), 0, mixed.size());
+                                          SDL_MixAudioFormat(mixed.data(), input.data(), fc.format, len, kVolume);
+                                      });
+        std::printf("%-6s SDL    %10.0f ns per %zu frames\n", fc.name, sdl_ns, kFrames);
+
+        audio_output_stage stage;
+        stage.set_gain(static_cast<float>(kVolume) / SDL_MIX_MAXVOLUME);
+        stage.configure(fc.format, static_cast<int>(kChannels));
+        std::vector<uint8_t> output(input.size());
+        // SDL truncates toward zero where the stage rounds, so allow one 16-bit step.
+        failures += for_each_kernel(stage.kernel(),
+                                    [&]
+                                    {
+                                        const double stage_ns = time_ns(kRounds,
+                                                                        [&]
+                                                                        {
+                                                                            std::memcpy(output.data(), input.data(), output.size());
+                                                                            stage.apply(output.data(), output.size());
+                                                                        });
+                                        return report_kernel(fc.name, stage.kernel(), stage_ns, sdl_ns, max_difference(fc, output, mixed), 1.0);
+                                    });
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "loudness_meter.h"
+#include "bench_util.h"
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr int kSampleRate = 48000;
+constexpr int kSeconds = 20;
+constexpr int kBlockFrames = 4096;
+constexpr int kTimingRounds = 3;
+constexpr double kTargetLufs = -23.0;
+constexpr double kToleranceDb = 0.1;
+
+// EBU Tech 3341 case 1: a 997 Hz sine at -23 dBFS in left and right reads -23 LUFS; other channels stay silent.
+// A mono file carries the tone once and reads 3 LU lower.
+static std::vector<float> make_tone(int channels)
+{
+    const double amplitude = std::pow(10.0, kTargetLufs / 20.0);
+    std::vector<float> samples(static_cast<size_t>(kSampleRate) * kSeconds * static_cast<size_t>(channels), 0.0F);
+    for (size_t i = 0; i < samples.size() / static_cast<size_t>(channels); ++i)
+    {
+        const auto value = static_cast<float>(amplitude * std::sin(2.0 * kPi * 997.0 * static_cast<double>(i) / kSampleRate));
+        for (size_t c = 0; c < static_cast<size_t>(std::min(channels, 2)); ++c)
+        {
+            samples[(i * static_cast<size_t>(channels)) + c] = value;
+        }
+    }
+    return samples;
+}
+
+static loudness_meter::summary measure(const std::vector<float>& samples, int channels, const char* kernel)
+{
+    loudness_meter meter(kSampleRate, channels);
+    meter.kernel().use(kernel);
+    const int frames = static_cast<int>(samples.size() / static_cast<size_t>(channels));
+    for (int done = 0; done < frames; done += kBlockFrames)
+    {
+        meter.process(samples.data() + (static_cast<ptrdiff_t>(done) * channels), std::min(kBlockFrames, frames - done));
+    }
+    return meter.finish();
+}
+
+int main()
+{
+    const double amplitude = std::pow(10.0, kTargetLufs / 20.0);
+    int failures = 0;
+    for (const int channels : {1, 2, 6})
+    {
+        const std::vector<float> samples = make_tone(channels);
+        const double expected_lufs = channels == 1 ? kTargetLufs - (10.0 * std::log10(2.0)) : kTargetLufs;
+        loudness_meter probe(kSampleRate, channels);
+        const double scalar_ns = time_ns(kTimingRounds, [&] { measure(samples, channels, "scalar"); });
+        const std::string label = std::to_string(channels) + "ch";
+        failures += for_each_kernel(probe.kernel(),
+                                    [&]
+                                    {
+                                        loudness_meter::summary result;
+                                        const char* kernel = probe.kernel().active();
+                                        const double ns = time_ns(kTimingRounds, [&] { result = measure(samples, channels, kernel); });
+                                        const double lufs_error = std::abs(result.integrated_lufs - expected_lufs);
+                                        const double peak_error = std::abs(20.0 * std::log10(result.true_peak / amplitude));
+                                        const double error = std::max(lufs_error, peak_error);
+                                        return report_kernel(label.c_str(), probe.kernel(), ns, scalar_ns, error, kToleranceDb);
+                                    });
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include <QThread>
+#include <QMetaObject>
+#include <QElapsedTimer>
+#include "log.h"
+#include "pcm_reader.h"
+#include "media_cache.h"
+#include "waveform_loader.h"
+
+constexpr qint64 kPartialPublishSeconds = 30;
+
+waveform_loader::waveform_loader(QObject* parent) : QObject(parent) { pool_.setMaxThreadCount(1); }
+
+waveform_loader::~waveform_loader()
+{
+    cancel();
+    pool_.waitForDone();
+}
+
+void waveform_loader::cancel()
+{
+    generation_++;
+    if (cancel_)
+    {
+        cancel_->store(true);
+        cancel_.reset();
+    }
+}
+
+void waveform_loader::request(const QString& file_path)
+{
+    cancel();
+    if (file_path.isEmpty())
+    {
+        return;
+    }
+
+    const quint64 generation = generation_;
+    auto token = std::make_shared<std::atomic<bool>>(false);
+    cancel_ = token;
+    pool_.start(
+        [this, generation, file_path, token]()
+        {
+            QThread::currentThread()->setPriority(QThread::IdlePriority);
+            compute(generation, file_path, token);
+        });
+}
+
+void waveform_loader::publish(quint64 generation, const QString& file_path, std::shared_ptr<const waveform_pyramid> pyramid)
+{
+    if (generation == generation_)
+    {
+        emit waveform_ready(file_path, std::move(pyramid));
+    }
+}
+
+void waveform_loader::compute(quint64 generation, const QString& file_path, const std::shared_ptr<std::atomic<bool>>& cancel)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const media_cache::file_stamp stamp = media_cache::stamp_of(file_path);
+    auto post = [this, generation, &file_path](std::shared_ptr<const waveform_pyramid> snapshot)
+    { QMetaObject::invokeMethod(this, [this, generation, file_path, snapshot]() { publish(generation, file_path, snapshot); }, Qt::QueuedConnection); };
+
+    const QByteArray cached = media_cache::load_waveform(file_path, stamp);
+    if (!cached.isEmpty())
+    {
+        auto pyramid = std::make_shared<waveform_pyramid>(waveform_pyramid::deserialize(cached));
+        if (!pyramid->empty())
+        {
+            LOG_DEBUG("波形 命中缓存 {} 字节 {}", cached.size(), file_path.toStdString());
+            post(pyramid);
+            return;
+        }
+    }
+    if (cancel->load())
+    {
+        return;
+    }
+
+    pcm_reader reader;
+    if (!reader.open(file_path))
+    {
+        LOG_WARN("波形 无法打开 {}", file_path.toStdString());
+        return;
+    }
+
+    const qint64 partial_frames = kPartialPublishSeconds * reader.sample_rate();
+    qint64 frames_since_publish = 0;
+    waveform_pyramid pyramid(reader.sample_rate());
+
+    const bool ok = reader.read_all(
+        [&](const float* samples, int frames)
+        {
+            pyramid.append(samples, frames, reader.channels());
+            frames_since_publish += frames;
+            if (frames_since_publish >= partial_frames)
+            {
+                frames_since_publish = 0;
+                auto snapshot = std::make_shared<waveform_pyramid>(pyramid);
+                snapshot->finish();
+                post(snapshot);
+            }
+        },
+        *cancel);
+    if (!ok || cancel->load())
+    {
+        LOG_DEBUG("波形 计算中止 {}", file_path.toStdString());
+        return;
+    }
+
+    pyramid.finish();
+    const QByteArray blob = pyramid.serialize();
+    if (stamp.valid())
+    {
+        media_cache::store_waveform(file_path, stamp, blob);
+    }
+    LOG_DEBUG("波形 计算完成 {} 桶 {} 字节 耗时 {}ms {}", pyramid.empty() ? 0 : pyramid.level(0).size(), blob.size(), timer.elapsed(),
+              file_path.toStdString());
+    post(std::make_shared<waveform_pyramid>(std::move(pyramid)));
+}
@@ -0,0 +1,35 @@
+#ifndef WAVEFORM_LOADER_H
+#define WAVEFORM_LOADER_H
+
+#include <atomic>
+#include <memory>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include "waveform_pyramid.h"
+
+class waveform_loader : public QObject
+{
+    Q_OBJECT
+
+   public:
+    explicit waveform_loader(QObject* parent = nullptr);
+    ~waveform_loader() override;
+
+    void request(const QString& file_path);
+    void cancel();
+
+   signals:
+    void waveform_ready(const QString& file_path, std::shared_ptr<const waveform_pyramid> pyramid);
+
+   private:
+    void publish(quint64 generation, const QString& file_path, std::shared_ptr<const waveform_pyramid> pyramid);
+    void compute(quint64 generation, const QString& file_path, const std::shared_ptr<std::atomic<bool>>& cancel);
+
+   private:
+    QThreadPool pool_;
+    quint64 generation_ = 0;
+    std::shared_ptr<std::atomic<bool>> cancel_;
+};
+
+#endif
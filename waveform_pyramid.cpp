@@ -0,0 +1,202 @@
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <QIODevice>
+#include <QDataStream>
+#include "waveform_pyramid.h"
+
+constexpr quint8 kWaveformMagic = 'W';
+constexpr quint8 kWaveformVersion = 1;
+constexpr size_t kMinTopBuckets = 16;
+
+static int8_t quantize_peak(float value) { return static_cast<int8_t>(std::lround(std::clamp(value, -1.0F, 1.0F) * 127.0F)); }
+
+static uint8_t quantize_rms(double value) { return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0, 1.0) * 255.0)); }
+
+static waveform_pyramid::bucket merge(const waveform_pyramid::bucket& a, const waveform_pyramid::bucket& b)
+{
+    const double square = ((static_cast<double>(a.rms) * a.rms) + (static_cast<double>(b.rms) * b.rms)) / 2.0;
+    waveform_pyramid::bucket out;
+    out.min = std::min(a.min, b.min);
+    out.max = std::max(a.max, b.max);
+    out.rms = static_cast<uint8_t>(std::lround(std::sqrt(square)));
+    return out;
+}
+
+void waveform_pyramid::append(const float* samples, int frames, int channels)
+{
+    if (channels <= 0)
+    {
+        return;
+    }
+    if (levels_.empty())
+    {
+        levels_.emplace_back();
+    }
+
+    const float scale = 1.0F / static_cast<float>(channels);
+    for (int i = 0; i < frames; ++i)
+    {
+        float mono = 0.0F;
+        for (int c = 0; c < channels; ++c)
+        {
+            mono += samples[(static_cast<ptrdiff_t>(i) * channels) + c];
+        }
+        mono *= scale;
+
+        if (acc_frames_ == 0)
+        {
+            acc_min_ = mono;
+            acc_max_ = mono;
+        }
+        acc_min_ = std::min(acc_min_, mono);
+        acc_max_ = std::max(acc_max_, mono);
+        acc_square_ += static_cast<double>(mono) * mono;
+        if (++acc_frames_ == kBaseFrames)
+        {
+            flush_bucket();
+        }
+    }
+}
+
+void waveform_pyramid::flush_bucket()
+{
+    if (acc_frames_ == 0)
+    {
+        return;
+    }
+    bucket b;
+    b.min = quantize_peak(acc_min_);
+    b.max = quantize_peak(acc_max_);
+    b.rms = quantize_rms(std::sqrt(acc_square_ / acc_frames_));
+    levels_.front().push_back(b);
+    acc_square_ = 0.0;
+    acc_frames_ = 0;
+}
+
+void waveform_pyramid::finish()
+{
+    if (levels_.empty())
+    {
+        return;
+    }
+    flush_bucket();
+    build_levels();
+}
+
+void waveform_pyramid::build_levels()
+{
+    levels_.resize(1);
+    while (levels_.back().size() > kMinTopBuckets)
+    {
+        const std::vector<bucket>& below = levels_.back();
+        std::vector<bucket> next;
+        next.reserve((below.size() + 1) / 2);
+        for (size_t i = 0; i + 1 < below.size(); i += 2)
+        {
+            next.push_back(merge(below[i], below[i + 1]));
+        }
+        if (below.size() % 2 != 0)
+        {
+            next.push_back(below.back());
+        }
+        levels_.push_back(std::move(next));
+    }
+}
+
+double waveform_pyramid::bucket_ms(int level) const { return static_cast<double>(kBaseFrames << level) * 1000.0 / sample_rate_; }
+
+qint64 waveform_pyramid::duration_ms() const
+{
+    if (empty() || sample_rate_ <= 0)
+    {
+        return 0;
+    }
+    return static_cast<qint64>(static_cast<double>(levels_.front().size()) * bucket_ms(0));
+}
+
+int waveform_pyramid::level_for_span(double span_ms) const
+{
+    if (empty() || sample_rate_ <= 0 || span_ms <= bucket_ms(0))
+    {
+        return 0;
+    }
+    const int level = static_cast<int>(std::floor(std::log2(span_ms / bucket_ms(0))));
+    return std::clamp(level, 0, level_count() - 1);
+}
+
+waveform_pyramid::bucket waveform_pyramid::span(int level, double begin_ms, double end_ms) const
+{
+    const std::vector<bucket>& buckets = levels_[static_cast<size_t>(level)];
+    const double width_ms = bucket_ms(level);
+    const auto first = static_cast<size_t>(std::max(0.0, std::floor(begin_ms / width_ms)));
+    const auto last = std::min(buckets.size(), std::max(first + 1, static_cast<size_t>(std::max(0.0, std::ceil(end_ms / width_ms)))));
+    if (first >= last)
+    {
+        return {};
+    }
+
+    bucket out = buckets[first];
+    double square_sum = 0.0;
+    for (size_t i = first; i < last; ++i)
+    {
+        out.min = std::min(out.min, buckets[i].min);
+        out.max = std::max(out.max, buckets[i].max);
+        square_sum += static_cast<double>(buckets[i].rms) * buckets[i].rms;
+    }
+    out.rms = static_cast<uint8_t>(std::lround(std::sqrt(square_sum / static_cast<double>(last - first))));
+    return out;
+}
+
+QByteArray waveform_pyramid::serialize() const
+{
+    QByteArray out;
+    if (empty())
+    {
+        return out;
+    }
+
+    const std::vector<bucket>& base = levels_.front();
+    QDataStream stream(&out, QIODevice::WriteOnly);
+    stream << kWaveformMagic << kWaveformVersion << static_cast<qint32>(sample_rate_) << static_cast<quint32>(base.size());
+    for (const bucket& b : base)
+    {
+        stream << static_cast<qint8>(b.min) << static_cast<qint8>(b.max) << static_cast<quint8>(b.rms);
+    }
+    return out;
+}
+
+waveform_pyramid waveform_pyramid::deserialize(const QByteArray& blob)
+{
+    QDataStream stream(blob);
+    quint8 magic = 0;
+    quint8 version = 0;
+    qint32 sample_rate = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> sample_rate >> count;
+    if (stream.status() != QDataStream::Ok || magic != kWaveformMagic || version != kWaveformVersion || sample_rate <= 0 ||
+        static_cast<qint64>(count) * 3 > blob.size())
+    {
+        return {};
+    }
+
+    waveform_pyramid pyramid(sample_rate);
+    std::vector<bucket>& base = pyramid.levels_.emplace_back();
+    base.resize(count);
+    for (bucket& b : base)
+    {
+        qint8 min = 0;
+        qint8 max = 0;
+        quint8 rms = 0;
+        stream >> min >> max >> rms;
+        b.min = min;
+        b.max = max;
+        b.rms = rms;
+    }
+    if (stream.status() != QDataStream::Ok)
+    {
+        return {};
+    }
+    pyramid.build_levels();
+    return pyramid;
+}
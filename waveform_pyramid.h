@@ -0,0 +1,53 @@
+#ifndef WAVEFORM_PYRAMID_H
+#define WAVEFORM_PYRAMID_H
+
+#include <cstdint>
+#include <vector>
+#include <QtGlobal>
+#include <QByteArray>
+
+class waveform_pyramid
+{
+   public:
+    struct bucket
+    {
+        int8_t min = 0;
+        int8_t max = 0;
+        uint8_t rms = 0;
+    };
+
+    static constexpr int kBaseFrames = 512;
+
+    waveform_pyramid() = default;
+    explicit waveform_pyramid(int sample_rate) : sample_rate_(sample_rate) {}
+
+    void append(const float* samples, int frames, int channels);
+    void finish();
+
+    [[nodiscard]] bool empty() const { return levels_.empty() || levels_.front().empty(); }
+    [[nodiscard]] int sample_rate() const { return sample_rate_; }
+    [[nodiscard]] int level_count() const { return static_cast<int>(levels_.size()); }
+    [[nodiscard]] const std::vector<bucket>& level(int index) const { return levels_[static_cast<size_t>(index)]; }
+    [[nodiscard]] qint64 duration_ms() const;
+
+    [[nodiscard]] int level_for_span(double span_ms) const;
+    [[nodiscard]] bucket span(int level, double begin_ms, double end_ms) const;
+
+    [[nodiscard]] QByteArray serialize() const;
+    static waveform_pyramid deserialize(const QByteArray& blob);
+
+   private:
+    void flush_bucket();
+    void build_levels();
+    [[nodiscard]] double bucket_ms(int level) const;
+
+   private:
+    int sample_rate_ = 0;
+    std::vector<std::vector<bucket>> levels_;
+    float acc_min_ = 0.0F;
+    float acc_max_ = 0.0F;
+    double acc_square_ = 0.0;
+    int acc_frames_ = 0;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include <QPainter>
+#include <QResizeEvent>
+#include "waveform_slider.h"
+
+waveform_slider::waveform_slider(Qt::Orientation orientation, QWidget* parent) : QSlider(orientation, parent) {}
+
+void waveform_slider::set_waveform(std::shared_ptr<const waveform_pyramid> pyramid)
+{
+    pyramid_ = std::move(pyramid);
+    invalidate();
+}
+
+void waveform_slider::clear_waveform()
+{
+    pyramid_.reset();
+    cache_ = QImage();
+    cache_valid_ = true;
+    update();
+}
+
+void waveform_slider::invalidate()
+{
+    cache_valid_ = false;
+    update();
+}
+
+void waveform_slider::resizeEvent(QResizeEvent* event)
+{
+    QSlider::resizeEvent(event);
+    invalidate();
+}
+
+void waveform_slider::sliderChange(SliderChange change)
+{
+    QSlider::sliderChange(change);
+    if (change == SliderRangeChange)
+    {
+        invalidate();
+    }
+}
+
+void waveform_slider::render_cache()
+{
+    cache_valid_ = true;
+    cache_ = QImage();
+    const qreal dpr = devicePixelRatioF();
+    const QSize device_size = (QSizeF(size()) * dpr).toSize();
+    const int w = device_size.width();
+    const int h = device_size.height();
+    const qint64 total_ms = maximum() > minimum() ? maximum() - minimum() : 0;
+    if (pyramid_ == nullptr || pyramid_->empty() || w <= 0 || h <= 0 || total_ms <= 1)
+    {
+        return;
+    }
+
+    cache_ = QImage(device_size, QImage::Format_ARGB32_Premultiplied);
+    cache_.fill(Qt::transparent);
+
+    const double column_ms = static_cast<double>(total_ms) / w;
+    const int level = pyramid_->level_for_span(column_ms);
+    const double mid = h / 2.0;
+    const double half = h / 2.0;
+
+    QPainter painter(&cache_);
+    for (int x = 0; x < w; ++x)
+    {
+        const waveform_pyramid::bucket b = pyramid_->span(level, x * column_ms, (x + 1) * column_ms);
+        if (b.max == b.min && b.rms == 0)
+        {
+            continue;
+        }
+        const double top = mid - (b.max / 127.0 * half);
+        const double bottom = mid - (b.min / 127.0 * half);
+        painter.fillRect(QRectF(x, top, 1.0, std::max(1.0, bottom - top)), wave_color_);
+
+        const double rms = b.rms / 255.0 * half;
+        painter.fillRect(QRectF(x, mid - rms, 1.0, std::max(1.0, 2.0 * rms)), rms_color_);
+    }
+    painter.end();
+    cache_.setDevicePixelRatio(dpr);
+}
+
+void waveform_slider::paintEvent(QPaintEvent* event)
+{
+    if (!cache_valid_ || (!cache_.isNull() && cache_.devicePixelRatio() != devicePixelRatioF()))
+    {
+        render_cache();
+    }
+    if (!cache_.isNull())
+    {
+        QPainter painter(this);
+        painter.drawImage(0, 0, cache_);
+    }
+    QSlider::paintEvent(event);
+}
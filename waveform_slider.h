@@ -0,0 +1,52 @@
+#ifndef WAVEFORM_SLIDER_H
+#define WAVEFORM_SLIDER_H
+
+#include <memory>
+#include <QSlider>
+#include <QColor>
+#include <QImage>
+#include "waveform_pyramid.h"
+
+class waveform_slider : public QSlider
+{
+    Q_OBJECT
+    Q_PROPERTY(QColor waveColor READ getWaveColor WRITE setWaveColor)
+    Q_PROPERTY(QColor rmsColor READ getRmsColor WRITE setRmsColor)
+
+   public:
+    explicit waveform_slider(Qt::Orientation orientation, QWidget* parent = nullptr);
+
+    void set_waveform(std::shared_ptr<const waveform_pyramid> pyramid);
+    void clear_waveform();
+
+    [[nodiscard]] QColor getWaveColor() const { return wave_color_; }
+    void setWaveColor(const QColor& color)
+    {
+        wave_color_ = color;
+        invalidate();
+    }
+    [[nodiscard]] QColor getRmsColor() const { return rms_color_; }
+    void setRmsColor(const QColor& color)
+    {
+        rms_color_ = color;
+        invalidate();
+    }
+
+   protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void sliderChange(SliderChange change) override;
+
+   private:
+    void invalidate();
+    void render_cache();
+
+   private:
+    std::shared_ptr<const waveform_pyramid> pyramid_;
+    QImage cache_;
+    bool cache_valid_ = false;
+    QColor wave_color_ = QColor(83, 182, 212, 90);
+    QColor rms_color_ = QColor(83, 182, 212, 160);
+};
+
+#endif